@@ -1,2 +1,4 @@
-C:/VulkanSDK/1.3.275.0/Bin/glslc.exe triangle.vert -o triangle.vspv
-C:/VulkanSDK/1.3.275.0/Bin/glslc.exe triangle.frag -o triangle.fspv
\ No newline at end of file
+REM The build embeds the shaders into the executable, these files are only used with --shader-dir
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe triangle.vert -o triangle.vert.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe triangle.frag -o triangle.frag.spv
+C:/VulkanSDK/1.3.275.0/Bin/glslc.exe cull.comp -o cull.comp.spv
\ No newline at end of file
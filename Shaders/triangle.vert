@@ -1,21 +1,21 @@
 #version 450
 
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// Per instance: the offset, the uniform scale and the rotation in radians
+layout(location = 2) in vec4 inTransform;
+layout(location = 3) in vec3 inInstanceColor;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+layout(location = 0) out vec3 fragColor;
 
 void main()
 {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+	float s = sin(inTransform.w),
+		  c = cos(inTransform.w);
+
+	vec2 position = mat2(c, s, -s, c) * inPosition * inTransform.z + inTransform.xy;
+
+	gl_Position = vec4(position, 0.0, 1.0);
+    fragColor = inColor * inInstanceColor;
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> s_FrameAllocationCount{ 0 };
+static std::atomic<uint64_t> s_FrameAllocatedBytes{ 0 };
+static std::atomic<uint32_t> s_PrintedCount{ 0 };
+
+// Trivial thread locals, reading them never allocates
+static thread_local uint32_t t_FrameDepth = 0;
+static thread_local uint32_t t_ExemptDepth = 0;
+static thread_local const char* t_FrameName = nullptr;
+static thread_local bool t_Printing = false;
+
+void AllocationTracker::OnAllocation(size_t size) noexcept
+{
+	if (t_FrameDepth == 0 || t_ExemptDepth > 0 || t_Printing)
+		return;
+
+	s_FrameAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	s_FrameAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (s_PrintedCount.fetch_add(1, std::memory_order_relaxed) >= MAX_PRINTED)
+		return;
+
+	// stdio may allocate its buffer, which mustn't be reported again
+	t_Printing = true;
+	std::fprintf(stderr, "Heap allocation of %zu bytes inside the frame scope %s\n", size, t_FrameName);
+	t_Printing = false;
+}
+
+void AllocationTracker::EnterFrameScope(const char* name) noexcept
+{
+	if (t_FrameDepth++ == 0)
+		t_FrameName = name;
+}
+
+void AllocationTracker::LeaveFrameScope() noexcept
+{
+	t_FrameDepth--;
+}
+
+void AllocationTracker::EnterExemptScope() noexcept
+{
+	t_ExemptDepth++;
+}
+
+void AllocationTracker::LeaveExemptScope() noexcept
+{
+	t_ExemptDepth--;
+}
+
+uint64_t AllocationTracker::GetFrameAllocationCount() noexcept
+{
+	return s_FrameAllocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationTracker::GetFrameAllocatedBytes() noexcept
+{
+	return s_FrameAllocatedBytes.load(std::memory_order_relaxed);
+}
+
+void AllocationTracker::ResetCounters() noexcept
+{
+	s_FrameAllocationCount.store(0, std::memory_order_relaxed);
+	s_FrameAllocatedBytes.store(0, std::memory_order_relaxed);
+	s_PrintedCount.store(0, std::memory_order_relaxed);
+}
+
+void AllocationTracker::Report(std::ostream& stream)
+{
+	uint64_t count = GetFrameAllocationCount();
+
+	if (count == 0)
+		stream << "No heap allocations inside the frame scope\n";
+	else
+		stream << count << " heap allocations (" << GetFrameAllocatedBytes() << " bytes) inside the frame scope\n";
+}
+
+#ifdef TRIANGLE_TRACK_ALLOCATIONS
+// Every form of new and delete is replaced, so memory never crosses between the default and the replaced functions
+
+static void* Allocate(size_t size) noexcept
+{
+	AllocationTracker::OnAllocation(size);
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+static void* AllocateAligned(size_t size, std::align_val_t alignment) noexcept
+{
+	AllocationTracker::OnAllocation(size);
+
+	size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+	return _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+	// aligned_alloc wants a multiple of the alignment
+	size_t rounded = (std::max<size_t>(size, 1) + align - 1) / align * align;
+	return std::aligned_alloc(align, rounded);
+#endif
+}
+
+static void FreeAligned(void* memory) noexcept
+{
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void* operator new(size_t size)
+{
+	if (void* memory = Allocate(size))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if (void* memory = AllocateAligned(size, alignment))
+		return memory;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+
+void operator delete(void* memory, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { FreeAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { FreeAligned(memory); }
+#endif
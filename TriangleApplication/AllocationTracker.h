@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Debug check that the steady-state frame loop doesn't allocate: the global operator new is replaced
+// and every allocation made on a thread inside a frame scope is counted and the first ones are printed.
+// The replacement is only compiled when TRIANGLE_TRACK_ALLOCATIONS is defined, the TRACK_* macros compile to nothing otherwise.
+class AllocationTracker
+{
+public:
+	static constexpr uint32_t MAX_PRINTED = 16; // The violations after these are only counted
+
+	static void OnAllocation(size_t size) noexcept;
+
+	static void EnterFrameScope(const char* name) noexcept;
+	static void LeaveFrameScope() noexcept;
+
+	// Lets a rare, non steady-state path allocate inside the frame scope (e.g. recreating the swapchain)
+	static void EnterExemptScope() noexcept;
+	static void LeaveExemptScope() noexcept;
+
+	static uint64_t GetFrameAllocationCount() noexcept;
+	static uint64_t GetFrameAllocatedBytes() noexcept;
+
+	// Called after the warm-up, the first frames are allowed to fill the caches
+	static void ResetCounters() noexcept;
+	static void Report(std::ostream& stream);
+};
+
+class FrameAllocationScope
+{
+public:
+	explicit FrameAllocationScope(const char* name) noexcept { AllocationTracker::EnterFrameScope(name); }
+	~FrameAllocationScope() { AllocationTracker::LeaveFrameScope(); }
+
+	FrameAllocationScope(const FrameAllocationScope&) = delete;
+	FrameAllocationScope& operator=(const FrameAllocationScope&) = delete;
+};
+
+class ExemptAllocationScope
+{
+public:
+	ExemptAllocationScope() noexcept { AllocationTracker::EnterExemptScope(); }
+	~ExemptAllocationScope() { AllocationTracker::LeaveExemptScope(); }
+
+	ExemptAllocationScope(const ExemptAllocationScope&) = delete;
+	ExemptAllocationScope& operator=(const ExemptAllocationScope&) = delete;
+};
+
+#ifdef TRIANGLE_TRACK_ALLOCATIONS
+#define TRACKER_CONCAT_IMPL(a, b) a##b
+#define TRACKER_CONCAT(a, b) TRACKER_CONCAT_IMPL(a, b)
+#define TRACK_FRAME_ALLOCATIONS(name) FrameAllocationScope TRACKER_CONCAT(frameAllocationScope, __LINE__)(name)
+#define ALLOW_FRAME_ALLOCATIONS() ExemptAllocationScope TRACKER_CONCAT(exemptAllocationScope, __LINE__)
+#else
+#define TRACK_FRAME_ALLOCATIONS(name)
+#define ALLOW_FRAME_ALLOCATIONS()
+#endif
@@ -1,9 +1,62 @@
 #include "Application.h"
 
+#include "triangle_vert.h"
+#include "triangle_frag.h"
+#include "cull_comp.h"
+#include "FixedVector.h"
+
 #include <stdexcept>
 #include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <limits>
+#include <cmath>
+#include <array>
+#include <tuple>
+
+// Limits the wait for a present, a hidden or minimized window may never present
+static constexpr uint64_t PRESENT_WAIT_TIMEOUT = 100'000'000;
+
+// The longest time the event thread sleeps before publishing a fresh input sample
+static constexpr double INPUT_PUMP_INTERVAL = 0.001;
+
+// The weight of a new frame in the average overlap of the async compute
+static constexpr double OVERLAP_SMOOTHING = 0.1;
+
+// The streamed uploads range from constants to texture mips, the destination is reused from its start once it's full
+static constexpr VkDeviceSize MIN_STREAMED_UPLOAD = 256;
+static constexpr uint32_t STREAMED_UPLOAD_OCTAVES = 12; // Up to 1 MB
+static constexpr VkDeviceSize STREAMING_BUFFER_SIZE = 64ull << 20;
+
+static uint64_t PackFramebufferSize(int width, int height) noexcept
+{
+	return (static_cast<uint64_t>(width) << 32) | static_cast<uint32_t>(height);
+}
+
+static double GetMilliseconds(FramePacer::Clock::time_point start, FramePacer::Clock::time_point end) noexcept
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static const char* GetPacingName(FramePacing pacing) noexcept
+{
+	return pacing == FramePacing::LowLatency ? "low latency" : "throughput";
+}
+
+// The GPU timestamps wrap at their valid bits, the distance between two of them is taken the short way round
+static int64_t GetTickDistance(uint64_t from, uint64_t to, uint64_t mask) noexcept
+{
+	uint64_t difference = (to - from) & mask;
+	return difference > mask / 2 ? -static_cast<int64_t>(mask - difference + 1) : static_cast<int64_t>(difference);
+}
+
+static int64_t GetIntervalOverlap(int64_t begin, int64_t end, int64_t otherBegin, int64_t otherEnd) noexcept
+{
+	return std::max<int64_t>(std::min(end, otherEnd) - std::max(begin, otherBegin), 0);
+}
 
 #ifdef _DEBUG
 static VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pMessenger)
@@ -29,84 +82,224 @@ static VkResult DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsM
 }
 #endif
 
+Application::Application(const ApplicationOptions& options)
+	: m_Width(options.width), m_Height(options.height), m_Options(options)
+{
+	m_FramesInFlight = std::clamp(options.framesInFlight, MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
+	m_CachedCommands = options.cachedCommands;
+}
+
 Application::~Application()
 {
-	vkDestroySemaphore(m_Device, m_ImageAvailable, nullptr);
-	vkDestroySemaphore(m_Device, m_RenderFinished, nullptr);
-	vkDestroyFence(m_Device, m_InFlight, nullptr);
-	vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &m_CommandBuffer);
-	vkDestroyCommandPool(m_Device, m_CommandPool, nullptr);
+	StopRenderThread();
+
+	DestroyFrames();
+	m_Recorder.Destroy();
+	m_Jobs.Destroy();
+	m_Scheduler.Destroy();
+	m_GpuProfiler.Destroy();
+	m_ComputeProfiler.Destroy();
+	m_RenderGraph.Destroy();
+	m_ComputeGraph.Destroy();
+	vkDestroyCommandPool(m_Device, m_CommandPool, m_Callbacks);
+	vkDestroyCommandPool(m_Device, m_ComputeCommandPool, m_Callbacks);
 	for (auto framebuffer : m_Framebuffers)
-		vkDestroyFramebuffer(m_Device, framebuffer, nullptr);
+		vkDestroyFramebuffer(m_Device, framebuffer, m_Callbacks);
 
-	vkDestroyPipeline(m_Device, m_Pipeline, nullptr);
-	vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
-	vkDestroyRenderPass(m_Device, m_RenderPass, nullptr);
+	vkDestroyPipeline(m_Device, m_Pipeline, m_Callbacks);
+	m_PipelineCache.Save();
+	m_PipelineCache.Destroy();
+	vkDestroyPipelineLayout(m_Device, m_PipelineLayout, m_Callbacks);
+	vkDestroyRenderPass(m_Device, m_RenderPass, m_Callbacks);
 
 	for (auto imageView : m_ImageViews)
-		vkDestroyImageView(m_Device, imageView, nullptr);
+		vkDestroyImageView(m_Device, imageView, m_Callbacks);
+
+	for (auto image : m_OffscreenImages)
+		vkDestroyImage(m_Device, image, m_Callbacks);
+
+	for (auto& memory : m_OffscreenMemory)
+		m_Allocator.Free(memory);
+
+	m_Uploader.DestroyBuffer(m_VertexBuffer);
+	m_Uploader.DestroyBuffer(m_IndexBuffer);
+	m_Uploader.DestroyBuffer(m_InstanceBuffer);
+	m_Culling.Destroy();
+	m_Uploader.Destroy();
+	m_UploadEngine.Destroy();
+
+	// The swapchain and surface functions aren't enabled in the headless mode
+	if (m_Swapchain != VK_NULL_HANDLE)
+		vkDestroySwapchainKHR(m_Device, m_Swapchain, m_Callbacks);
 
-	vkDestroySwapchainKHR(m_Device, m_Swapchain, nullptr);
-	vkDestroyDevice(m_Device, nullptr);
-	vkDestroySurfaceKHR(m_Instance, m_Surface, nullptr);
+	DestroyRetiredSwapchains(true);
+	m_Allocator.Destroy();
+	vkDestroyDevice(m_Device, m_Callbacks);
+
+	if (m_Surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(m_Instance, m_Surface, m_Callbacks);
 #ifdef _DEBUG
-	DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, nullptr);
+	DestroyDebugUtilsMessengerEXT(m_Instance, m_DebugMessenger, m_Callbacks);
 #endif
-	vkDestroyInstance(m_Instance, nullptr);
+	vkDestroyInstance(m_Instance, m_Callbacks);
+
+	if (m_Options.headless)
+		return;
+
 	glfwDestroyWindow(m_Window);
 	glfwTerminate();
 }
 
 void Application::Run()
 {
-	InitGLFW();
-	InitWindow();
-	InitVkInstance();
-	InitSurface();
-	SelectDevice();
-	InitDevice();
-	InitSwapchain();
-	InitImageViews();
-	InitPipeline();
-	InitFramebuffers();
-	InitCommandPool();
-	InitCommandBuffer();
-	InitSynchObjects();
+	Init();
 
 	PrintLayersAndExtensions();
-#ifdef _DEBUG
-	InitDebugger();
-#endif // _DEBUG
 
 
-	RunMainLoop();
+	// There's no window to run the interactive loop in the headless mode
+	if (m_Options.benchmark || m_Options.headless)
+		RunBenchmark();
+	else
+		RunMainLoop();
+
+	WriteCpuTrace();
+}
+
+void Application::Init()
+{
+	InitStartupGraph();
+}
+
+void Application::WriteCpuTrace() const
+{
+	if (m_Options.cpuTracePath.empty())
+		return;
+
+#ifdef TRIANGLE_ENABLE_PROFILER
+	CpuProfiler::WriteChromeTrace(m_Options.cpuTracePath);
+	std::cout << "The CPU trace has been written to " << m_Options.cpuTracePath.string() << "\n";
+#else
+	std::cerr << "The CPU trace needs a build with TRIANGLE_ENABLE_PROFILER\n";
+#endif
+}
+
+void Application::WaitIdle()
+{
+	vkDeviceWaitIdle(m_Device);
+	ObservePresents(m_Scheduler.GetSubmittedFrame());
+}
+
+void Application::InitStartupGraph()
+{
+	// Both slots of the ring are filled by independent steps
+	m_Frames.resize(m_FramesInFlight);
+	m_CurrentFrame = 0;
+
+	StartupGraph graph;
+
+	StartupGraph::StepId instance, physicalDevice, swapchain;
+
+	if (m_Options.headless)
+	{
+		// Nothing is presented, so neither GLFW nor a surface is needed
+		instance = graph.AddStep("InitVkInstance", [this]() { InitVkInstance(); });
+		physicalDevice = graph.AddStep("SelectDevice", [this]() { SelectDevice(); }, { instance });
+	}
+	else
+	{
+		auto glfw = graph.AddStep("InitGLFW", [this]() { InitGLFW(); }, {}, StepAffinity::MainThread);
+		auto window = graph.AddStep("InitWindow", [this]() { InitWindow(); }, { glfw }, StepAffinity::MainThread);
+		instance = graph.AddStep("InitVkInstance", [this]() { InitVkInstance(); }, { glfw });
+		auto surface = graph.AddStep("InitSurface", [this]() { InitSurface(); }, { window, instance });
+		physicalDevice = graph.AddStep("SelectDevice", [this]() { SelectDevice(); }, { surface });
+	}
+
+#ifdef _DEBUG
+	graph.AddStep("InitDebugger", [this]() { InitDebugger(); }, { instance });
+#endif // _DEBUG
+	auto device = graph.AddStep("InitDevice", [this]() { InitDevice(); }, { physicalDevice });
+	auto pipelineCache = graph.AddStep("InitPipelineCache", [this]() { InitPipelineCache(); }, { device });
+	auto allocator = graph.AddStep("InitAllocator", [this]() { InitAllocator(); }, { device });
+	auto mesh = graph.AddStep("InitMesh", [this]() { InitMesh(); }, { allocator });
+	graph.AddStep("InitUploadEngine", [this]() { InitUploadEngine(); }, { allocator });
+
+	if (m_Options.headless)
+		swapchain = graph.AddStep("InitOffscreenTargets", [this]() { InitOffscreenTargets(); }, { allocator });
+	else
+		swapchain = graph.AddStep("InitSwapchain", [this]() { InitSwapchain(); }, { device });
+
+	auto imageViews = graph.AddStep("InitImageViews", [this]() { InitImageViews(); }, { swapchain });
+	auto shaders = graph.AddStep("LoadShaders", [this]() { LoadShaders(); });
+	auto pipelineLayout = graph.AddStep("InitPipelineLayout", [this]() { InitPipelineLayout(); }, { device });
+	auto renderPass = graph.AddStep("InitRenderPass", [this]() { InitRenderPass(); }, { swapchain }); // Needs the swapchain format
+	graph.AddStep("InitPipeline", [this]() { InitPipeline(); }, { shaders, pipelineLayout, renderPass, pipelineCache });
+	auto culling = graph.AddStep("InitCulling", [this]() { InitCulling(); }, { mesh, shaders, pipelineCache });
+	graph.AddStep("InitFramebuffers", [this]() { InitFramebuffers(); }, { imageViews, renderPass });
+	auto commandPool = graph.AddStep("InitCommandPool", [this]() { InitCommandPool(); }, { device });
+	graph.AddStep("InitCommandBuffers", [this]() { InitCommandBuffers(); }, { commandPool });
+	graph.AddStep("InitSynchObjects", [this]() { InitSynchObjects(); }, { device });
+	graph.AddStep("InitGpuProfiler", [this]() { InitGpuProfiler(); }, { device });
+	auto jobSystem = graph.AddStep("InitJobSystem", [this]() { InitJobSystem(); });
+	graph.AddStep("InitRecorder", [this]() { InitRecorder(); }, { device, jobSystem });
+	graph.AddStep("InitRenderGraph", [this]() { InitRenderGraph(); }, { allocator, culling });
+
+	// The graph is at most four steps wide, one of them runs on the main thread
+	uint32_t workerCount = std::clamp(std::thread::hardware_concurrency(), 2u, 4u) - 1;
+	graph.Run(workerCount);
+
+	graph.Report(std::cout);
+	m_RenderGraph.Report(std::cout);
+
+	if (IsAsyncComputeActive())
+		m_ComputeGraph.Report(std::cout, "COMPUTE GRAPH");
+
+	m_Allocator.Report(std::cout);
+	m_HostAllocator.Report(std::cout);
 }
 
 void Application::InitGLFW()
 {
 	if (!glfwInit())
-		throw std::runtime_error::exception("GLFW hasn't been initialized!");
+		throw std::runtime_error("GLFW hasn't been initialized!");
 }
 
 void Application::InitWindow()
 {
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	m_Window = glfwCreateWindow(m_Width, m_Height, m_Title.c_str(), nullptr, nullptr);
 
 	if (m_Window == nullptr)
-		throw std::runtime_error::exception("Window hasn't been created");
+		throw std::runtime_error("Window hasn't been created");
+
+	int width, height;
+	glfwGetFramebufferSize(m_Window, &width, &height);
+	m_FramebufferSize = PackFramebufferSize(width, height);
+
+	glfwSetWindowUserPointer(m_Window, this);
+	glfwSetFramebufferSizeCallback(m_Window, FramebufferResizeCallback);
 }
 
 void Application::InitVkInstance()
 {
 	// Required Vulkan extensions
-	const char* extensions[] = {
-		"VK_EXT_debug_utils",
-		"VK_KHR_surface",
-		"VK_KHR_win32_surface"
+	std::vector<const char*> extensions = {
+		"VK_EXT_debug_utils"
 	};
 
+	// The surface extensions of the current platform are reported by GLFW
+	if (!m_Options.headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		if (glfwExtensions == nullptr)
+			throw std::runtime_error("Vulkan surfaces aren't supported by GLFW!");
+
+		extensions.insert(extensions.end(), glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
+
 	// Required Vulkan layers
 	const char* layers[] = {
 		"VK_LAYER_KHRONOS_validation"
@@ -125,8 +318,8 @@ void Application::InitVkInstance()
 	VkInstanceCreateInfo instanceInfo{};
 	instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	instanceInfo.pApplicationInfo = &applicationInfo;
-	instanceInfo.enabledExtensionCount = sizeof(extensions) / sizeof(const char*); // Extension count
-	instanceInfo.ppEnabledExtensionNames = extensions; // Required extensions
+	instanceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size()); // Extension count
+	instanceInfo.ppEnabledExtensionNames = extensions.data(); // Required extensions
 
 #ifdef _DEBUG
 	VkDebugUtilsMessengerCreateInfoEXT debugInfo = GetDebugCreateInfo();
@@ -141,28 +334,42 @@ void Application::InitVkInstance()
 #endif // _DEBUG
 
 	// Creating the VkInstance object
-	if (vkCreateInstance(&instanceInfo, nullptr, &m_Instance) != VK_SUCCESS)
-		throw std::runtime_error::exception("Instance hasn't been created!");
+	if (vkCreateInstance(&instanceInfo, m_Callbacks, &m_Instance) != VK_SUCCESS)
+		throw std::runtime_error("Instance hasn't been created!");
 }
 
 void Application::InitSurface()
 {
-	if (glfwCreateWindowSurface(m_Instance, m_Window, nullptr, &m_Surface) != VK_SUCCESS)
-		throw std::runtime_error::exception("Surface hasn't been created!");
+	if (glfwCreateWindowSurface(m_Instance, m_Window, m_Callbacks, &m_Surface) != VK_SUCCESS)
+		throw std::runtime_error("Surface hasn't been created!");
 }
 
 void Application::SelectDevice()
 {
 	// The array of devices
-	std::vector<VkPhysicalDevice> devices;
+	FixedVector<VkPhysicalDevice, 16> devices;
 
 	uint32_t count;
 	vkEnumeratePhysicalDevices(m_Instance, &count, nullptr);
 
-	// Querying to the driver for the devices 
-	devices.resize(count);
+	// Querying to the driver for the devices, a machine with more than 16 only sees the first ones
+	count = devices.resize(count);
 	vkEnumeratePhysicalDevices(m_Instance, &count, devices.data());
 
+	// Preferring a discrete GPU, but any device will do (e.g. lavapipe on a machine without a GPU)
+	auto getDeviceRank = [](VkPhysicalDeviceType type) {
+		switch (type)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   return 4;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    return 2;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:            return 1;
+		default:                                     return 0;
+		}
+	};
+
+	int selectedRank = -1;
+
 	for (auto device : devices)
 	{
 		VkPhysicalDeviceProperties properties{};
@@ -173,76 +380,203 @@ void Application::SelectDevice()
 		// Getting the device's features
 		vkGetPhysicalDeviceFeatures(device, &features);
 
-		// Selecting the last discrete GPU
-		if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+		if (getDeviceRank(properties.deviceType) > selectedRank)
+		{
 			m_PhysicalDevice = device;
+			m_DeviceName = properties.deviceName;
+			selectedRank = getDeviceRank(properties.deviceType);
+		}
 	}
 
 	if (m_PhysicalDevice == VK_NULL_HANDLE)
-		throw std::runtime_error::exception("Physical device hasn't been found!");
+		throw std::runtime_error("Physical device hasn't been found!");
 
-	std::vector<VkQueueFamilyProperties> familyProps;
+	FixedVector<VkQueueFamilyProperties, 16> familyProps;
 
 	uint32_t queueFamilyPropsCount;
 	vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyPropsCount, nullptr);
 
 	// Query queue family properties of the selected physical device.
-	familyProps.resize(queueFamilyPropsCount);
+	queueFamilyPropsCount = familyProps.resize(queueFamilyPropsCount);
 	vkGetPhysicalDeviceQueueFamilyProperties(m_PhysicalDevice, &queueFamilyPropsCount, familyProps.data());
 
-	for (int i = 0; i < familyProps.size(); i++)
+	for (uint32_t i = 0; i < familyProps.size(); i++)
 	{
 		auto& familyProp = familyProps[i];
 
+		if (familyProp.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			m_Indices.graphicsIndex = i;
+
+		// A compute-only family is usually backed by its own hardware queues, which run beside the graphics queue
+		if ((familyProp.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(familyProp.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			m_Indices.computeIndex = i;
+
+		// Transfer-only families copy beside both the graphics and the compute queues
+		if ((familyProp.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(familyProp.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+			m_Indices.transferIndex = i;
+
+		// There's no surface to present to in the headless mode
+		if (m_Options.headless)
+			continue;
+
 		// Checking if the presentation queues are supported
 		VkBool32 presentationQueueSupported;
 		vkGetPhysicalDeviceSurfaceSupportKHR(m_PhysicalDevice, i, m_Surface, &presentationQueueSupported);
 
-		if (familyProp.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-			m_Indices.graphicsIndex = i;
-
 		if (presentationQueueSupported)
 			m_Indices.presentationIndex = i;
 	}
+
+	if (!m_Indices.graphicsIndex.has_value() || (!m_Options.headless && !m_Indices.IsCompleted()))
+		throw std::runtime_error("The required queue families haven't been found!");
 }
 
 void Application::InitDevice()
 {
-	const char* extensions[] = {
-		"VK_KHR_swapchain"
-	};
+	std::vector<const char*> extensions;
+
+	if (!m_Options.headless)
+		extensions.push_back("VK_KHR_swapchain");
 
 	float priority = 1.0;
 	
-	uint32_t queueIndices[] = {
-		m_Indices.graphicsIndex.value(),
-		m_Indices.presentationIndex.value()
-	};
-	VkDeviceQueueCreateInfo queueCreateInfos[2];
+	// A family can be requested only once, the presentation family is usually the graphics one
+	std::vector<uint32_t> queueIndices = { m_Indices.graphicsIndex.value() };
+
+	if (m_Indices.presentationIndex.has_value() && m_Indices.presentationIndex.value() != m_Indices.graphicsIndex.value())
+		queueIndices.push_back(m_Indices.presentationIndex.value());
+
+	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
 	// Creating the queues
-	for (int i = 0; i < sizeof(queueIndices) / sizeof(uint32_t); i++)
+	for (auto queueIndex : queueIndices)
 	{
 		VkDeviceQueueCreateInfo queueCreateInfo{};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo.queueFamilyIndex = queueIndices[i];
+		queueCreateInfo.queueFamilyIndex = queueIndex;
 		queueCreateInfo.queueCount = 1;
 		queueCreateInfo.pQueuePriorities = &priority; // Defines how the queues of the same family will be scheduled
 
-		queueCreateInfos[i] = queueCreateInfo;
+		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
 	VkPhysicalDeviceFeatures features{};
 	vkGetPhysicalDeviceFeatures(m_PhysicalDevice, &features);
 
+	// The frame scheduler is built on the Vulkan 1.2 timeline semaphores
+	VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+	supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	// The low latency pacing waits for the presents when the driver can report them
+	bool presentWaitExtensions = !m_Options.headless &&
+								 IsDeviceExtensionSupported("VK_KHR_present_id") && 
+								 IsDeviceExtensionSupported("VK_KHR_present_wait");
+
+	VkPhysicalDevicePresentWaitFeaturesKHR supportedPresentWait{};
+	supportedPresentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+	VkPhysicalDevicePresentIdFeaturesKHR supportedPresentId{};
+	supportedPresentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	supportedPresentId.pNext = &supportedPresentWait;
+
+	if (presentWaitExtensions)
+		supportedFeatures12.pNext = &supportedPresentId;
+
+	// The render graph and the upload engine record their barriers with the Vulkan 1.3 vkCmdPipelineBarrier2
+	VkPhysicalDeviceVulkan13Features supportedFeatures13{};
+	supportedFeatures13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	supportedFeatures13.pNext = &supportedFeatures12;
+
+	VkPhysicalDeviceFeatures2 supportedFeatures{};
+	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures.pNext = &supportedFeatures13;
+	vkGetPhysicalDeviceFeatures2(m_PhysicalDevice, &supportedFeatures);
+
+	if (!supportedFeatures12.timelineSemaphore)
+		throw std::runtime_error("Timeline semaphores aren't supported!");
+
+	if (!supportedFeatures13.synchronization2)
+		throw std::runtime_error("Synchronization2 isn't supported!");
+
+	m_PresentWaitSupported = presentWaitExtensions && supportedPresentId.presentId && supportedPresentWait.presentWait;
+
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.presentWait = VK_TRUE;
+
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentIdFeatures.presentId = VK_TRUE;
+	presentIdFeatures.pNext = &presentWaitFeatures;
+
+	// The GPU-driven path writes a draw per visible instance, selected by firstInstance
+	m_GpuDrivenSupported = supportedFeatures12.drawIndirectCount && features.multiDrawIndirect && features.drawIndirectFirstInstance;
+
+	// The culling is the work of the async compute queue, so it needs the GPU-driven path as well
+	m_AsyncCompute = m_Options.asyncCompute && m_Indices.computeIndex.has_value() && m_GpuDrivenSupported;
+
+	if (m_Options.asyncCompute && !m_AsyncCompute)
+		std::cerr << "The async compute needs a compute-only queue family and the GPU-driven drawing, culling on the graphics queue\n";
+
+	if (m_AsyncCompute && m_Indices.computeIndex != m_Indices.presentationIndex)
+	{
+		VkDeviceQueueCreateInfo queueCreateInfo{};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = m_Indices.computeIndex.value();
+		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.pQueuePriorities = &priority;
+
+		queueCreateInfos.push_back(queueCreateInfo);
+	}
+
+	// The upload engine shares the graphics queue when there's no transfer-only family
+	if (m_Indices.transferIndex.has_value() && m_Indices.transferIndex != m_Indices.presentationIndex)
+	{
+		VkDeviceQueueCreateInfo queueCreateInfo{};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = m_Indices.transferIndex.value();
+		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.pQueuePriorities = &priority;
+
+		queueCreateInfos.push_back(queueCreateInfo);
+	}
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+	m_MaxDrawIndirectCount = properties.limits.maxDrawIndirectCount;
+
+	VkPhysicalDeviceVulkan12Features features12{};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	features12.timelineSemaphore = VK_TRUE;
+	features12.drawIndirectCount = m_GpuDrivenSupported ? VK_TRUE : VK_FALSE;
+
+	VkPhysicalDeviceVulkan13Features features13{};
+	features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	features13.synchronization2 = VK_TRUE;
+	features13.pNext = &features12;
+
+	if (m_PresentWaitSupported)
+	{
+		extensions.push_back("VK_KHR_present_id");
+		extensions.push_back("VK_KHR_present_wait");
+		features12.pNext = &presentIdFeatures;
+	}
+
+	// Puts the GPU timestamps on the host clock, the timeline falls back to comparing durations without it
+	m_CalibratedTimestampsSupported = IsDeviceExtensionSupported("VK_EXT_calibrated_timestamps");
+
+	if (m_CalibratedTimestampsSupported)
+		extensions.push_back("VK_EXT_calibrated_timestamps");
+
 	// Creating the logical device
 	VkDeviceCreateInfo deviceInfo{};
 	deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceInfo.queueCreateInfoCount = sizeof(queueIndices) / sizeof(uint32_t);
-	deviceInfo.pQueueCreateInfos = queueCreateInfos;
+	deviceInfo.pNext = &features13;
+	deviceInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+	deviceInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceInfo.ppEnabledLayerNames = nullptr;
-	deviceInfo.ppEnabledExtensionNames = extensions;
-	deviceInfo.enabledExtensionCount = sizeof(extensions) / sizeof(const char*);
+	deviceInfo.ppEnabledExtensionNames = extensions.data();
+	deviceInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	deviceInfo.pEnabledFeatures = &features;
 
 #ifdef _DEBUG
@@ -255,11 +589,211 @@ void Application::InitDevice()
 	deviceInfo.ppEnabledLayerNames = layers;
 #endif // _DEBUG
 
-	if (vkCreateDevice(m_PhysicalDevice, &deviceInfo, nullptr, &m_Device) != VK_SUCCESS)
-		throw std::runtime_error::exception("Device hasn't been created!");
+	if (vkCreateDevice(m_PhysicalDevice, &deviceInfo, m_Callbacks, &m_Device) != VK_SUCCESS)
+		throw std::runtime_error("Device hasn't been created!");
 
 	vkGetDeviceQueue(m_Device, m_Indices.graphicsIndex.value(), 0, &m_GraphicsQueue);
-	vkGetDeviceQueue(m_Device, m_Indices.presentationIndex.value(), 0, &m_PresentationQueue);
+
+	if (m_Indices.presentationIndex.has_value())
+		vkGetDeviceQueue(m_Device, m_Indices.presentationIndex.value(), 0, &m_PresentationQueue);
+
+	if (m_AsyncCompute)
+		vkGetDeviceQueue(m_Device, m_Indices.computeIndex.value(), 0, &m_ComputeQueue);
+
+	if (m_Indices.transferIndex.has_value())
+		vkGetDeviceQueue(m_Device, m_Indices.transferIndex.value(), 0, &m_TransferQueue);
+	else
+		m_TransferQueue = m_GraphicsQueue;
+
+	if (m_PresentWaitSupported)
+	{
+		m_WaitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(m_Device, "vkWaitForPresentKHR"));
+		m_PresentWaitSupported = m_WaitForPresent != nullptr;
+	}
+
+	m_Scheduler.Init(m_Device, m_Callbacks);
+}
+
+void Application::InitPipelineCache()
+{
+	// Loaded from the working directory and written back in the destructor
+	m_PipelineCache.Init(m_PhysicalDevice, m_Device, std::filesystem::current_path(), m_Callbacks);
+}
+
+void Application::InitAllocator()
+{
+	m_Allocator.Init(m_PhysicalDevice, m_Device, m_Callbacks);
+}
+
+void Application::InitMesh()
+{
+	// The only step submitting during startup, so the graphics queue needs no lock
+	m_Uploader.Init(m_Device, m_Allocator, m_GraphicsQueue, m_Indices.graphicsIndex.value(), m_Callbacks);
+
+	Mesh mesh = CreateTriangleMesh();
+
+	// The bounding circle the culling pass scales with every instance
+	m_MeshRadius = 0.0f;
+	for (auto& vertex : mesh.vertices)
+		m_MeshRadius = std::max(m_MeshRadius, std::hypot(vertex.position[0], vertex.position[1]));
+
+	m_VertexBuffer = m_Uploader.UploadBuffer(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	m_IndexBuffer = m_Uploader.UploadBuffer(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	m_IndexCount = static_cast<uint32_t>(mesh.indices.size());
+
+	// Also read by the culling pass, which may run on the compute queue at the same time
+	std::vector<Instance> instances = CreateInstanceGrid(std::max(m_Options.instanceCount, 1u));
+	m_InstanceBuffer = m_Uploader.UploadBuffer(instances.data(), instances.size() * sizeof(Instance),
+											   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, GetComputeFamily());
+	m_InstanceCount = static_cast<uint32_t>(instances.size());
+}
+
+void Application::InitCulling()
+{
+	m_DrawPath = m_Options.drawPath;
+
+	if (!m_GpuDrivenSupported)
+	{
+		if (m_DrawPath == DrawPath::GpuDriven)
+		{
+			std::cerr << "The GPU-driven drawing isn't supported, using the instanced draw\n";
+			m_DrawPath = DrawPath::Instanced;
+		}
+
+		return;
+	}
+
+	m_Culling.Init(m_Device, m_Allocator, m_CullShader.code, m_CullShader.size, m_PipelineCache.GetHandle(),
+				   m_MaxDrawIndirectCount, m_Callbacks);
+	m_Culling.SetObjects(m_InstanceBuffer, m_InstanceCount, m_IndexCount, m_MeshRadius);
+
+	m_CullShaderOverride = std::vector<char>();
+	m_CullShader = {};
+}
+
+bool Application::SetDrawPath(DrawPath drawPath) noexcept
+{
+	if (drawPath == DrawPath::GpuDriven && !m_Culling.IsInitialized())
+		return false;
+
+	// The passes reading the draws change, the graph is compiled again before the next frame
+	m_RenderGraphDirty = m_RenderGraphDirty || drawPath != m_DrawPath;
+	m_DrawPath = drawPath;
+	return true;
+}
+
+void Application::SetInstanceCount(uint32_t count)
+{
+	m_Uploader.DestroyBuffer(m_InstanceBuffer);
+
+	std::vector<Instance> instances = CreateInstanceGrid(std::max(count, 1u));
+	m_InstanceBuffer = m_Uploader.UploadBuffer(instances.data(), instances.size() * sizeof(Instance),
+											   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, GetComputeFamily());
+	m_InstanceCount = static_cast<uint32_t>(instances.size());
+
+	if (m_Culling.IsInitialized())
+		m_Culling.SetObjects(m_InstanceBuffer, m_InstanceCount, m_IndexCount, m_MeshRadius);
+
+	// The draws and the bound instance buffer changed
+	MarkCommandsDirty();
+}
+
+UploadTimings Application::MeasureMeshUpload(const Mesh& mesh)
+{
+	// Created before the timing starts, a large buffer may get its own device memory allocation
+	DeviceBuffer vertexBuffer = m_Uploader.CreateDeviceBuffer(mesh.vertices.size() * sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	DeviceBuffer indexBuffer = m_Uploader.CreateDeviceBuffer(mesh.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+	auto start = std::chrono::steady_clock::now();
+
+	m_Uploader.WriteBuffer(vertexBuffer, mesh.vertices.data(), vertexBuffer.size);
+	m_Uploader.WriteBuffer(indexBuffer, mesh.indices.data(), indexBuffer.size);
+
+	UploadTimings timings;
+	timings.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	timings.bytes = vertexBuffer.size + indexBuffer.size;
+
+	m_Uploader.DestroyBuffer(vertexBuffer);
+	m_Uploader.DestroyBuffer(indexBuffer);
+
+	return timings;
+}
+
+void Application::InitUploadEngine()
+{
+	uint32_t family = m_Indices.transferIndex.value_or(m_Indices.graphicsIndex.value());
+	m_UploadEngine.Init(m_Device, m_Allocator, m_TransferQueue, family, m_Callbacks);
+}
+
+StreamingTimings Application::MeasureStreamingUploads(uint32_t frames, VkDeviceSize bytesPerFrame)
+{
+	using Clock = std::chrono::steady_clock;
+
+	typedef struct PendingUpload_t {
+		UploadEngine::Ticket ticket = 0;
+		Clock::time_point queued;
+	} PendingUpload;
+
+	// Shared with the graphics family like a streamed vertex buffer would be, the frames don't read it though
+	DeviceBuffer destination = m_UploadEngine.CreateBuffer(STREAMING_BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_Indices.graphicsIndex.value());
+	std::vector<uint8_t> source(MIN_STREAMED_UPLOAD << STREAMED_UPLOAD_OCTAVES, 0x5a);
+
+	std::vector<PendingUpload> pending;
+	size_t firstPending = 0;
+
+	StreamingTimings timings;
+	timings.frames.Reserve(frames);
+	m_UploadEngine.ResetStats();
+
+	// Log-uniform sizes from a fixed seed, so every run streams the same uploads
+	uint32_t random = 1;
+	VkDeviceSize destinationOffset = 0;
+
+	auto retire = [&](UploadEngine::Ticket completed) {
+		auto now = Clock::now();
+
+		for (; firstPending < pending.size() && pending[firstPending].ticket <= completed; firstPending++)
+			timings.latencies.push_back(std::chrono::duration<double, std::milli>(now - pending[firstPending].queued).count());
+	};
+
+	auto start = Clock::now();
+
+	for (uint32_t frame = 0; frame < frames && !ShouldClose(); frame++)
+	{
+		for (VkDeviceSize bytes = 0; bytes < bytesPerFrame;)
+		{
+			random = random * 1664525u + 1013904223u;
+			VkDeviceSize size = MIN_STREAMED_UPLOAD << ((random >> 24) % STREAMED_UPLOAD_OCTAVES);
+			size += size * ((random >> 8) & 0xff) / 256;
+
+			if (destinationOffset + size > destination.size)
+				destinationOffset = 0;
+
+			PendingUpload upload;
+			upload.queued = Clock::now();
+			upload.ticket = m_UploadEngine.UploadBuffer(source.data(), size, destination.buffer, destinationOffset);
+			pending.push_back(upload);
+
+			destinationOffset += size;
+			bytes += size;
+		}
+
+		m_UploadEngine.Flush();
+		timings.frames.Add(RenderFrame());
+
+		retire(m_UploadEngine.GetCompletedTicket());
+	}
+
+	UploadEngine::Ticket last = m_UploadEngine.Flush();
+	m_UploadEngine.Wait(last);
+	retire(last);
+
+	timings.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	timings.uploads = m_UploadEngine.GetStats();
+	m_UploadEngine.Report(std::cout);
+
+	m_UploadEngine.DestroyBuffer(destination);
+	return timings;
 }
 
 void Application::InitSwapchain()
@@ -270,9 +804,15 @@ void Application::InitSwapchain()
 	};
 
 
-	m_PresentMode = GetPresentMode(); // Defines how images are going to be submitted to the swapchain (used for the VSync)
+	// The format and the present mode are kept on recreation, so the render pass and the pipeline stay valid.
+	// Not keyed on m_Swapchain, a failed recreation leaves no swapchain behind
+	if (m_Format.format == VK_FORMAT_UNDEFINED)
+	{
+		m_PresentMode = GetPresentMode(); // Defines how images are going to be submitted to the swapchain (used for the VSync)
+		m_Format = GetSurfaceFormat();    // Defines the images' colour format
+	}
+
 	m_Extent = GetExtent2D();         // Defines the images' size
-	m_Format = GetSurfaceFormat();    // Defines the images' colour format
 
 	VkSurfaceCapabilitiesKHR surfaceCapabilities;
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_PhysicalDevice, m_Surface, &surfaceCapabilities);
@@ -291,7 +831,7 @@ void Application::InitSwapchain()
 	swapchainInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 	swapchainInfo.minImageCount = surfaceCapabilities.minImageCount;
 	swapchainInfo.clipped = VK_FALSE;
-	swapchainInfo.oldSwapchain = VK_NULL_HANDLE;
+	swapchainInfo.oldSwapchain = m_Swapchain; // Lets the driver reuse the resources of the swapchain being replaced
 
 	if ((queueIndices[0] == queueIndices[1])) // If the presentation family and the graphics family are the same
 	{
@@ -306,17 +846,61 @@ void Application::InitSwapchain()
 		swapchainInfo.queueFamilyIndexCount = 2; 
 	}
 
-	if (vkCreateSwapchainKHR(m_Device, &swapchainInfo, nullptr, &m_Swapchain) != VK_SUCCESS)
-		throw std::runtime_error::exception("Swapchain hasn't been created!");
+	// The handle is undefined when the creation fails, so the current one is only replaced on success
+	VkSwapchainKHR swapchain;
+	if (vkCreateSwapchainKHR(m_Device, &swapchainInfo, m_Callbacks, &swapchain) != VK_SUCCESS)
+		throw std::runtime_error("Swapchain hasn't been created!");
+
+	m_Swapchain = swapchain;
+}
+
+void Application::InitOffscreenTargets()
+{
+	// The headless mode renders into a ring of device images instead of the swapchain ones
+	m_Format = { VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+	m_Extent = { static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height) };
+
+	m_OffscreenImages.resize(OFFSCREEN_IMAGE_COUNT);
+	m_OffscreenMemory.resize(OFFSCREEN_IMAGE_COUNT);
+
+	for (uint32_t i = 0; i < OFFSCREEN_IMAGE_COUNT; i++)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = m_Format.format;
+		imageInfo.extent = { m_Extent.width, m_Extent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // Can be read back for inspection
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(m_Device, &imageInfo, m_Callbacks, &m_OffscreenImages[i]) != VK_SUCCESS)
+			throw std::runtime_error("An offscreen image hasn't been created!");
+
+		m_OffscreenMemory[i] = m_Allocator.AllocateImage(m_OffscreenImages[i], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
 }
 
 void Application::InitImageViews()
 {
-	uint32_t count;
-	vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &count, nullptr);
+	// Kept for the barriers of the render graph
+	std::vector<VkImage>& images = m_TargetImages;
+	images = m_OffscreenImages;
+
+	if (!m_Options.headless)
+	{
+		uint32_t count;
+		vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &count, nullptr);
+
+		images.resize(count);
+		vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &count, images.data());
+	}
 
-	std::vector<VkImage> images(count);
-	vkGetSwapchainImagesKHR(m_Device, m_Swapchain, &count, images.data());
+	uint32_t count = static_cast<uint32_t>(images.size());
 
 	m_ImageViews.resize(count);
 	for (int i = 0; i < images.size(); i++)
@@ -337,33 +921,93 @@ void Application::InitImageViews()
 		imageViewInfo.subresourceRange.levelCount = 1;
 		imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 
-		if (vkCreateImageView(m_Device, &imageViewInfo, nullptr, &m_ImageViews[i]) != VK_SUCCESS)
-			throw std::runtime_error::exception("An image view hasn't been created!");
+		if (vkCreateImageView(m_Device, &imageViewInfo, m_Callbacks, &m_ImageViews[i]) != VK_SUCCESS)
+			throw std::runtime_error("An image view hasn't been created!");
 	}
 }
 
+void Application::LoadShaders()
+{
+	// The SPIR-V compiled at build time is read straight from the executable's read-only data
+	m_VertexShader = { triangle_vert, sizeof(triangle_vert) };
+	m_FragmentShader = { triangle_frag, sizeof(triangle_frag) };
+	m_CullShader = { cull_comp, sizeof(cull_comp) };
+
+	if (m_Options.shaderDirectory.empty())
+		return;
+
+	m_VertexShaderOverride = LoadShaderSource(m_Options.shaderDirectory / "triangle.vert.spv");
+	m_FragmentShaderOverride = LoadShaderSource(m_Options.shaderDirectory / "triangle.frag.spv");
+	m_CullShaderOverride = LoadShaderSource(m_Options.shaderDirectory / "cull.comp.spv");
+
+	m_VertexShader = { reinterpret_cast<const uint32_t*>(m_VertexShaderOverride.data()), m_VertexShaderOverride.size() };
+	m_FragmentShader = { reinterpret_cast<const uint32_t*>(m_FragmentShaderOverride.data()), m_FragmentShaderOverride.size() };
+	m_CullShader = { reinterpret_cast<const uint32_t*>(m_CullShaderOverride.data()), m_CullShaderOverride.size() };
+}
+
+void Application::InitPipelineLayout()
+{
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+
+	if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, m_Callbacks, &m_PipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("Pipeline layout hasn't been created!");
+}
+
+void Application::InitRenderPass()
+{
+	VkAttachmentDescription colorAttachment{}; // Used to describe how to use the attached image
+	colorAttachment.format = m_Format.format;
+	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // The render graph transitions the image around the render pass
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentReference{}; // Structure that provides the information about an attachment to the shaders
+	colorAttachmentReference.attachment = 0; // Index of the corresponding attachment in the renderPassCreateInfo.pAttachments array.
+	colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorAttachmentReference; // Defines the array of attachments that is used as output parameters for the fragment shader layout(location = 0)
+														   // The first VkAttachmentReference corresponds to the first element of the pAttachments array of the render pass. See the line 484
+
+	VkRenderPassCreateInfo renderPassCreateInfo{};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.pAttachments = &colorAttachment; // This array contains the descriptions for each attachement (image) of the current frambuffer. 
+														  // The first VkAttachmentDescription corresponds to the first element of the pAttachments array of the current frambuffer. 
+														  // See InitFramebuffers line 551
+	renderPassCreateInfo.attachmentCount = 1;
+	renderPassCreateInfo.pSubpasses = &subpass;
+	renderPassCreateInfo.subpassCount = 1;
+
+	if (vkCreateRenderPass(m_Device, &renderPassCreateInfo, m_Callbacks, &m_RenderPass) != VK_SUCCESS)
+		throw std::runtime_error("Render pass hasn't been created!");
+}
+
 void Application::InitPipeline()
 {
-	std::vector<char> vertexShaderCode = LoadShaderSource("../../../Shaders/triangle.vspv");
+	// The SPIR-V code is selected by LoadShaders, possibly in parallel with the other steps
 	VkShaderModuleCreateInfo vertexShaderInfo{};
 	vertexShaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	vertexShaderInfo.pCode = reinterpret_cast<const uint32_t*>(vertexShaderCode.data());
-	vertexShaderInfo.codeSize = vertexShaderCode.size();
+	vertexShaderInfo.pCode = m_VertexShader.code;
+	vertexShaderInfo.codeSize = m_VertexShader.size;
 
-	std::vector<char> fragmentShaderCode = LoadShaderSource("../../../Shaders/triangle.fspv");
 	VkShaderModuleCreateInfo fragmentShaderInfo{};
 	fragmentShaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	fragmentShaderInfo.pCode = reinterpret_cast<const uint32_t*>(fragmentShaderCode.data());
-	fragmentShaderInfo.codeSize = fragmentShaderCode.size();
+	fragmentShaderInfo.pCode = m_FragmentShader.code;
+	fragmentShaderInfo.codeSize = m_FragmentShader.size;
 
 	VkShaderModule vertexShader;
 	VkShaderModule fragmentShader;
 
-	if (vkCreateShaderModule(m_Device, &vertexShaderInfo, nullptr, &vertexShader) != VK_SUCCESS)
-		throw std::runtime_error::exception("Vertex shader hasn't been created!");
+	if (vkCreateShaderModule(m_Device, &vertexShaderInfo, m_Callbacks, &vertexShader) != VK_SUCCESS)
+		throw std::runtime_error("Vertex shader hasn't been created!");
 
-	if (vkCreateShaderModule(m_Device, &fragmentShaderInfo, nullptr, &fragmentShader) != VK_SUCCESS)
-		throw std::runtime_error::exception("Fragment shader hasn't been created!");
+	if (vkCreateShaderModule(m_Device, &fragmentShaderInfo, m_Callbacks, &fragmentShader) != VK_SUCCESS)
+		throw std::runtime_error("Fragment shader hasn't been created!");
 
 	VkPipelineShaderStageCreateInfo vertexShaderStage{};
 	vertexShaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -379,12 +1023,22 @@ void Application::InitPipeline()
 
 	VkPipelineShaderStageCreateInfo stages[2] = { vertexShaderStage, fragmentShaderStage };
 
+	// Binding 0 advances per vertex, binding 1 per instance
+	VkVertexInputBindingDescription bindingDescriptions[] = { Vertex::GetBindingDescription(), Instance::GetBindingDescription() };
+
+	auto vertexAttributes = Vertex::GetAttributeDescriptions();
+	auto instanceAttributes = Instance::GetAttributeDescriptions();
+
+	std::array<VkVertexInputAttributeDescription, std::tuple_size_v<decltype(vertexAttributes)> + std::tuple_size_v<decltype(instanceAttributes)>> attributeDescriptions;
+	std::copy(vertexAttributes.begin(), vertexAttributes.end(), attributeDescriptions.begin());
+	std::copy(instanceAttributes.begin(), instanceAttributes.end(), attributeDescriptions.begin() + vertexAttributes.size());
+
 	VkPipelineVertexInputStateCreateInfo vertexInputStage{};
 	vertexInputStage.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputStage.vertexAttributeDescriptionCount = 0;
-	vertexInputStage.vertexBindingDescriptionCount = 0;
-	vertexInputStage.pVertexAttributeDescriptions = nullptr;
-	vertexInputStage.pVertexBindingDescriptions = nullptr;
+	vertexInputStage.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+	vertexInputStage.vertexBindingDescriptionCount = static_cast<uint32_t>(std::size(bindingDescriptions));
+	vertexInputStage.pVertexAttributeDescriptions = attributeDescriptions.data();
+	vertexInputStage.pVertexBindingDescriptions = bindingDescriptions;
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStage{};
 	inputAssemblyStage.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -452,63 +1106,6 @@ void Application::InitPipeline()
 	colorBlending.blendConstants[2] = 0.0f; // Optional
 	colorBlending.blendConstants[3] = 0.0f; // Optional
 
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-
-	if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
-	{
-		vkDestroyShaderModule(m_Device, vertexShader, nullptr);
-		vkDestroyShaderModule(m_Device, fragmentShader, nullptr);
-
-		throw std::runtime_error::exception("Pipeline layout hasn't been created!");
-	}
-
-	VkAttachmentDescription colorAttachment{}; // Used to describe how to use the attached image
-	colorAttachment.format = m_Format.format;
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference colorAttachmentReference{}; // Structure that provides the information about an attachment to the shaders
-	colorAttachmentReference.attachment = 0; // Index of the corresponding attachment in the renderPassCreateInfo.pAttachments array.
-	colorAttachmentReference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass{};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentReference; // Defines the array of attachments that is used as output parameters for the fragment shader layout(location = 0)
-														   // The first VkAttachmentReference corresponds to the first element of the pAttachments array of the render pass. See the line 484
-
-	VkRenderPassCreateInfo renderPassCreateInfo{};
-	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassCreateInfo.pAttachments = &colorAttachment; // This array contains the descriptions for each attachement (image) of the current frambuffer. 
-														  // The first VkAttachmentDescription corresponds to the first element of the pAttachments array of the current frambuffer. 
-														  // See InitFramebuffers line 551
-	renderPassCreateInfo.attachmentCount = 1;
-	renderPassCreateInfo.pSubpasses = &subpass;
-	renderPassCreateInfo.subpassCount = 1;
-
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	renderPassCreateInfo.dependencyCount = 1;
-	renderPassCreateInfo.pDependencies = &dependency;
-
-	if (vkCreateRenderPass(m_Device, &renderPassCreateInfo, nullptr, &m_RenderPass) != VK_SUCCESS)
-	{
-		vkDestroyShaderModule(m_Device, vertexShader, nullptr);
-		vkDestroyShaderModule(m_Device, fragmentShader, nullptr);
-
-		throw std::runtime_error::exception("Render pass hasn't been created!");
-	}
-
 	VkGraphicsPipelineCreateInfo graphicsPipeline{};
 	graphicsPipeline.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 	graphicsPipeline.pDynamicState = &dynamicStage;
@@ -525,16 +1122,28 @@ void Application::InitPipeline()
 	graphicsPipeline.renderPass = m_RenderPass;
 	graphicsPipeline.pViewportState = &viewportStage;
 
-	if (vkCreateGraphicsPipelines(m_Device, nullptr, 1, &graphicsPipeline, nullptr, &m_Pipeline) != VK_SUCCESS)
+	auto pipelineStart = std::chrono::steady_clock::now();
+
+	if (vkCreateGraphicsPipelines(m_Device, m_PipelineCache.GetHandle(), 1, &graphicsPipeline, m_Callbacks, &m_Pipeline) != VK_SUCCESS)
 	{
-		vkDestroyShaderModule(m_Device, vertexShader, nullptr);
-		vkDestroyShaderModule(m_Device, fragmentShader, nullptr);
+		vkDestroyShaderModule(m_Device, vertexShader, m_Callbacks);
+		vkDestroyShaderModule(m_Device, fragmentShader, m_Callbacks);
 
-		throw std::runtime_error::exception("Graphics pipeline hasn't been created!");
+		throw std::runtime_error("Graphics pipeline hasn't been created!");
 	}
 
-	vkDestroyShaderModule(m_Device, vertexShader, nullptr);
-	vkDestroyShaderModule(m_Device, fragmentShader, nullptr);
+	double pipelineMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pipelineStart).count();
+	std::cout << "Graphics pipeline created in " << pipelineMilliseconds << " ms ("
+			  << (m_PipelineCache.IsWarm() ? "warm" : "cold") << " pipeline cache)\n";
+
+	vkDestroyShaderModule(m_Device, vertexShader, m_Callbacks);
+	vkDestroyShaderModule(m_Device, fragmentShader, m_Callbacks);
+
+	// The overrides aren't needed once the modules are compiled
+	m_VertexShaderOverride = std::vector<char>();
+	m_FragmentShaderOverride = std::vector<char>();
+	m_VertexShader = {};
+	m_FragmentShader = {};
 }
 
 void Application::InitFramebuffers()
@@ -552,61 +1161,373 @@ void Application::InitFramebuffers()
 		createInfo.attachmentCount = 1;
 		createInfo.layers = 1;
 
-		if (vkCreateFramebuffer(m_Device, &createInfo, nullptr, &m_Framebuffers[i]) != VK_SUCCESS)
-			throw std::runtime_error::exception("A framebuffer hasn't been created!");
+		if (vkCreateFramebuffer(m_Device, &createInfo, m_Callbacks, &m_Framebuffers[i]) != VK_SUCCESS)
+			throw std::runtime_error("A framebuffer hasn't been created!");
+	}
+}
+
+void Application::InitCommandPool()
+{
+	VkCommandPoolCreateInfo commandPool{};
+	commandPool.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPool.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPool.queueFamilyIndex = m_Indices.graphicsIndex.value();
+	
+	if (vkCreateCommandPool(m_Device, &commandPool, m_Callbacks, &m_CommandPool) != VK_SUCCESS)
+		throw std::runtime_error("Command pool hasn't been created!");
+
+	if (!m_AsyncCompute)
+		return;
+
+	commandPool.queueFamilyIndex = m_Indices.computeIndex.value();
+
+	if (vkCreateCommandPool(m_Device, &commandPool, m_Callbacks, &m_ComputeCommandPool) != VK_SUCCESS)
+		throw std::runtime_error("The compute command pool hasn't been created!");
+}
+
+void Application::InitCommandBuffers()
+{
+	// Every slot of the ring gets its own command buffer, so the CPU never
+	// resets a buffer that the GPU may still be executing
+	for (auto& frame : m_Frames)
+	{
+		VkCommandBufferAllocateInfo commandBuffer{};
+		commandBuffer.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBuffer.commandPool = m_CommandPool;
+		commandBuffer.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBuffer.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(m_Device, &commandBuffer, &frame.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Command buffer hasn't been created!");
+
+		if (m_ComputeCommandPool == VK_NULL_HANDLE)
+			continue;
+
+		commandBuffer.commandPool = m_ComputeCommandPool;
+
+		if (vkAllocateCommandBuffers(m_Device, &commandBuffer, &frame.computeCommandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("The compute command buffer hasn't been created!");
+	}
+}
+
+void Application::InitSynchObjects()
+{
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// The binary semaphores are still needed to synchronize with the swapchain,
+	// the GPU progress itself is tracked by the frame scheduler
+	for (auto& frame : m_Frames)
+	{
+		if (vkCreateSemaphore(m_Device, &semaphoreInfo, m_Callbacks, &frame.imageAvailable) != VK_SUCCESS ||
+			vkCreateSemaphore(m_Device, &semaphoreInfo, m_Callbacks, &frame.renderFinished) != VK_SUCCESS)
+			throw std::runtime_error("A syncronization object hasn't been initialized!");
+
+		if (m_AsyncCompute && vkCreateSemaphore(m_Device, &semaphoreInfo, m_Callbacks, &frame.computeFinished) != VK_SUCCESS)
+			throw std::runtime_error("A syncronization object hasn't been initialized!");
+	}
+}
+
+void Application::InitGpuProfiler()
+{
+	m_GpuProfiler.Init(m_PhysicalDevice, m_Device, m_Indices.graphicsIndex.value(), m_Callbacks);
+
+	// Its frames are compared with the graphics frames to find the overlap
+	if (m_AsyncCompute)
+		m_ComputeProfiler.Init(m_PhysicalDevice, m_Device, m_Indices.computeIndex.value(), m_Callbacks);
+
+	if (m_CalibratedTimestampsSupported)
+		m_GpuProfiler.InitCalibration(m_Instance, m_PhysicalDevice);
+
+	if (!m_Options.gpuTracePath.empty())
+		m_GpuProfiler.OpenTrace(m_Options.gpuTracePath);
+
+	if (!m_Options.timelinePath.empty())
+		m_Timeline.OpenTrace(m_Options.timelinePath);
+}
+
+void Application::InitJobSystem()
+{
+	// The thread rendering the frames runs jobs as well while it waits for them
+	uint32_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	m_Jobs.Init(threadCount - 1);
+}
+
+void Application::InitRecorder()
+{
+	if (m_Options.recordThreads > 1)
+		m_Recorder.Init(m_Device, m_Indices.graphicsIndex.value(), m_Options.recordThreads, m_Jobs, m_Callbacks);
+}
+
+void Application::SetRecordThreads(uint32_t count)
+{
+	m_Recorder.Destroy();
+
+	if (count > 1)
+		m_Recorder.Init(m_Device, m_Indices.graphicsIndex.value(), count, m_Jobs, m_Callbacks);
+}
+
+void Application::SetCachedCommands(bool cached) noexcept
+{
+	// The cache may be stale from the last time it was used
+	m_CachedCommands = cached;
+	MarkCommandsDirty();
+}
+
+void Application::InitRenderGraph()
+{
+	m_RenderGraph.Init(m_Device, m_Indices.graphicsIndex.value(), m_Allocator, m_Callbacks);
+
+	if (m_AsyncCompute)
+		m_ComputeGraph.Init(m_Device, m_Indices.computeIndex.value(), m_Allocator, m_Callbacks);
+
+	BuildRenderGraph();
+}
+
+void Application::BuildRenderGraph()
+{
+	m_RenderGraph.Reset();
+	m_ComputeGraph.Reset();
+	m_RenderGraphDirty = false;
+	MarkCommandsDirty();
+
+	// The async compute hands the draws of its frame slot over to the graphics queue, nothing waits
+	// for the previous frame on the other queue before the slot is reused
+	bool async = IsAsyncComputeActive();
+
+	// The handles are set every frame, the instances and the draws are replaced with the instance count
+	m_GraphResources.target = m_RenderGraph.ImportImage("Target", VK_IMAGE_ASPECT_COLOR_BIT);
+	m_GraphResources.vertices = m_RenderGraph.ImportBuffer("Vertices");
+	m_GraphResources.indices = m_RenderGraph.ImportBuffer("Indices");
+	m_GraphResources.instances = m_RenderGraph.ImportBuffer("Instances");
+	m_GraphResources.draws = m_RenderGraph.ImportBuffer("Draws", !async);
+	m_GraphResources.drawCount = m_RenderGraph.ImportBuffer("DrawCount", !async);
+
+	if (async)
+	{
+		m_ComputeResources.instances = m_ComputeGraph.ImportBuffer("Instances");
+		m_ComputeResources.draws = m_ComputeGraph.ImportBuffer("Draws", false);
+		m_ComputeResources.drawCount = m_ComputeGraph.ImportBuffer("DrawCount", false);
+		AddCullingPasses(m_ComputeGraph, m_ComputeResources);
+
+		m_ComputeGraph.SetOutput(m_ComputeResources.draws, ResourceUsage::IndirectArguments, m_Indices.graphicsIndex.value());
+		m_ComputeGraph.SetOutput(m_ComputeResources.drawCount, ResourceUsage::IndirectArguments, m_Indices.graphicsIndex.value());
+		m_ComputeGraph.Compile();
+
+		m_RenderGraph.AcquireBuffer(m_GraphResources.draws, m_Indices.computeIndex.value());
+		m_RenderGraph.AcquireBuffer(m_GraphResources.drawCount, m_Indices.computeIndex.value());
+	}
+	else if (m_Culling.IsInitialized())
+	{
+		// Always declared, the graph culls them unless the render pass draws the culled instances
+		AddCullingPasses(m_RenderGraph, m_GraphResources);
+	}
+
+	auto renderPass = m_RenderGraph.AddPass("RenderPass", &RecordRenderPassCallback, this);
+	m_RenderGraph.Write(renderPass, m_GraphResources.target, ResourceUsage::ColorAttachment);
+	m_RenderGraph.Read(renderPass, m_GraphResources.vertices, ResourceUsage::VertexInput);
+	m_RenderGraph.Read(renderPass, m_GraphResources.indices, ResourceUsage::VertexInput);
+	m_RenderGraph.Read(renderPass, m_GraphResources.instances, ResourceUsage::VertexInput);
+
+	if (m_DrawPath == DrawPath::GpuDriven)
+	{
+		m_RenderGraph.Read(renderPass, m_GraphResources.draws, ResourceUsage::IndirectArguments);
+		m_RenderGraph.Read(renderPass, m_GraphResources.drawCount, ResourceUsage::IndirectArguments);
+	}
+
+	// The offscreen images can be read back
+	m_RenderGraph.SetOutput(m_GraphResources.target, m_Options.headless ? ResourceUsage::TransferSource : ResourceUsage::Present);
+	m_RenderGraph.Compile();
+}
+
+void Application::AddCullingPasses(RenderGraph& graph, const GraphResources& resources)
+{
+	auto clear = graph.AddPass("ClearDrawCount", &ClearDrawCountCallback, this);
+	graph.Write(clear, resources.drawCount, ResourceUsage::TransferDestination);
+
+	auto culling = graph.AddPass("Culling", &CullCallback, this);
+	graph.Read(culling, resources.instances, ResourceUsage::ComputeStorage);
+	graph.Write(culling, resources.draws, ResourceUsage::ComputeStorage);
+	graph.ReadWrite(culling, resources.drawCount, ResourceUsage::ComputeStorage);
+}
+
+void Application::ClearDrawCountCallback(void* application, VkCommandBuffer commandBuffer)
+{
+	Application* app = static_cast<Application*>(application);
+	app->m_Culling.ClearCount(commandBuffer, app->m_CurrentFrame);
+}
+
+void Application::CullCallback(void* application, VkCommandBuffer commandBuffer)
+{
+	Application* app = static_cast<Application*>(application);
+	app->m_Culling.Cull(commandBuffer, app->m_CurrentFrame);
+}
+
+void Application::DestroyFrames() noexcept
+{
+	for (auto& frame : m_Frames)
+	{
+		vkDestroySemaphore(m_Device, frame.imageAvailable, m_Callbacks);
+		vkDestroySemaphore(m_Device, frame.renderFinished, m_Callbacks);
+		vkDestroySemaphore(m_Device, frame.computeFinished, m_Callbacks);
+
+		if (frame.commandBuffer != VK_NULL_HANDLE)
+			vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &frame.commandBuffer);
+
+		if (frame.computeCommandBuffer != VK_NULL_HANDLE)
+			vkFreeCommandBuffers(m_Device, m_ComputeCommandPool, 1, &frame.computeCommandBuffer);
+
+		for (auto& cached : frame.cachedCommandBuffers)
+			vkFreeCommandBuffers(m_Device, m_CommandPool, 1, &cached.commandBuffer);
+	}
+
+	m_Frames.clear();
+}
+
+void Application::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	PROFILE_ZONE("RecordCommandBuffer");
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("Can't begin recording the command buffer!");
+
+	// The queries of the slot being recorded, the GPU is done with its previous frame
+	m_GpuProfiler.BeginFrame(commandBuffer, m_CurrentFrame, m_Scheduler.GetNextFrame());
+
+	// The imported handles change with the acquired image and with the instance count
+	m_RenderGraph.SetImage(m_GraphResources.target, m_TargetImages[imageIndex]);
+	m_RenderGraph.SetBuffer(m_GraphResources.vertices, m_VertexBuffer.buffer);
+	m_RenderGraph.SetBuffer(m_GraphResources.indices, m_IndexBuffer.buffer);
+	m_RenderGraph.SetBuffer(m_GraphResources.instances, m_InstanceBuffer.buffer);
+	m_RenderGraph.SetBuffer(m_GraphResources.draws, m_Culling.GetDrawBuffer(m_CurrentFrame));
+	m_RenderGraph.SetBuffer(m_GraphResources.drawCount, m_Culling.GetCountBuffer(m_CurrentFrame));
+
+	// Read by the render pass
+	m_ImageIndex = imageIndex;
+	m_RenderGraph.Execute(commandBuffer, m_GpuProfiler);
+
+	m_GpuProfiler.EndFrame(commandBuffer);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to record command buffer!");
+}
+
+void Application::ValidateCachedCommands(FrameData& frame)
+{
+	if (!m_CachedCommands || (frame.cacheVersion == m_CommandVersion && frame.cachedCommandBuffers.size() >= m_TargetImages.size()))
+		return;
+
+	// Only after a change, the slot's frame is complete so none of its command buffers are executing
+	ALLOW_FRAME_ALLOCATIONS();
+
+	VkCommandBufferAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.commandPool = m_CommandPool;
+	allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+
+	// The command buffers are kept when the image count shrinks, they're reset before they're recorded again
+	for (size_t i = frame.cachedCommandBuffers.size(); i < m_TargetImages.size(); i++)
+	{
+		CachedCommandBuffer cached;
+
+		if (vkAllocateCommandBuffers(m_Device, &allocateInfo, &cached.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("A cached command buffer hasn't been created!");
+
+		frame.cachedCommandBuffers.push_back(cached);
+	}
+
+	for (auto& cached : frame.cachedCommandBuffers)
+		cached.recorded = false;
+
+	frame.computeCached = false;
+	frame.cacheVersion = m_CommandVersion;
+}
+
+VkCommandBuffer Application::PrepareCommandBuffer(FrameData& frame, uint32_t imageIndex)
+{
+	if (!m_CachedCommands)
+	{
+		vkResetCommandBuffer(frame.commandBuffer, 0);
+		RecordCommandBuffer(frame.commandBuffer, imageIndex);
+		return frame.commandBuffer;
+	}
+
+	// Recorded for this slot and image, so its queries, draw buffers and framebuffer are the ones of the frame
+	CachedCommandBuffer& cached = frame.cachedCommandBuffers[imageIndex];
+
+	if (cached.recorded)
+	{
+		m_GpuProfiler.ReplayFrame(m_CurrentFrame, m_Scheduler.GetNextFrame());
+		return cached.commandBuffer;
 	}
-}
 
-void Application::InitCommandPool()
-{
-	VkCommandPoolCreateInfo commandPool{};
-	commandPool.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	commandPool.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	commandPool.queueFamilyIndex = m_Indices.graphicsIndex.value();
-	
-	if (vkCreateCommandPool(m_Device, &commandPool, nullptr, &m_CommandPool) != VK_SUCCESS)
-		throw std::runtime_error::exception("Command pool hasn't been created!");
+	vkResetCommandBuffer(cached.commandBuffer, 0);
+	RecordCommandBuffer(cached.commandBuffer, imageIndex);
+	cached.recorded = true;
+
+	return cached.commandBuffer;
 }
 
-void Application::InitCommandBuffer()
+void Application::RecordComputeCommandBuffer(VkCommandBuffer commandBuffer)
 {
-	VkCommandBufferAllocateInfo commandBuffer{};
-	commandBuffer.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	commandBuffer.commandPool = m_CommandPool;
-	commandBuffer.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	commandBuffer.commandBufferCount = 1;
+	PROFILE_ZONE("RecordComputeCommandBuffer");
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-	if (vkAllocateCommandBuffers(m_Device, &commandBuffer, &m_CommandBuffer) != VK_SUCCESS)
-		throw std::runtime_error::exception("Command buffer hasn't been created!");
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("Can't begin recording the compute command buffer!");
+
+	// Numbered like the graphics frame waiting for it
+	m_ComputeProfiler.BeginFrame(commandBuffer, m_CurrentFrame, m_Scheduler.GetNextFrame());
+
+	m_ComputeGraph.SetBuffer(m_ComputeResources.instances, m_InstanceBuffer.buffer);
+	m_ComputeGraph.SetBuffer(m_ComputeResources.draws, m_Culling.GetDrawBuffer(m_CurrentFrame));
+	m_ComputeGraph.SetBuffer(m_ComputeResources.drawCount, m_Culling.GetCountBuffer(m_CurrentFrame));
+	m_ComputeGraph.Execute(commandBuffer, m_ComputeProfiler);
+
+	m_ComputeProfiler.EndFrame(commandBuffer);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Can't record the compute command buffer!");
 }
 
-void Application::InitSynchObjects()
+void Application::SubmitCompute(FrameData& frame)
 {
-	VkSemaphoreCreateInfo semaphoreInfo{};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	// The compute commands only depend on the slot
+	if (m_CachedCommands && frame.computeCached)
+		m_ComputeProfiler.ReplayFrame(m_CurrentFrame, m_Scheduler.GetNextFrame());
+	else
+	{
+		vkResetCommandBuffer(frame.computeCommandBuffer, 0);
+		RecordComputeCommandBuffer(frame.computeCommandBuffer);
+		frame.computeCached = m_CachedCommands;
+	}
 
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	// The graphics submission of the frame waits for the draws, its completion on the timeline covers this one.
+	// Nothing waits for the graphics queue, the slot's previous frame is complete
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frame.computeCommandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &frame.computeFinished;
 
-	if (vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_ImageAvailable) != VK_SUCCESS ||
-		vkCreateSemaphore(m_Device, &semaphoreInfo, nullptr, &m_RenderFinished) != VK_SUCCESS ||
-		vkCreateFence(m_Device, &fenceInfo, nullptr, &m_InFlight) != VK_SUCCESS)
-		throw std::runtime_error::exception("A syncronization object hasn't been initialized!");
+	PROFILE_ZONE("vkQueueSubmit compute");
+	if (vkQueueSubmit(m_ComputeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		throw std::runtime_error("Can't submit the compute command buffer!");
 }
 
-void Application::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+void Application::RecordRenderPass(VkCommandBuffer commandBuffer)
 {
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	
-	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
-		throw std::runtime_error::exception("Can't begin recording the command buffer!");
-
 	VkRenderPassBeginInfo renderPassBeginInfo{};
 	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassBeginInfo.renderPass = m_RenderPass;
-	renderPassBeginInfo.framebuffer = m_Framebuffers[imageIndex];
+	renderPassBeginInfo.framebuffer = m_Framebuffers[m_ImageIndex];
 	renderPassBeginInfo.renderArea.offset = { 0, 0 };
 	renderPassBeginInfo.renderArea.extent = m_Extent;
 
@@ -614,7 +1535,40 @@ void Application::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 	renderPassBeginInfo.clearValueCount = 1;
 	renderPassBeginInfo.pClearValues = &clearColor;
 
-	vkCmdBeginRenderPass(m_CommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	// With several chunks the subpass is filled by the secondary command buffers of the recorder.
+	// The recorder resets them with their slot, so a cached command buffer records its draws inline
+	bool parallel = m_Recorder.GetChunkCount() > 1 && !m_CachedCommands;
+	vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+	if (parallel)
+	{
+		VkCommandBufferInheritanceInfo inheritance{};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = m_RenderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = m_Framebuffers[m_ImageIndex];
+
+		// Only vkCmdExecuteCommands may be recorded here, so there's no Draw scope in the GPU profile
+		uint32_t count = m_Recorder.Record(m_CurrentFrame, inheritance, GetDrawItemCount(), &Application::RecordDrawsCallback, this);
+		vkCmdExecuteCommands(commandBuffer, count, m_Recorder.GetCommandBuffers());
+	}
+	else
+	{
+		GpuScope drawScope(m_GpuProfiler, commandBuffer, "Draw");
+		RecordDraws(commandBuffer, 0, GetDrawItemCount());
+	}
+
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+void Application::RecordRenderPassCallback(void* application, VkCommandBuffer commandBuffer)
+{
+	static_cast<Application*>(application)->RecordRenderPass(commandBuffer);
+}
+
+void Application::RecordDraws(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)
+{
+	// A secondary command buffer doesn't inherit any state from the primary one
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline);
 
 	VkViewport viewport{};
@@ -631,12 +1585,31 @@ void Application::RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t im
 	scissor.offset = { 0, 0 };
 	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	VkBuffer vertexBuffers[] = { m_VertexBuffer.buffer, m_InstanceBuffer.buffer };
+	VkDeviceSize vertexOffsets[] = { 0, 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, vertexOffsets);
+	vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-	vkCmdEndRenderPass(commandBuffer);
+	switch (m_DrawPath)
+	{
+	case DrawPath::Instanced:
+		// Every instance of the mesh in a single draw
+		vkCmdDrawIndexed(commandBuffer, m_IndexCount, m_InstanceCount, 0, 0, 0);
+		break;
+	case DrawPath::PerObject:
+		// The baseline of the GPU-driven path, firstInstance selects the instance data
+		for (uint32_t i = first; i < first + count; i++)
+			vkCmdDrawIndexed(commandBuffer, m_IndexCount, 1, 0, 0, i);
+		break;
+	case DrawPath::GpuDriven:
+		m_Culling.Draw(commandBuffer, m_CurrentFrame);
+		break;
+	}
+}
 
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-		throw std::runtime_error("failed to record command buffer!");
+void Application::RecordDrawsCallback(void* application, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)
+{
+	static_cast<Application*>(application)->RecordDraws(commandBuffer, first, count);
 }
 
 #ifdef _DEBUG
@@ -660,8 +1633,8 @@ void Application::InitDebugger()
 {
 	VkDebugUtilsMessengerCreateInfoEXT debugInfo = GetDebugCreateInfo();
 
-	if (CreateDebugUtilsMessengerEXT(m_Instance, &debugInfo, nullptr, &m_DebugMessenger) != VK_SUCCESS)
-		throw std::runtime_error::exception("Debug messenger hasn't been created!");
+	if (CreateDebugUtilsMessengerEXT(m_Instance, &debugInfo, m_Callbacks, &m_DebugMessenger) != VK_SUCCESS)
+		throw std::runtime_error("Debug messenger hasn't been created!");
 }
 
 VkBool32 Application::DebugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageTypes, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
@@ -737,12 +1710,25 @@ std::vector<VkExtensionProperties>& Application::GetDeviceExtensionProperties()
 	return properties;
 }
 
+bool Application::IsDeviceExtensionSupported(const char* name) const noexcept
+{
+	auto& extensionProperties = GetDeviceExtensionProperties();
+
+	for (auto& prop : extensionProperties)
+	{
+		if (std::strcmp(prop.extensionName, name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
 std::vector<char> Application::LoadShaderSource(const std::filesystem::path& path) const
 {
 	std::ifstream file(path.c_str(), std::ios::ate | std::ios::binary);
 	
 	if (!file.is_open())
-		throw std::runtime_error::exception("Shader source hasn't been loaded!");
+		throw std::runtime_error("Shader source hasn't been loaded!");
 
 	size_t size = file.tellg();
 	std::vector<char> source(size);
@@ -760,9 +1746,19 @@ VkPresentModeKHR Application::GetPresentMode() const noexcept
 	uint32_t count;
 	vkGetPhysicalDeviceSurfacePresentModesKHR(m_PhysicalDevice, m_Surface, &count, nullptr);
 
-	std::vector<VkPresentModeKHR> presentModes(count);
+	// Runs on every swapchain recreation, which happens inside the frame loop
+	FixedVector<VkPresentModeKHR, 16> presentModes;
+	count = presentModes.resize(count);
 	vkGetPhysicalDeviceSurfacePresentModesKHR(m_PhysicalDevice, m_Surface, &count, presentModes.data());
 
+	if (m_Options.presentMode.has_value())
+	{
+		if (std::find(presentModes.cbegin(), presentModes.cend(), m_Options.presentMode.value()) != presentModes.cend())
+			return m_Options.presentMode.value();
+
+		std::cerr << "The requested present mode isn't supported, using the default one\n";
+	}
+
 	if (std::find(presentModes.cbegin(), presentModes.cend(), VK_PRESENT_MODE_MAILBOX_KHR) != presentModes.cend())
 		return VK_PRESENT_MODE_MAILBOX_KHR;
 
@@ -774,7 +1770,8 @@ VkSurfaceFormatKHR Application::GetSurfaceFormat() const noexcept
 	uint32_t count;
 	vkGetPhysicalDeviceSurfaceFormatsKHR(m_PhysicalDevice, m_Surface, &count, nullptr);
 
-	std::vector<VkSurfaceFormatKHR> formats(count);
+	FixedVector<VkSurfaceFormatKHR, 64> formats;
+	count = formats.resize(count);
 	vkGetPhysicalDeviceSurfaceFormatsKHR(m_PhysicalDevice, m_Surface, &count, formats.data());
 
 	for (auto& format : formats)
@@ -791,21 +1788,24 @@ VkExtent2D Application::GetExtent2D() const noexcept
 	VkSurfaceCapabilitiesKHR surfaceCapabilities;
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_PhysicalDevice, m_Surface, &surfaceCapabilities);
 
-	if (surfaceCapabilities.currentExtent.width == std::numeric_limits<uint32_t>::max()) 
+	// The special value means that the surface size is defined by the swapchain
+	if (surfaceCapabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) 
 	{
 		return surfaceCapabilities.currentExtent;
 	}
 
-	int width, height;
-	glfwGetFramebufferSize(m_Window, &width, &height);
+	// The size is published by the event thread, GLFW can only be queried there
+	uint64_t size = m_FramebufferSize.load(std::memory_order_acquire);
+	uint32_t width = static_cast<uint32_t>(size >> 32),
+			 height = static_cast<uint32_t>(size);
 
 	VkExtent2D extent{};
-	extent.width = std::clamp(static_cast<uint32_t>(width), 
+	extent.width = std::clamp(width, 
 							  surfaceCapabilities.minImageExtent.width, 
-							  surfaceCapabilities.currentExtent.width);
-	extent.height = std::clamp(static_cast<uint32_t>(width),
+							  surfaceCapabilities.maxImageExtent.width);
+	extent.height = std::clamp(height,
 							   surfaceCapabilities.minImageExtent.height,
-							   surfaceCapabilities.currentExtent.height);
+							   surfaceCapabilities.maxImageExtent.height);
 
 	return extent;
 }
@@ -847,48 +1847,576 @@ void Application::PrintLayersAndExtensions() const noexcept
 
 void Application::RunMainLoop()
 {
-	while (!glfwWindowShouldClose(m_Window))
+	PublishInput();
+
+	m_Running = true;
+	m_RenderThread = std::thread(&Application::RunRenderLoop, this);
+
+	// Slow event handling or a modal window drag only delays this thread, the frames keep going
+	while (m_Running.load(std::memory_order_acquire) && !glfwWindowShouldClose(m_Window))
 	{
-		glfwPollEvents();
-		DrawFrame();
+		glfwWaitEventsTimeout(INPUT_PUMP_INTERVAL);
+		PublishInput();
+	}
+
+	StopRenderThread();
+
+#ifdef TRIANGLE_TRACK_ALLOCATIONS
+	// Includes the first frames, which fill the caches and the pools
+	AllocationTracker::Report(std::cout);
+#endif
+
+	if (m_RenderError)
+		std::rethrow_exception(m_RenderError);
+}
+
+void Application::RunRenderLoop()
+{
+	PROFILE_THREAD("Render");
+
+	try
+	{
+		while (m_Running.load(std::memory_order_acquire))
+		{
+			PaceFrame();
+			SampleInput();
+
+			// A minimized window has nothing to present, sleeping until it's restored
+			if (IsMinimized())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				continue;
+			}
+
+			DrawFrame();
+			ReportGpuProfile();
+		}
+
+		vkDeviceWaitIdle(m_Device);
+
+		ObservePresents(m_Scheduler.GetSubmittedFrame());
+		m_Pacer.Report(GetPacingName(m_Options.pacing), std::cout);
+		m_Timeline.Report(std::cout);
+	}
+	catch (...)
+	{
+		m_RenderError = std::current_exception();
+		vkDeviceWaitIdle(m_Device);
+
+		// Waking up the event thread, so it can rethrow the error
+		m_Running = false;
+		glfwPostEmptyEvent();
 	}
+}
+
+void Application::StopRenderThread() noexcept
+{
+	m_Running = false;
+
+	if (m_RenderThread.joinable())
+		m_RenderThread.join();
+}
+
+bool Application::ShouldClose() const noexcept
+{
+	return !m_Options.headless && glfwWindowShouldClose(m_Window);
+}
+
+void Application::PollEvents()
+{
+	if (!m_Options.headless)
+		glfwPollEvents();
+}
+
+void Application::PublishInput()
+{
+	FrameInput input{};
+	input.sampleTime = FramePacer::Clock::now();
+
+	if (!m_Options.headless)
+		glfwGetCursorPos(m_Window, &input.cursorX, &input.cursorY);
+
+	m_Input.Publish(input);
+}
+
+void Application::SampleInput()
+{
+	m_FrameInput = m_Input.Consume();
+	m_InputSampleTime = m_FrameInput.sampleTime;
+}
+
+bool Application::IsMinimized() const noexcept
+{
+	uint64_t size = m_FramebufferSize.load(std::memory_order_acquire);
+	return (size >> 32) == 0 || static_cast<uint32_t>(size) == 0;
+}
+
+void Application::RunBenchmark()
+{
+	std::cout << "[BENCHMARK]:" << "\n\n";
+
+	for (uint32_t depth = MIN_FRAMES_IN_FLIGHT; depth <= MAX_FRAMES_IN_FLIGHT; depth++)
+		RunBenchmarkPass(depth, FramePacing::Throughput);
+
+	// The low latency pacing keeps a single frame queued, so the ring depth doesn't matter
+	RunBenchmarkPass(MIN_FRAMES_IN_FLIGHT, FramePacing::LowLatency);
+}
+
+void Application::RunBenchmarkPass(uint32_t framesInFlight, FramePacing pacing)
+{
+	using Clock = std::chrono::steady_clock;
+
+	if (ShouldClose())
+		return;
+
+	// Rebuilding the ring with the new depth
+	vkDeviceWaitIdle(m_Device);
+	ObservePresents(m_Scheduler.GetSubmittedFrame());
+	DestroyFrames();
+
+	m_FramesInFlight = framesInFlight;
+	m_Options.pacing = pacing;
+	m_Frames.resize(m_FramesInFlight);
+	m_CurrentFrame = 0;
+	InitCommandBuffers();
+	InitSynchObjects();
+
+	for (uint32_t i = 0; i < m_Options.benchmarkWarmupFrames && !ShouldClose(); i++)
+		RenderFrame();
+
+	vkDeviceWaitIdle(m_Device);
+	ObservePresents(m_Scheduler.GetSubmittedFrame());
+	m_Pacer.ResetStats();
+	m_Timeline.ResetStats();
+	m_HostAllocator.ResetCounters();
+#ifdef TRIANGLE_TRACK_ALLOCATIONS
+	AllocationTracker::ResetCounters();
+#endif
+
+	uint32_t frames = 0;
+	auto start = Clock::now();
+
+	for (; frames < m_Options.benchmarkFrames && !ShouldClose(); frames++)
+		RenderFrame();
 
+	// The last frames are only finished when the device is idle
 	vkDeviceWaitIdle(m_Device);
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	if (frames == 0)
+		return;
+
+	ObservePresents(m_Scheduler.GetSubmittedFrame());
+
+	std::cout << framesInFlight << " frames in flight, " << GetPacingName(pacing) << " pacing: "
+			  << frames / seconds << " frames/s, "
+			  << seconds * 1000.0 / frames << " ms/frame, "
+			  << GetTrianglesPerFrame() * frames / seconds / 1e6 << " M triangles/s ("
+			  << m_InstanceCount << " instances, " << GetDrawPathName(m_DrawPath) << ")\n";
+	m_Pacer.Report(GetPacingName(pacing), std::cout);
+
+	if (m_GpuProfiler.IsSupported())
+		m_GpuProfiler.Report(std::cout);
+
+	ReportAsyncCompute(std::cout);
+	m_Timeline.Report(std::cout);
+
+	// Whatever was allocated during the pass was allocated by the driver in the frame loop
+	m_HostAllocator.Report(std::cout);
+#ifdef TRIANGLE_TRACK_ALLOCATIONS
+	AllocationTracker::Report(std::cout);
+#endif
+}
+
+FrameTimings Application::RenderFrame()
+{
+	PaceFrame();
+	PollEvents();
+	PublishInput();
+	SampleInput();
+	DrawFrame();
+
+	return m_FrameTimings;
+}
+
+void Application::PaceFrame()
+{
+	if (m_Options.pacing != FramePacing::LowLatency)
+	{
+		// Only collecting the presents that have already happened
+		ObservePresents(0);
+		return;
+	}
+
+	// Keeping at most one frame queued: everything but the last submitted frame has to be presented
+	uint64_t newest = m_Pacer.GetNewestPendingFrame();
+	if (newest > 1)
+		ObservePresents(newest - 1);
+
+	// Delaying the input sampling and the recording until the GPU is about to finish the last frame
+	std::this_thread::sleep_until(m_Pacer.GetSampleDeadline());
+}
+
+void Application::ObservePresents(uint64_t waitFrame)
+{
+	uint64_t frame;
+
+	while ((frame = m_Pacer.GetOldestPendingFrame()) != 0)
+	{
+		bool wait = frame <= waitFrame;
+		bool presented = false;
+
+		if (m_PresentWaitSupported && !m_SwapchainDirty)
+		{
+			VkResult result = m_WaitForPresent(m_Device, m_Swapchain, frame, wait ? PRESENT_WAIT_TIMEOUT : 0);
+
+			if (result == VK_SUCCESS)
+				presented = true;
+			else if (result == VK_TIMEOUT && !wait)
+				break;
+		}
+
+		// Falling back to the GPU completion of the frame
+		if (!presented)
+		{
+			if (wait)
+				m_Scheduler.WaitForFrame(frame);
+			else if (!m_Scheduler.IsFrameComplete(frame))
+				break;
+		}
+
+		m_Pacer.OnPresented(frame, FramePacer::Clock::now());
+		m_PresentedFrame = frame;
+	}
 }
 
 void Application::DrawFrame()
 {
-	vkWaitForFences(m_Device, 1, &m_InFlight, VK_TRUE, UINT64_MAX);
-	vkResetFences(m_Device, 1, &m_InFlight);
+	PROFILE_ZONE("DrawFrame");
+	TRACK_FRAME_ALLOCATIONS("DrawFrame");
+
+	FrameData& frame = m_Frames[m_CurrentFrame];
+	m_FrameTimings = {};
+	m_FrameSpans = {};
+	m_FrameSpans.begin = FramePacer::Clock::now();
+
+	// Only waiting for the GPU to release this slot, the other slots may still be in flight
+	m_Scheduler.WaitForFrame(frame.frameNumber);
+
+	CollectGpuProfiles();
+	DestroyRetiredSwapchains(false);
+
+	if (m_RenderGraphDirty)
+	{
+		// Only after a draw path change, which waits for the device to be idle
+		ALLOW_FRAME_ALLOCATIONS();
+		BuildRenderGraph();
+	}
+
+	if (m_SwapchainDirty)
+	{
+		// A resize isn't the steady state, the new swapchain may allocate
+		{
+			ALLOW_FRAME_ALLOCATIONS();
+			RecreateSwapchain();
+		}
+
+		if (m_SwapchainDirty)
+			return;
+	}
+
+	ValidateCachedCommands(frame);
+
+	if (m_Options.headless)
+	{
+		DrawOffscreenFrame(frame);
+		return;
+	}
+
+	auto start = FramePacer::Clock::now();
 
 	uint32_t imageIndex;
-	vkAcquireNextImageKHR(m_Device, m_Swapchain, UINT64_MAX, m_ImageAvailable, nullptr, &imageIndex);
+	VkResult result;
+	{
+		PROFILE_ZONE("vkAcquireNextImageKHR");
+		result = vkAcquireNextImageKHR(m_Device, m_Swapchain, UINT64_MAX, frame.imageAvailable, nullptr, &imageIndex);
+	}
+	m_FrameTimings.acquire = GetMilliseconds(start, FramePacer::Clock::now());
 
-	vkResetCommandBuffer(m_CommandBuffer, 0);
-	RecordCommandBuffer(m_CommandBuffer, imageIndex);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		// Nothing has been signaled, so the frame can be skipped entirely
+		m_SwapchainDirty = true;
+		return;
+	}
+	else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		throw std::runtime_error("Can't acquire a swapchain image!");
+
+	// Only once the frame is certain to be submitted, the culling starts before the graphics work is recorded
+	bool async = IsAsyncComputeActive();
+	if (async)
+		SubmitCompute(frame);
+
+	m_FrameSpans.recordBegin = FramePacer::Clock::now();
+	VkCommandBuffer commandBuffer = PrepareCommandBuffer(frame, imageIndex);
+	m_FrameSpans.recordEnd = FramePacer::Clock::now();
 
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	// The draws of the async compute are first read by the indirect stage, which acquires them
+	VkSemaphore waitSemaphores[] = { frame.imageAvailable, frame.computeFinished };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT };
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pWaitSemaphores = &m_ImageAvailable;
+	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = async ? 2 : 1;
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &m_CommandBuffer;
+	submitInfo.pCommandBuffers = &commandBuffer;
 	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &m_RenderFinished;
+	submitInfo.pSignalSemaphores = &frame.renderFinished;
 
-	if (vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, m_InFlight) != VK_SUCCESS)
-		throw std::runtime_error::exception("Can't submit commands to the queue!");
+	m_FrameSpans.submitBegin = FramePacer::Clock::now();
+	{
+		PROFILE_ZONE("vkQueueSubmit");
+		frame.frameNumber = m_Scheduler.Submit(m_GraphicsQueue, submitInfo);
+	}
+	m_FrameSpans.submitEnd = FramePacer::Clock::now();
+	m_Pacer.OnSubmit(frame.frameNumber, m_InputSampleTime, m_FrameSpans.submitEnd);
+
+	// The frame number doubles as the present id, it grows with every present
+	VkPresentIdKHR presentId{};
+	presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentId.swapchainCount = 1;
+	presentId.pPresentIds = &frame.frameNumber;
 
 	VkPresentInfoKHR presentInfo{};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &m_RenderFinished;
+	presentInfo.pWaitSemaphores = &frame.renderFinished;
 	presentInfo.swapchainCount = 1;
 	presentInfo.pSwapchains = &m_Swapchain;
 	presentInfo.pImageIndices = &imageIndex;
 
-	vkQueuePresentKHR(m_PresentationQueue, &presentInfo);
+	if (m_PresentWaitSupported)
+		presentInfo.pNext = &presentId;
+
+	{
+		PROFILE_ZONE("vkQueuePresentKHR");
+		result = vkQueuePresentKHR(m_PresentationQueue, &presentInfo);
+	}
+	m_FrameSpans.presentEnd = FramePacer::Clock::now();
+	OnFrameSubmitted(frame.frameNumber);
+
+	// A suboptimal swapchain still presents, it's replaced before the next frame
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+		m_SwapchainDirty = true;
+	else if (result != VK_SUCCESS)
+		throw std::runtime_error("Can't present the swapchain image!");
+
+	m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesInFlight;
+}
+
+void Application::DrawOffscreenFrame(FrameData& frame)
+{
+	// The ring has an image for every possible frame in flight,
+	// so the image is free once the GPU has released the frame slot
+	uint32_t imageIndex = m_OffscreenIndex;
+	m_OffscreenIndex = (m_OffscreenIndex + 1) % OFFSCREEN_IMAGE_COUNT;
+
+	bool async = IsAsyncComputeActive();
+	if (async)
+		SubmitCompute(frame);
+
+	m_FrameSpans.recordBegin = FramePacer::Clock::now();
+	VkCommandBuffer commandBuffer = PrepareCommandBuffer(frame, imageIndex);
+	m_FrameSpans.recordEnd = FramePacer::Clock::now();
+
+	// Nothing to present, the timeline tells when the frame is done. Only the async compute is waited for
+	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pWaitSemaphores = &frame.computeFinished;
+	submitInfo.pWaitDstStageMask = &waitStage;
+	submitInfo.waitSemaphoreCount = async ? 1 : 0;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	m_FrameSpans.submitBegin = FramePacer::Clock::now();
+	{
+		PROFILE_ZONE("vkQueueSubmit");
+		frame.frameNumber = m_Scheduler.Submit(m_GraphicsQueue, submitInfo);
+	}
+	m_FrameSpans.submitEnd = FramePacer::Clock::now();
+	m_Pacer.OnSubmit(frame.frameNumber, m_InputSampleTime, m_FrameSpans.submitEnd);
+
+	m_FrameSpans.presentEnd = m_FrameSpans.submitEnd;
+	OnFrameSubmitted(frame.frameNumber);
+
+	m_CurrentFrame = (m_CurrentFrame + 1) % m_FramesInFlight;
+}
+
+void Application::OnFrameSubmitted(uint64_t frameNumber)
+{
+	m_FrameTimings.record = GetMilliseconds(m_FrameSpans.recordBegin, m_FrameSpans.recordEnd);
+	m_FrameTimings.submit = GetMilliseconds(m_FrameSpans.submitBegin, m_FrameSpans.submitEnd);
+
+	if (!m_Options.headless)
+		m_FrameTimings.present = GetMilliseconds(m_FrameSpans.submitEnd, m_FrameSpans.presentEnd);
+
+	m_Timeline.OnCpuFrame(frameNumber, m_FrameSpans);
+}
+
+void Application::CollectGpuProfiles()
+{
+	// The slot's frame is complete, its timestamps can be read without waiting
+	if (!m_GpuProfiler.Collect(m_CurrentFrame))
+		return;
+
+	m_FrameTimings.gpu = m_GpuProfiler.GetFrameTime();
+
+	if (m_GpuProfiler.IsCalibrated())
+		m_Timeline.OnGpuFrame(m_GpuProfiler.GetCollectedFrame(), m_GpuProfiler.GetFrameBegin(), m_GpuProfiler.GetFrameEnd());
+	else
+		m_Timeline.OnGpuFrameTime(m_GpuProfiler.GetCollectedFrame(), m_FrameTimings.gpu);
+
+	uint64_t frameNumber = m_GpuProfiler.GetCollectedFrame();
+	uint64_t begin = m_GpuProfiler.GetFrameBeginTicks();
+	uint64_t end = m_GpuProfiler.GetFrameEndTicks();
+
+	bool consecutive = m_PreviousGraphicsFrame + 1 == frameNumber;
+	uint64_t previousBegin = m_PreviousGraphicsBegin;
+	uint64_t previousEnd = m_PreviousGraphicsEnd;
+
+	m_PreviousGraphicsFrame = frameNumber;
+	m_PreviousGraphicsBegin = begin;
+	m_PreviousGraphicsEnd = end;
+
+	// The graphics frame waited for the compute frame of the same number, which ran alongside the graphics frame before
+	if (!m_ComputeProfiler.Collect(m_CurrentFrame) || m_ComputeProfiler.GetCollectedFrame() != frameNumber)
+		return;
+
+	m_FrameTimings.compute = m_ComputeProfiler.GetFrameTime();
+
+	// Both queues write their timestamps on the device clock, measured from the begin of the graphics frame
+	uint64_t mask = m_GpuProfiler.GetTimestampMask() & m_ComputeProfiler.GetTimestampMask();
+	int64_t computeBegin = GetTickDistance(begin, m_ComputeProfiler.GetFrameBeginTicks(), mask);
+	int64_t computeEnd = GetTickDistance(begin, m_ComputeProfiler.GetFrameEndTicks(), mask);
+
+	int64_t overlap = GetIntervalOverlap(computeBegin, computeEnd, 0, GetTickDistance(begin, end, mask));
+
+	if (consecutive)
+		overlap += GetIntervalOverlap(computeBegin, computeEnd, GetTickDistance(begin, previousBegin, mask), GetTickDistance(begin, previousEnd, mask));
+
+	m_FrameTimings.overlap = overlap * m_GpuProfiler.GetTimestampPeriod() / 1'000'000.0;
+	m_AverageOverlap += (m_FrameTimings.overlap - m_AverageOverlap) * OVERLAP_SMOOTHING;
+}
+
+void Application::ReportAsyncCompute(std::ostream& stream) const
+{
+	if (!IsAsyncComputeActive() || !m_ComputeProfiler.IsSupported())
+		return;
+
+	m_ComputeProfiler.Report(stream, "COMPUTE");
+	stream << "[ASYNC COMPUTE]: " << m_AverageOverlap << " ms overlapped with the graphics queue\n";
+}
+
+void Application::ReportGpuProfile()
+{
+	if (!m_Options.gpuProfile || !m_GpuProfiler.IsSupported())
+		return;
+
+	auto now = FramePacer::Clock::now();
+	if (now - m_GpuReportTime < std::chrono::seconds(1))
+		return;
+
+	m_GpuReportTime = now;
+	m_GpuProfiler.Report(std::cout);
+	ReportAsyncCompute(std::cout);
+	m_Timeline.Report(std::cout);
+}
+
+void Application::RecreateSwapchain()
+{
+	using Clock = std::chrono::steady_clock;
+
+	auto start = Clock::now();
+
+	// A zero-sized surface can't have a swapchain, keeping the old one until the window is restored
+	VkExtent2D extent = GetExtent2D();
+	if (extent.width == 0 || extent.height == 0)
+		return;
+
+	// The frames in flight may still render to the old images, so instead of waiting
+	// for the device to be idle the old objects are retired with the last submitted frame
+	RetiredSwapchain retired{};
+	retired.swapchain = m_Swapchain;
+	retired.imageViews = std::move(m_ImageViews);
+	retired.framebuffers = std::move(m_Framebuffers);
+	retired.frameNumber = m_Scheduler.GetSubmittedFrame();
+
+	m_ImageViews.clear();
+	m_Framebuffers.clear();
+
+	try
+	{
+		InitSwapchain(); // Passes the current swapchain as oldSwapchain
+	}
+	catch (...)
+	{
+		// The old swapchain is retired even when the creation fails, nothing can present to it anymore
+		m_Swapchain = VK_NULL_HANDLE;
+		m_RetiredSwapchains.push_back(std::move(retired));
+		throw;
+	}
+
+	m_RetiredSwapchains.push_back(std::move(retired));
+
+	// The render pass and the pipeline don't depend on the extent (the viewport and the scissor are dynamic),
+	// so only the objects referencing the new images are rebuilt
+	InitImageViews();
+	InitFramebuffers();
+
+	// The cached command buffers render to the old framebuffers
+	MarkCommandsDirty();
+	m_SwapchainDirty = false;
+
+	// The present ids of the pending frames belong to the old swapchain
+	m_Pacer.DiscardPending();
+
+	double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	std::cout << "Swapchain recreated (" << m_Extent.width << "x" << m_Extent.height << ") in " << milliseconds << " ms\n";
+}
+
+void Application::DestroyRetiredSwapchains(bool force)
+{
+	auto retired = m_RetiredSwapchains.begin();
+
+	while (retired != m_RetiredSwapchains.end())
+	{
+		// The present engine may still read the images once the GPU is done with the frame. The presents of a queue
+		// are processed in order, so the swapchain is free once a later frame is known to be presented
+		if (!force && (!m_Scheduler.IsFrameComplete(retired->frameNumber) || m_PresentedFrame <= retired->frameNumber))
+		{
+			retired++;
+			continue;
+		}
+
+		for (auto framebuffer : retired->framebuffers)
+			vkDestroyFramebuffer(m_Device, framebuffer, m_Callbacks);
+
+		for (auto imageView : retired->imageViews)
+			vkDestroyImageView(m_Device, imageView, m_Callbacks);
+
+		vkDestroySwapchainKHR(m_Device, retired->swapchain, m_Callbacks);
+
+		retired = m_RetiredSwapchains.erase(retired);
+	}
+}
+
+void Application::FramebufferResizeCallback(GLFWwindow* window, int width, int height)
+{
+	auto application = reinterpret_cast<Application*>(glfwGetWindowUserPointer(window));
+	application->m_FramebufferSize.store(PackFramebufferSize(width, height), std::memory_order_release);
+	application->m_SwapchainDirty = true;
 }
@@ -3,41 +3,265 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "FrameScheduler.h"
+#include "FramePacer.h"
+#include "TripleBuffer.h"
+#include "PipelineCache.h"
+#include "DeviceAllocator.h"
+#include "HostAllocator.h"
+#include "StagingUploader.h"
+#include "UploadEngine.h"
+#include "CullingPass.h"
+#include "JobSystem.h"
+#include "ParallelRecorder.h"
+#include "RenderGraph.h"
+#include "Mesh.h"
+#include "StartupGraph.h"
+#include "FrameStats.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "FrameTimeline.h"
+#include "AllocationTracker.h"
+
 #include <string>
 #include <vector>
 #include <optional>
 #include <filesystem>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <algorithm>
 
 typedef struct QueueFamilyIndices_t {
 	std::optional<uint32_t> graphicsIndex;
 	std::optional<uint32_t> presentationIndex;
+	std::optional<uint32_t> computeIndex; // A family with compute but without graphics, for the async compute
+	std::optional<uint32_t> transferIndex; // A family with transfer alone, usually the DMA engines, for the streamed uploads
 
 	inline bool IsCompleted() const noexcept { return graphicsIndex.has_value() && presentationIndex.has_value(); }
 } QueueFamilyIndices;
 
+// A command buffer recorded for a single frame slot and target image
+typedef struct CachedCommandBuffer_t {
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	bool recorded = false;
+} CachedCommandBuffer;
+
+// Per-slot objects of the frames-in-flight ring. The CPU records into one slot
+// while the GPU may still be executing the commands of the other slots.
+// The GPU progress of a slot is tracked by the frame scheduler's timeline semaphore.
+typedef struct FrameData_t {
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkSemaphore imageAvailable = VK_NULL_HANDLE;
+	VkSemaphore renderFinished = VK_NULL_HANDLE;
+	VkCommandBuffer computeCommandBuffer = VK_NULL_HANDLE; // Only with the async compute
+	VkSemaphore computeFinished = VK_NULL_HANDLE;          // Waited for by the graphics submission of the frame
+	uint64_t frameNumber = 0; // The last frame submitted from this slot
+
+	// With the cached command buffers, one per target image, submitted again until the commands are dirty
+	std::vector<CachedCommandBuffer> cachedCommandBuffers;
+	bool computeCached = false;  // The compute command buffer is submitted again as well
+	uint64_t cacheVersion = 0;   // The cache is dropped once it's behind the version of the application
+} FrameData;
+
+// Swapchain objects replaced by a recreation. They are destroyed once the last
+// frame that could have used them is complete and its present is done.
+typedef struct RetiredSwapchain_t {
+	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+	std::vector<VkImageView> imageViews;
+	std::vector<VkFramebuffer> framebuffers;
+	uint64_t frameNumber = 0;
+} RetiredSwapchain;
+
+// The input state handed from the event thread to the render thread
+typedef struct FrameInput_t {
+	double cursorX = 0.0,
+		   cursorY = 0.0;
+	FramePacer::Clock::time_point sampleTime;
+} FrameInput;
+
+// SPIR-V code used to create a shader module, either embedded into the executable or loaded from disk
+typedef struct ShaderCode_t {
+	const uint32_t* code = nullptr;
+	size_t size = 0; // In bytes
+} ShaderCode;
+
+// A measured upload of a mesh into device local buffers
+typedef struct UploadTimings_t {
+	VkDeviceSize bytes = 0;
+	double seconds = 0.0;
+} UploadTimings;
+
+// Uploads of mixed sizes streamed through the transfer queue while the frames render
+typedef struct StreamingTimings_t {
+	UploadEngine::Stats uploads;
+	double seconds = 0.0;
+	std::vector<double> latencies; // In milliseconds, from queuing an upload until its ticket is seen complete
+	FrameStats frames;
+} StreamingTimings;
+
+// The resources of the frame declared to the render graph
+typedef struct GraphResources_t {
+	RenderGraph::ResourceId target = 0; // The swapchain or the offscreen image
+	RenderGraph::ResourceId vertices = 0;
+	RenderGraph::ResourceId indices = 0;
+	RenderGraph::ResourceId instances = 0;
+	RenderGraph::ResourceId draws = 0;
+	RenderGraph::ResourceId drawCount = 0;
+} GraphResources;
+
+// How the instances are drawn
+enum class DrawPath {
+	Instanced,  // A single instanced draw
+	PerObject,  // One draw per instance, the recording cost grows with the instance count
+	GpuDriven   // Culled by a compute pass and drawn with vkCmdDrawIndexedIndirectCount
+};
+
+inline const char* GetDrawPathName(DrawPath drawPath) noexcept
+{
+	switch (drawPath)
+	{
+	case DrawPath::PerObject: return "per-object";
+	case DrawPath::GpuDriven: return "gpu-driven";
+	default:                  return "instanced";
+	}
+}
+
+typedef struct ApplicationOptions_t {
+	uint32_t framesInFlight = 2;
+	std::filesystem::path shaderDirectory; // Overrides the embedded shaders with <name>.spv files, used for development
+	FramePacing pacing = FramePacing::Throughput;
+
+	bool benchmark = false;        // Measures the throughput at every supported ring depth and exits
+	uint32_t benchmarkWarmupFrames = 100;
+	uint32_t benchmarkFrames = 1000;
+
+	bool headless = false;         // Renders into offscreen images without a window, implies the benchmark
+	int width = 600,
+		height = 400;
+	std::optional<VkPresentModeKHR> presentMode; // Used instead of the default choice when the surface supports it
+
+	bool gpuProfile = false;           // Prints the GPU time of every pass once a second
+	std::filesystem::path gpuTracePath; // Writes the GPU time of every pass of every frame as CSV
+	std::filesystem::path cpuTracePath; // Writes the CPU zones as a Chrome trace, needs TRIANGLE_ENABLE_PROFILER
+	std::filesystem::path timelinePath; // Writes the CPU and GPU spans of every frame as a Chrome trace
+
+	uint32_t instanceCount = 1;         // Draws the triangle this many times with a single instanced draw
+	DrawPath drawPath = DrawPath::Instanced;
+	uint32_t recordThreads = 1;         // More than one records the draws as jobs into this many secondary command buffers
+	bool asyncCompute = false;          // Culls on a compute-only queue, alongside the graphics work of the previous frame
+	bool cachedCommands = false;        // Records a command buffer per slot and target image once and submits it again
+} ApplicationOptions;
+
 class Application
 {
 public:
+	static constexpr uint32_t MIN_FRAMES_IN_FLIGHT = 2;
+	static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+	static constexpr uint32_t OFFSCREEN_IMAGE_COUNT = MAX_FRAMES_IN_FLIGHT;
+
 	Application() = default;
+	explicit Application(const ApplicationOptions& options);
 	~Application();
 
 	void Run();
+
+	// Used by the benchmark harness, which drives the frames itself instead of calling Run
+	void Init();
+	FrameTimings RenderFrame();
+	void WaitIdle();
+	bool ShouldClose() const noexcept;
+	void WriteCpuTrace() const;
+
+	// Uploads the vertex and index buffers of the mesh through the staging buffer and destroys them again.
+	// Only the copies are timed, not the creation of the buffers. Must not run while the render thread submits.
+	UploadTimings MeasureMeshUpload(const Mesh& mesh);
+
+	// Renders the frames while streaming this many bytes per frame through the upload engine.
+	// The completion is polled once per frame, so the latencies have the granularity of a frame
+	StreamingTimings MeasureStreamingUploads(uint32_t frames, VkDeviceSize bytesPerFrame);
+
+	// Both replace the instances or the way they are drawn between frames, the device has to be idle.
+	// Returns false if the path isn't supported by the device
+	bool SetDrawPath(DrawPath drawPath) noexcept;
+	void SetInstanceCount(uint32_t count);
+	void SetRecordThreads(uint32_t count);
+	void SetCachedCommands(bool cached) noexcept;
+
+	inline const std::string& GetDeviceName() const noexcept { return m_DeviceName; }
+	inline VkExtent2D GetExtent() const noexcept { return m_Extent; }
+	inline VkPresentModeKHR GetActivePresentMode() const noexcept { return m_PresentMode; }
+	inline uint32_t GetFramesInFlight() const noexcept { return m_FramesInFlight; }
+	inline bool IsGpuTimingSupported() const noexcept { return m_GpuProfiler.IsSupported(); }
+	inline uint32_t GetInstanceCount() const noexcept { return m_InstanceCount; }
+	inline DrawPath GetDrawPath() const noexcept { return m_DrawPath; }
+	inline uint32_t GetRecordThreads() const noexcept { return std::max(m_Recorder.GetChunkCount(), 1u); }
+	inline bool IsAsyncComputeActive() const noexcept { return m_AsyncCompute && m_DrawPath == DrawPath::GpuDriven; }
+	inline bool IsCachingCommands() const noexcept { return m_CachedCommands; }
+	inline uint64_t GetTrianglesPerFrame() const noexcept { return static_cast<uint64_t>(m_IndexCount / 3) * m_InstanceCount; }
 private:
+	void InitStartupGraph();
+
 	void InitGLFW();
 	void InitWindow();
 	void InitVkInstance();
 	void InitSurface();
 	void SelectDevice();
 	void InitDevice();
+	void InitPipelineCache();
+	void InitAllocator();
+	void InitMesh();
+	void InitUploadEngine();
+	void InitCulling();
 	void InitSwapchain();
+	void InitOffscreenTargets();
 	void InitImageViews();
+	void LoadShaders();
+	void InitPipelineLayout();
+	void InitRenderPass();
 	void InitPipeline();
 	void InitFramebuffers();
 	void InitCommandPool();
-	void InitCommandBuffer();
+	void InitCommandBuffers();
 	void InitSynchObjects();
+	void InitGpuProfiler();
+	void InitJobSystem();
+	void InitRecorder();
+	void InitRenderGraph();
+	void BuildRenderGraph();
+	void AddCullingPasses(RenderGraph& graph, const GraphResources& resources);
+
+	// The family sharing the instances with the graphics queue
+	inline uint32_t GetComputeFamily() const noexcept { return m_AsyncCompute ? m_Indices.computeIndex.value() : VK_QUEUE_FAMILY_IGNORED; }
+
+	void DestroyFrames() noexcept;
+
+	void RecreateSwapchain();
+	void DestroyRetiredSwapchains(bool force);
+
+	static void FramebufferResizeCallback(GLFWwindow* window, int width, int height);
 
 	void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+	// Everything recorded into the cached command buffers changed, like the swapchain, the graph or the instances
+	inline void MarkCommandsDirty() noexcept { m_CommandVersion++; }
+	void ValidateCachedCommands(FrameData& frame);
+
+	// Records the graphics commands of the frame, or returns the cached ones
+	VkCommandBuffer PrepareCommandBuffer(FrameData& frame, uint32_t imageIndex);
+	void RecordRenderPass(VkCommandBuffer commandBuffer);
+	static void RecordRenderPassCallback(void* application, VkCommandBuffer commandBuffer);
+
+	// The culling passes of the frame slot being recorded, on the graphics or the compute queue
+	static void ClearDrawCountCallback(void* application, VkCommandBuffer commandBuffer);
+	static void CullCallback(void* application, VkCommandBuffer commandBuffer);
+	void RecordComputeCommandBuffer(VkCommandBuffer commandBuffer);
+	void SubmitCompute(FrameData& frame);
+
+	// The per-object path splits into one item per instance, the other paths are a single item
+	inline uint32_t GetDrawItemCount() const noexcept { return m_DrawPath == DrawPath::PerObject ? m_InstanceCount : 1; }
+	void RecordDraws(VkCommandBuffer commandBuffer, uint32_t first, uint32_t count);
+	static void RecordDrawsCallback(void* application, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count);
 #ifdef _DEBUG
 	VkDebugUtilsMessengerCreateInfoEXT GetDebugCreateInfo() const noexcept;
 	void InitDebugger();
@@ -63,41 +287,134 @@ private:
 
 	void PrintLayersAndExtensions() const noexcept;
 
+	bool IsDeviceExtensionSupported(const char* name) const noexcept;
+
 	void RunMainLoop();
+	void RunRenderLoop();
+	void StopRenderThread() noexcept;
+	void PollEvents();
+	void PublishInput();
+	void SampleInput();
+	bool IsMinimized() const noexcept;
+	void RunBenchmark();
+	void RunBenchmarkPass(uint32_t framesInFlight, FramePacing pacing);
+	void PaceFrame();
+	void ObservePresents(uint64_t waitFrame);
 	void DrawFrame();
+	void DrawOffscreenFrame(FrameData& frame);
+	void OnFrameSubmitted(uint64_t frameNumber);
+	void CollectGpuProfiles();
+	void ReportGpuProfile();
+	void ReportAsyncCompute(std::ostream& stream) const;
 private:
+	// Declared first, the driver frees its host memory while every other member is destroyed
+	HostAllocator m_HostAllocator;
+	const VkAllocationCallbacks* m_Callbacks = m_HostAllocator.GetCallbacks();
+
 	int m_Width = 600,
 		m_Height = 400;
 
 	std::string m_Title = "Triangle Application";
 
-	GLFWwindow* m_Window;
+	GLFWwindow* m_Window = nullptr;
 
 	// Vulkan Artifacts
 	VkInstance m_Instance;
-	VkSurfaceKHR m_Surface;
+	VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
 	VkPhysicalDevice m_PhysicalDevice;
+	std::string m_DeviceName;
 	VkDevice m_Device;
 	VkQueue m_GraphicsQueue;
-	VkQueue m_PresentationQueue;
-	VkSwapchainKHR m_Swapchain;
+	VkQueue m_PresentationQueue = VK_NULL_HANDLE;
+	VkQueue m_ComputeQueue = VK_NULL_HANDLE;
+	VkQueue m_TransferQueue = VK_NULL_HANDLE; // The graphics queue without a transfer-only family
+	bool m_AsyncCompute = false; // The compute queue exists and the GPU-driven path is supported
+	VkSwapchainKHR m_Swapchain = VK_NULL_HANDLE;
+	std::vector<VkImage> m_TargetImages;        // The swapchain or the offscreen images
 	std::vector<VkImageView> m_ImageViews;
+	std::vector<VkImage> m_OffscreenImages;     // Headless render targets, replace the swapchain images
+	std::vector<DeviceAllocation> m_OffscreenMemory;
+	uint32_t m_OffscreenIndex = 0;
 	VkPipelineLayout m_PipelineLayout;
 	VkRenderPass m_RenderPass;
 	VkPipeline m_Pipeline;
+	ShaderCode m_VertexShader;
+	ShaderCode m_FragmentShader;
+	std::vector<char> m_VertexShaderOverride;
+	std::vector<char> m_FragmentShaderOverride;
+	ShaderCode m_CullShader;
+	std::vector<char> m_CullShaderOverride;
+	PipelineCache m_PipelineCache;
+	DeviceAllocator m_Allocator;
+	StagingUploader m_Uploader;
+	UploadEngine m_UploadEngine;
+	DeviceBuffer m_VertexBuffer;
+	DeviceBuffer m_IndexBuffer;
+	DeviceBuffer m_InstanceBuffer;
+	uint32_t m_IndexCount = 0;
+	uint32_t m_InstanceCount = 0;
+	float m_MeshRadius = 0.0f;
+	DrawPath m_DrawPath = DrawPath::Instanced;
+	CullingPass m_Culling;
+	bool m_GpuDrivenSupported = false; // drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance
+	uint32_t m_MaxDrawIndirectCount = 0;
 	std::vector<VkFramebuffer> m_Framebuffers;
+	std::vector<RetiredSwapchain> m_RetiredSwapchains;
+	std::atomic<bool> m_SwapchainDirty{ false };
 	VkCommandPool m_CommandPool;
-	VkCommandBuffer m_CommandBuffer;
-	VkSemaphore m_ImageAvailable;
-	VkSemaphore m_RenderFinished;
-	VkFence m_InFlight;
+	VkCommandPool m_ComputeCommandPool = VK_NULL_HANDLE;
+	JobSystem m_Jobs;
+	ParallelRecorder m_Recorder;
+	RenderGraph m_RenderGraph;
+	GraphResources m_GraphResources;
+	RenderGraph m_ComputeGraph;       // The culling, with the async compute only
+	GraphResources m_ComputeResources;
+	bool m_RenderGraphDirty = false;
+	bool m_CachedCommands = false;
+	uint64_t m_CommandVersion = 1; // The dirty flag of the cached command buffers, raised for every slot at once
+	uint32_t m_ImageIndex = 0; // The target of the frame being recorded
+	std::vector<FrameData> m_Frames;
+	FrameScheduler m_Scheduler;
+	FramePacer m_Pacer;
+	uint64_t m_PresentedFrame = 0; // The newest frame whose present is done, or whose GPU work is without present wait
+	FramePacer::Clock::time_point m_InputSampleTime;
+
+	GpuProfiler m_GpuProfiler;
+	GpuProfiler m_ComputeProfiler;
+	FramePacer::Clock::time_point m_GpuReportTime;
+
+	// The graphics frame the next compute frame may overlap with, and the average overlap in milliseconds
+	uint64_t m_PreviousGraphicsFrame = 0;
+	uint64_t m_PreviousGraphicsBegin = 0,
+			 m_PreviousGraphicsEnd = 0;
+	double m_AverageOverlap = 0.0;
+	bool m_CalibratedTimestampsSupported = false;
+	FrameTimeline m_Timeline;
+	FrameTimings m_FrameTimings;
+	CpuFrameSpans m_FrameSpans;
+
+	// VK_KHR_present_id + VK_KHR_present_wait, the GPU completion is used when they aren't supported
+	bool m_PresentWaitSupported = false;
+	PFN_vkWaitForPresentKHR m_WaitForPresent = nullptr;
 #ifdef _DEBUG
 	VkDebugUtilsMessengerEXT m_DebugMessenger;
 #endif
 
-	VkSurfaceFormatKHR m_Format;
+	VkSurfaceFormatKHR m_Format{}; // Undefined until the first swapchain or the offscreen targets pick it
 	VkPresentModeKHR m_PresentMode;
 	VkExtent2D m_Extent;
 
 	QueueFamilyIndices m_Indices;
+
+	// The main thread only pumps the GLFW events, the render thread owns the queue work
+	std::thread m_RenderThread;
+	std::atomic<bool> m_Running{ false };
+	std::exception_ptr m_RenderError;
+	std::atomic<uint64_t> m_FramebufferSize{ 0 }; // Width in the high half, height in the low half
+	TripleBuffer<FrameInput> m_Input;
+	FrameInput m_FrameInput;
+
+	ApplicationOptions m_Options;
+	uint32_t m_FramesInFlight = 2;
+	uint32_t m_CurrentFrame = 0;
 };
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "BuddyAllocator.h"
+
+#include <algorithm>
+
+BuddyAllocator::BuddyAllocator(uint64_t size)
+{
+	while (GetBlockSize(m_MaxOrder + 1) <= size)
+		m_MaxOrder++;
+
+	m_FreeBlocks.resize(m_MaxOrder + 1);
+	m_FreeBlocks[m_MaxOrder].insert(0);
+}
+
+std::optional<BuddyAllocator::Block> BuddyAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+	// The blocks are aligned to their own size
+	uint64_t required = std::max({ size, alignment, MIN_BLOCK_SIZE });
+
+	uint32_t order = 0;
+	while (GetBlockSize(order) < required)
+	{
+		if (++order > m_MaxOrder)
+			return std::nullopt;
+	}
+
+	// Finding the smallest free block that is large enough
+	uint32_t freeOrder = order;
+	while (freeOrder <= m_MaxOrder && m_FreeBlocks[freeOrder].empty())
+		freeOrder++;
+
+	if (freeOrder > m_MaxOrder)
+		return std::nullopt;
+
+	uint64_t offset = *m_FreeBlocks[freeOrder].begin();
+	m_FreeBlocks[freeOrder].erase(m_FreeBlocks[freeOrder].begin());
+
+	// Splitting it down to the requested order, the upper halves stay free
+	while (freeOrder > order)
+	{
+		freeOrder--;
+		m_FreeBlocks[freeOrder].insert(offset + GetBlockSize(freeOrder));
+	}
+
+	m_UsedSize += GetBlockSize(order);
+	return Block{ offset, order };
+}
+
+void BuddyAllocator::Free(const Block& block)
+{
+	uint64_t offset = block.offset;
+	uint32_t order = block.order;
+
+	m_UsedSize -= GetBlockSize(order);
+
+	// Merging with the buddy as long as it's free as well
+	while (order < m_MaxOrder)
+	{
+		uint64_t buddy = offset ^ GetBlockSize(order);
+
+		auto it = m_FreeBlocks[order].find(buddy);
+		if (it == m_FreeBlocks[order].end())
+			break;
+
+		m_FreeBlocks[order].erase(it);
+		offset = std::min(offset, buddy);
+		order++;
+	}
+
+	m_FreeBlocks[order].insert(offset);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <vector>
+
+// Splits a range into power-of-two blocks, a freed block is merged with its buddy when both are free.
+// A block of 2^n bytes always starts at a multiple of 2^n, so every alignment up to the block size is met.
+// Only the offsets are managed, the memory itself belongs to the caller.
+class BuddyAllocator
+{
+public:
+	typedef struct Block_t {
+		uint64_t offset = 0;
+		uint32_t order = 0; // The block is MIN_BLOCK_SIZE << order bytes
+	} Block;
+
+	static constexpr uint64_t MIN_BLOCK_SIZE = 256;
+
+	// The size is rounded down to a power of two
+	explicit BuddyAllocator(uint64_t size);
+
+	std::optional<Block> Allocate(uint64_t size, uint64_t alignment);
+	void Free(const Block& block);
+
+	inline uint64_t GetSize() const noexcept { return GetBlockSize(m_MaxOrder); }
+	inline uint64_t GetUsedSize() const noexcept { return m_UsedSize; }
+	inline bool IsEmpty() const noexcept { return m_UsedSize == 0; }
+
+	static inline uint64_t GetBlockSize(uint32_t order) noexcept { return MIN_BLOCK_SIZE << order; }
+private:
+	uint32_t m_MaxOrder = 0;
+	uint64_t m_UsedSize = 0;
+
+	// The free blocks of every order by their offset, the set finds a buddy in logarithmic time
+	std::vector<std::set<uint64_t>> m_FreeBlocks;
+};
@@ -0,0 +1,111 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+struct CpuProfiler::Registry {
+	std::mutex mutex; // Only taken when a thread is registered or the trace is written
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	// Calibrates the ticks against the steady clock
+	uint64_t startTicks = CpuProfiler::Now();
+	uint64_t startTime = CpuProfiler::GetClockTime();
+};
+
+CpuProfiler::Registry& CpuProfiler::GetRegistry()
+{
+	static Registry registry;
+	return registry;
+}
+
+CpuProfiler::ThreadBuffer* CpuProfiler::RegisterThread()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	auto buffer = std::make_unique<ThreadBuffer>();
+	buffer->events = std::make_unique<ZoneEvent[]>(EVENTS_PER_THREAD);
+	buffer->id = static_cast<uint32_t>(registry.buffers.size()) + 1;
+
+	registry.buffers.push_back(std::move(buffer));
+	return registry.buffers.back().get();
+}
+
+void CpuProfiler::SetThreadName(const char* name)
+{
+	GetThreadBuffer().name.store(name, std::memory_order_release);
+}
+
+void CpuProfiler::WriteChromeTrace(const std::filesystem::path& path)
+{
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("Can't open the CPU trace file!");
+
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	typedef struct Zone_t {
+		const char* name;
+		uint64_t begin, end;
+	} Zone;
+
+	std::vector<Zone> events(EVENTS_PER_THREAD);
+	bool first = true;
+
+	auto separator = [&]() -> const char* {
+		const char* result = first ? "\n" : ",\n";
+		first = false;
+		return result;
+	};
+
+	uint64_t elapsedTicks = CpuProfiler::Now() - registry.startTicks;
+	uint64_t elapsedTime = CpuProfiler::GetClockTime() - registry.startTime;
+	double nanosecondsPerTick = elapsedTicks > 0 ? static_cast<double>(elapsedTime) / elapsedTicks : 1.0;
+
+	// The Chrome trace format uses microseconds
+	auto toMicroseconds = [&](uint64_t ticks) { return (ticks - std::min(ticks, registry.startTicks)) * nanosecondsPerTick / 1000.0; };
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+	for (auto& buffer : registry.buffers)
+	{
+		const char* name = buffer->name.load(std::memory_order_acquire);
+		if (name != nullptr)
+		{
+			file << separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+				 << ",\"args\":{\"name\":\"" << name << "\"}}";
+		}
+
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t oldest = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+
+		for (uint64_t i = oldest; i < head; i++)
+		{
+			const ZoneEvent& event = buffer->events[i % EVENTS_PER_THREAD];
+			events[i - oldest] = { event.name.load(std::memory_order_relaxed), event.begin.load(std::memory_order_relaxed),
+								   event.end.load(std::memory_order_relaxed) };
+		}
+
+		// The owner may have overwritten the oldest zones while they were copied,
+		// the slot being written right now is the one after the new head minus the capacity.
+		// A copied zone written after the head was read makes this load see the new head
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t newHead = buffer->head.load(std::memory_order_relaxed);
+		uint64_t valid = newHead >= EVENTS_PER_THREAD ? newHead - EVENTS_PER_THREAD + 1 : 0;
+
+		for (uint64_t i = std::max(oldest, valid); i < head; i++)
+		{
+			const Zone& event = events[i - oldest];
+
+			file << separator() << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+				 << ",\"ts\":" << toMicroseconds(event.begin) << ",\"dur\":" << (event.end - event.begin) * nanosecondsPerTick / 1000.0 << "}";
+		}
+	}
+
+	file << "\n]}\n";
+}
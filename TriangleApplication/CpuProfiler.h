@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRIANGLE_PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRIANGLE_PROFILER_TSC
+#endif
+
+// Records the CPU time of the instrumented zones into per-thread ring buffers.
+// A thread only ever writes to its own buffer, so recording a zone takes two clock reads
+// and a store without any locking. The zones are timed with the TSC where it's available,
+// the ticks are converted to nanoseconds when the trace is written. The buffers are exported as a Chrome trace (chrome://tracing, Perfetto).
+//
+// The PROFILE_* macros compile to nothing unless TRIANGLE_ENABLE_PROFILER is defined.
+class CpuProfiler
+{
+public:
+	static constexpr uint32_t EVENTS_PER_THREAD = 1 << 15; // The oldest zones are overwritten
+
+	// Ticks of the TSC, or nanoseconds of the steady clock where there's no TSC
+	static inline uint64_t Now() noexcept
+	{
+#ifdef TRIANGLE_PROFILER_TSC
+		return __rdtsc();
+#else
+		return GetClockTime();
+#endif
+	}
+
+	static inline uint64_t GetClockTime() noexcept
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static inline void Record(const char* name, uint64_t begin, uint64_t end) noexcept
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+
+		uint64_t head = buffer.head.load(std::memory_order_relaxed);
+		ZoneEvent& event = buffer.events[head % EVENTS_PER_THREAD];
+
+		// Keeps the stores after the previous head, so an export reading them also sees that the slot is reused
+		std::atomic_thread_fence(std::memory_order_release);
+		event.name.store(name, std::memory_order_relaxed);
+		event.begin.store(begin, std::memory_order_relaxed);
+		event.end.store(end, std::memory_order_relaxed);
+		buffer.head.store(head + 1, std::memory_order_release);
+	}
+
+	// The name has to outlive the profiler, e.g. a string literal
+	static void SetThreadName(const char* name);
+
+	// Can be called while the other threads are recording, the zones overwritten during the copy are dropped
+	static void WriteChromeTrace(const std::filesystem::path& path);
+private:
+	// Relaxed atomics, the export may read a slot while its thread overwrites it
+	typedef struct ZoneEvent_t {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> begin{ 0 },
+							  end{ 0 };
+	} ZoneEvent;
+
+	typedef struct ThreadBuffer_t {
+		std::unique_ptr<ZoneEvent[]> events;
+		std::atomic<uint64_t> head{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		uint32_t id = 0;
+	} ThreadBuffer;
+
+	static inline ThreadBuffer& GetThreadBuffer() noexcept
+	{
+		// Registered once per thread, the registry keeps the buffer alive after the thread exits
+		thread_local ThreadBuffer* buffer = RegisterThread();
+		return *buffer;
+	}
+
+	struct Registry;
+
+	static Registry& GetRegistry();
+	static ThreadBuffer* RegisterThread();
+};
+
+// Records the enclosing C++ scope as a zone
+class CpuZone
+{
+public:
+	explicit CpuZone(const char* name) noexcept
+		: m_Name(name), m_Begin(CpuProfiler::Now())
+	{
+	}
+
+	~CpuZone()
+	{
+		CpuProfiler::Record(m_Name, m_Begin, CpuProfiler::Now());
+	}
+
+	CpuZone(const CpuZone&) = delete;
+	CpuZone& operator=(const CpuZone&) = delete;
+private:
+	const char* m_Name;
+	uint64_t m_Begin;
+};
+
+#ifdef TRIANGLE_ENABLE_PROFILER
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) CpuZone PROFILER_CONCAT(profilerZone, __LINE__)(name)
+#define PROFILE_THREAD(name) CpuProfiler::SetThreadName(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
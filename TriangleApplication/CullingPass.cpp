@@ -0,0 +1,230 @@
+#include "CullingPass.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void CullingPass::Init(VkDevice device, DeviceAllocator& allocator, const uint32_t* code, size_t codeSize,
+					   VkPipelineCache pipelineCache, uint32_t maxDrawIndirectCount, const VkAllocationCallbacks* callbacks)
+{
+	m_Device = device;
+	m_Allocator = &allocator;
+	m_Callbacks = callbacks;
+	m_MaxDrawIndirectCount = maxDrawIndirectCount;
+
+	// The instances, the draws and the count
+	VkDescriptorSetLayoutBinding bindings[3]{};
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = 3;
+	setLayoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(m_Device, &setLayoutInfo, m_Callbacks, &m_SetLayout) != VK_SUCCESS)
+		throw std::runtime_error("The culling descriptor set layout hasn't been created!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = 3 * MAX_SLOTS;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = MAX_SLOTS;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(m_Device, &poolInfo, m_Callbacks, &m_DescriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("The culling descriptor pool hasn't been created!");
+
+	std::array<VkDescriptorSetLayout, MAX_SLOTS> setLayouts;
+	setLayouts.fill(m_SetLayout);
+
+	std::array<VkDescriptorSet, MAX_SLOTS> sets{};
+
+	VkDescriptorSetAllocateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = m_DescriptorPool;
+	setInfo.descriptorSetCount = MAX_SLOTS;
+	setInfo.pSetLayouts = setLayouts.data();
+
+	if (vkAllocateDescriptorSets(m_Device, &setInfo, sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("The culling descriptor sets haven't been allocated!");
+
+	for (uint32_t i = 0; i < MAX_SLOTS; i++)
+		m_Slots[i].descriptorSet = sets[i];
+
+	VkPushConstantRange pushConstants{};
+	pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstants.offset = 0;
+	pushConstants.size = sizeof(CullingConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_SetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+
+	if (vkCreatePipelineLayout(m_Device, &pipelineLayoutInfo, m_Callbacks, &m_PipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("The culling pipeline layout hasn't been created!");
+
+	VkShaderModuleCreateInfo shaderInfo{};
+	shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderInfo.pCode = code;
+	shaderInfo.codeSize = codeSize;
+
+	VkShaderModule shader;
+	if (vkCreateShaderModule(m_Device, &shaderInfo, m_Callbacks, &shader) != VK_SUCCESS)
+		throw std::runtime_error("The culling shader hasn't been created!");
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = m_PipelineLayout;
+
+	VkResult result = vkCreateComputePipelines(m_Device, pipelineCache, 1, &pipelineInfo, m_Callbacks, &m_Pipeline);
+	vkDestroyShaderModule(m_Device, shader, m_Callbacks);
+
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("The culling pipeline hasn't been created!");
+
+	// Without a camera the frustum is the clip space square
+	const float planes[4][4] = {
+		{  1.0f,  0.0f, 1.0f, 0.0f },
+		{ -1.0f,  0.0f, 1.0f, 0.0f },
+		{  0.0f,  1.0f, 1.0f, 0.0f },
+		{  0.0f, -1.0f, 1.0f, 0.0f }
+	};
+	std::copy(&planes[0][0], &planes[0][0] + 16, &m_Constants.planes[0][0]);
+}
+
+void CullingPass::Destroy() noexcept
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	for (auto& slot : m_Slots)
+	{
+		DestroyBuffer(slot.drawBuffer);
+		DestroyBuffer(slot.countBuffer);
+		slot.descriptorSet = VK_NULL_HANDLE;
+	}
+
+	vkDestroyPipeline(m_Device, m_Pipeline, m_Callbacks);
+	vkDestroyPipelineLayout(m_Device, m_PipelineLayout, m_Callbacks);
+	vkDestroyDescriptorPool(m_Device, m_DescriptorPool, m_Callbacks);
+	vkDestroyDescriptorSetLayout(m_Device, m_SetLayout, m_Callbacks);
+
+	m_Pipeline = VK_NULL_HANDLE;
+	m_PipelineLayout = VK_NULL_HANDLE;
+	m_DescriptorPool = VK_NULL_HANDLE;
+	m_SetLayout = VK_NULL_HANDLE;
+	m_Device = VK_NULL_HANDLE;
+}
+
+void CullingPass::SetObjects(const DeviceBuffer& instances, uint32_t objectCount, uint32_t indexCount, float meshRadius)
+{
+	m_Constants.objectCount = objectCount;
+	m_Constants.maxDrawCount = std::min(objectCount, m_MaxDrawIndirectCount);
+	m_Constants.indexCount = indexCount;
+	m_Constants.meshRadius = meshRadius;
+
+	// Every object may be visible, the buffers are only replaced when they're too small
+	VkDeviceSize drawBytes = std::max<VkDeviceSize>(m_Constants.maxDrawCount, 1) * sizeof(VkDrawIndexedIndirectCommand);
+
+	for (auto& slot : m_Slots)
+	{
+		if (slot.drawBuffer.size < drawBytes)
+		{
+			DestroyBuffer(slot.drawBuffer);
+			slot.drawBuffer = CreateBuffer(drawBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+		}
+
+		if (slot.countBuffer.buffer == VK_NULL_HANDLE)
+			slot.countBuffer = CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+															  VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+		VkDescriptorBufferInfo bufferInfos[3]{};
+		bufferInfos[0] = { instances.buffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[1] = { slot.drawBuffer.buffer, 0, VK_WHOLE_SIZE };
+		bufferInfos[2] = { slot.countBuffer.buffer, 0, VK_WHOLE_SIZE };
+
+		VkWriteDescriptorSet writes[3]{};
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = slot.descriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+
+		vkUpdateDescriptorSets(m_Device, 3, writes, 0, nullptr);
+	}
+}
+
+void CullingPass::ClearCount(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	vkCmdFillBuffer(commandBuffer, m_Slots[slot].countBuffer.buffer, 0, sizeof(uint32_t), 0);
+}
+
+void CullingPass::Cull(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &m_Slots[slot].descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingConstants), &m_Constants);
+	vkCmdDispatch(commandBuffer, (m_Constants.objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+}
+
+void CullingPass::Draw(VkCommandBuffer commandBuffer, uint32_t slot)
+{
+	vkCmdDrawIndexedIndirectCount(commandBuffer, m_Slots[slot].drawBuffer.buffer, 0, m_Slots[slot].countBuffer.buffer, 0,
+								  m_Constants.maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+DeviceBuffer CullingPass::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	DeviceBuffer buffer;
+	buffer.size = size;
+
+	if (vkCreateBuffer(m_Device, &bufferInfo, m_Callbacks, &buffer.buffer) != VK_SUCCESS)
+		throw std::runtime_error("A culling buffer hasn't been created!");
+
+	try
+	{
+		buffer.allocation = m_Allocator->AllocateBuffer(buffer.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+	catch (...)
+	{
+		vkDestroyBuffer(m_Device, buffer.buffer, m_Callbacks);
+		throw;
+	}
+
+	return buffer;
+}
+
+void CullingPass::DestroyBuffer(DeviceBuffer& buffer) noexcept
+{
+	if (buffer.buffer == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyBuffer(m_Device, buffer.buffer, m_Callbacks);
+	m_Allocator->Free(buffer.allocation);
+	buffer = {};
+}
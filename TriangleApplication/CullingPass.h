@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+#include "StagingUploader.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// The push constants of cull.comp
+typedef struct CullingConstants_t {
+	float planes[4][4];     // In clip space, xy is the inward normal and z the distance
+	uint32_t objectCount;
+	uint32_t maxDrawCount;
+	uint32_t indexCount;
+	float meshRadius;
+} CullingConstants;
+
+// GPU-driven drawing: a compute shader tests the bounding circle of every instance against the frustum
+// and appends a VkDrawIndexedIndirectCommand for each visible one, the graphics pass then draws them
+// with a single vkCmdDrawIndexedIndirectCount. The recording cost doesn't depend on the object count.
+// Every slot of the frames-in-flight ring has its own draw and count buffers, so the culling of a frame
+// on the async compute queue never waits for the indirect reads of the previous frame on the graphics queue.
+// The render graphs place the barriers and the ownership transfers.
+class CullingPass
+{
+public:
+	static constexpr uint32_t WORKGROUP_SIZE = 64; // local_size_x of cull.comp
+	static constexpr uint32_t MAX_SLOTS = 4;
+
+	CullingPass() = default;
+	CullingPass(const CullingPass&) = delete;
+	CullingPass& operator=(const CullingPass&) = delete;
+
+	void Init(VkDevice device, DeviceAllocator& allocator, const uint32_t* code, size_t codeSize,
+			  VkPipelineCache pipelineCache, uint32_t maxDrawIndirectCount, const VkAllocationCallbacks* callbacks = nullptr);
+	void Destroy() noexcept;
+
+	// Sizes the draw buffers for the instances, which must have been created with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT.
+	// The device has to be idle
+	void SetObjects(const DeviceBuffer& instances, uint32_t objectCount, uint32_t indexCount, float meshRadius);
+
+	// Outside a render pass, the count has to be cleared before the draws of the visible objects are written.
+	// Both record no barrier, the render graph places them
+	void ClearCount(VkCommandBuffer commandBuffer, uint32_t slot);
+	void Cull(VkCommandBuffer commandBuffer, uint32_t slot);
+
+	// Inside the render pass, with the graphics pipeline, the vertex and the index buffers bound
+	void Draw(VkCommandBuffer commandBuffer, uint32_t slot);
+
+	inline VkBuffer GetDrawBuffer(uint32_t slot) const noexcept { return m_Slots[slot].drawBuffer.buffer; }
+	inline VkBuffer GetCountBuffer(uint32_t slot) const noexcept { return m_Slots[slot].countBuffer.buffer; }
+	inline bool IsInitialized() const noexcept { return m_Pipeline != VK_NULL_HANDLE; }
+private:
+	typedef struct CullingSlot_t {
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		DeviceBuffer drawBuffer;
+		DeviceBuffer countBuffer;
+	} CullingSlot;
+
+	DeviceBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+	void DestroyBuffer(DeviceBuffer& buffer) noexcept;
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	DeviceAllocator* m_Allocator = nullptr;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+
+	VkDescriptorSetLayout m_SetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_Pipeline = VK_NULL_HANDLE;
+
+	std::array<CullingSlot, MAX_SLOTS> m_Slots;
+	uint32_t m_MaxDrawIndirectCount = 0;
+	CullingConstants m_Constants{};
+};
@@ -0,0 +1,285 @@
+#include "DeviceAllocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+
+static const char* GetTilingName(ResourceTiling tiling) noexcept
+{
+	return tiling == ResourceTiling::Optimal ? "optimal" : "linear";
+}
+
+void DeviceAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks* callbacks, VkDeviceSize blockSize)
+{
+	m_Device = device;
+	m_Callbacks = callbacks;
+	m_BlockSize = blockSize;
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+	m_HeapStats.resize(m_MemoryProperties.memoryHeapCount);
+}
+
+void DeviceAllocator::Destroy() noexcept
+{
+	for (auto& block : m_Blocks)
+		vkFreeMemory(m_Device, block->memory, m_Callbacks);
+
+	m_Blocks.clear();
+}
+
+DeviceAllocation DeviceAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+										   ResourceTiling tiling, bool dedicated)
+{
+	uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, properties);
+	uint32_t heap = m_MemoryProperties.memoryTypes[memoryType].heapIndex;
+
+	// A small heap (e.g. the host visible device local one) isn't filled by a couple of blocks
+	VkDeviceSize blockSize = std::min(m_BlockSize, m_MemoryProperties.memoryHeaps[heap].size / 8);
+
+	// A resource that would take a large part of a block is better off on its own
+	if (dedicated || requirements.size > blockSize / 2)
+		return AllocateDedicated(requirements, memoryType, VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	HeapStats& stats = m_HeapStats[heap];
+
+	for (auto& block : m_Blocks)
+	{
+		if (block->memoryType != memoryType || block->tiling != tiling)
+			continue;
+
+		if (auto range = block->allocator.Allocate(requirements.size, requirements.alignment))
+		{
+			stats.allocationCount++;
+			stats.allocatedBytes += BuddyAllocator::GetBlockSize(range->order);
+			void* mapped = block->mapped != nullptr ? block->mapped + range->offset : nullptr;
+			return { block->memory, range->offset, requirements.size, memoryType, mapped, block.get(), range->order };
+		}
+	}
+
+	// Every block of the pool is full, reserving a new one
+	BuddyAllocator allocator(blockSize);
+
+	VkMemoryAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocateInfo.allocationSize = allocator.GetSize();
+	allocateInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_Device, &allocateInfo, m_Callbacks, &memory) != VK_SUCCESS)
+		throw std::runtime_error("A device memory block hasn't been allocated!");
+
+	std::byte* blockMapped = static_cast<std::byte*>(Map(memory, memoryType));
+
+	m_Blocks.push_back(std::make_unique<DeviceMemoryBlock>(DeviceMemoryBlock{ memory, memoryType, tiling, std::move(allocator), blockMapped }));
+	DeviceMemoryBlock* block = m_Blocks.back().get();
+
+	stats.blockCount++;
+	stats.blockBytes += block->allocator.GetSize();
+
+	auto range = block->allocator.Allocate(requirements.size, requirements.alignment);
+	if (!range)
+		throw std::runtime_error("The allocation doesn't fit into an empty block!");
+
+	stats.allocationCount++;
+	stats.allocatedBytes += BuddyAllocator::GetBlockSize(range->order);
+	void* mapped = blockMapped != nullptr ? blockMapped + range->offset : nullptr;
+	return { block->memory, range->offset, requirements.size, memoryType, mapped, block, range->order };
+}
+
+void DeviceAllocator::Free(const DeviceAllocation& allocation) noexcept
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	HeapStats& stats = m_HeapStats[m_MemoryProperties.memoryTypes[allocation.memoryType].heapIndex];
+
+	if (allocation.block == nullptr)
+	{
+		vkFreeMemory(m_Device, allocation.memory, m_Callbacks);
+		stats.dedicatedCount--;
+		stats.dedicatedBytes -= allocation.size;
+		return;
+	}
+
+	allocation.block->allocator.Free({ allocation.offset, allocation.order });
+	stats.allocationCount--;
+	stats.allocatedBytes -= BuddyAllocator::GetBlockSize(allocation.order);
+
+	if (!allocation.block->allocator.IsEmpty())
+		return;
+
+	// An empty block is kept as long as it's the only one of its pool, so a single resource being recreated doesn't thrash
+	auto isSamePool = [&](const std::unique_ptr<DeviceMemoryBlock>& block) {
+		return block->memoryType == allocation.block->memoryType && block->tiling == allocation.block->tiling;
+	};
+
+	if (std::count_if(m_Blocks.begin(), m_Blocks.end(), isSamePool) == 1)
+		return;
+
+	vkFreeMemory(m_Device, allocation.block->memory, m_Callbacks);
+	stats.blockCount--;
+	stats.blockBytes -= allocation.block->allocator.GetSize();
+
+	m_Blocks.erase(std::find_if(m_Blocks.begin(), m_Blocks.end(), [&](const std::unique_ptr<DeviceMemoryBlock>& block) {
+		return block.get() == allocation.block;
+	}));
+}
+
+DeviceAllocation DeviceAllocator::AllocateImage(VkImage image, VkMemoryPropertyFlags properties, ResourceTiling tiling)
+{
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicatedRequirements;
+
+	VkImageMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+	vkGetImageMemoryRequirements2(m_Device, &requirementsInfo, &requirements);
+
+	DeviceAllocation allocation;
+
+	if (dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation)
+	{
+		uint32_t memoryType = FindMemoryType(requirements.memoryRequirements.memoryTypeBits, properties);
+		allocation = AllocateDedicated(requirements.memoryRequirements, memoryType, image, VK_NULL_HANDLE);
+	}
+	else
+		allocation = Allocate(requirements.memoryRequirements, properties, tiling);
+
+	if (vkBindImageMemory(m_Device, image, allocation.memory, allocation.offset) != VK_SUCCESS)
+	{
+		Free(allocation);
+		throw std::runtime_error("Image memory hasn't been bound!");
+	}
+
+	return allocation;
+}
+
+DeviceAllocation DeviceAllocator::AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicatedRequirements;
+
+	VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.buffer = buffer;
+	vkGetBufferMemoryRequirements2(m_Device, &requirementsInfo, &requirements);
+
+	DeviceAllocation allocation;
+
+	if (dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation)
+	{
+		uint32_t memoryType = FindMemoryType(requirements.memoryRequirements.memoryTypeBits, properties);
+		allocation = AllocateDedicated(requirements.memoryRequirements, memoryType, VK_NULL_HANDLE, buffer);
+	}
+	else
+		allocation = Allocate(requirements.memoryRequirements, properties, ResourceTiling::Linear);
+
+	if (vkBindBufferMemory(m_Device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
+	{
+		Free(allocation);
+		throw std::runtime_error("Buffer memory hasn't been bound!");
+	}
+
+	return allocation;
+}
+
+uint32_t DeviceAllocator::FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+	{
+		if ((typeBits & (1u << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+
+	throw std::runtime_error("A suitable memory type hasn't been found!");
+}
+
+DeviceAllocator::HeapStats DeviceAllocator::GetHeapStats(uint32_t heap) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_HeapStats[heap];
+}
+
+void DeviceAllocator::Report(std::ostream& stream) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	stream << "[DEVICE MEMORY]:" << "\n\n";
+
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; i++)
+	{
+		const HeapStats& stats = m_HeapStats[i];
+		const VkMemoryHeap& heap = m_MemoryProperties.memoryHeaps[i];
+
+		stream << "Heap " << i << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? " (device local)" : "")
+			   << ": " << stats.blockCount << " blocks (" << stats.blockBytes / 1024 << " KiB), "
+			   << stats.allocationCount << " sub-allocations (" << stats.allocatedBytes / 1024 << " KiB), "
+			   << stats.dedicatedCount << " dedicated (" << stats.dedicatedBytes / 1024 << " KiB) of "
+			   << heap.size / (1024 * 1024) << " MiB\n";
+	}
+
+	for (auto& block : m_Blocks)
+	{
+		stream << "Block of type " << block->memoryType << " (" << GetTilingName(block->tiling) << "): "
+			   << block->allocator.GetUsedSize() / 1024 << " of " << block->allocator.GetSize() / 1024 << " KiB used\n";
+	}
+
+	stream << "\n";
+}
+
+DeviceAllocation DeviceAllocator::AllocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryType, VkImage image, VkBuffer buffer)
+{
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.image = image;
+	dedicatedInfo.buffer = buffer;
+
+	VkMemoryAllocateInfo allocateInfo{};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocateInfo.allocationSize = requirements.size;
+	allocateInfo.memoryTypeIndex = memoryType;
+
+	// Lets the driver place the resource optimally, e.g. for the render targets
+	if (image != VK_NULL_HANDLE || buffer != VK_NULL_HANDLE)
+		allocateInfo.pNext = &dedicatedInfo;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_Device, &allocateInfo, m_Callbacks, &memory) != VK_SUCCESS)
+		throw std::runtime_error("A dedicated allocation hasn't been made!");
+
+	void* mapped = Map(memory, memoryType);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	HeapStats& stats = m_HeapStats[m_MemoryProperties.memoryTypes[memoryType].heapIndex];
+	stats.dedicatedCount++;
+	stats.dedicatedBytes += requirements.size;
+
+	return { memory, 0, requirements.size, memoryType, mapped, nullptr, 0 };
+}
+
+void* DeviceAllocator::Map(VkDeviceMemory memory, uint32_t memoryType)
+{
+	if (!(m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		return nullptr;
+
+	void* mapped;
+	if (vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+	{
+		vkFreeMemory(m_Device, memory, m_Callbacks);
+		throw std::runtime_error("Host visible memory hasn't been mapped!");
+	}
+
+	return mapped;
+}
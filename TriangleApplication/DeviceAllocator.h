@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "BuddyAllocator.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// Linear resources (buffers, linear images) and optimal images are never placed in the same block,
+// so bufferImageGranularity never has to be considered between the neighbouring allocations
+enum class ResourceTiling {
+	Linear,
+	Optimal
+};
+
+// A single vkAllocateMemory allocation shared by many resources
+typedef struct DeviceMemoryBlock_t {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	uint32_t memoryType = 0;
+	ResourceTiling tiling = ResourceTiling::Linear;
+	BuddyAllocator allocator;
+	std::byte* mapped = nullptr; // The whole block stays mapped when it's host visible
+} DeviceMemoryBlock;
+
+typedef struct DeviceAllocation_t {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	uint32_t memoryType = 0;
+	void* mapped = nullptr; // Set for the host visible memory, a block can only be mapped once so it's never unmapped
+
+	// Where the allocation came from, needed to free it
+	DeviceMemoryBlock* block = nullptr; // nullptr for a dedicated allocation
+	uint32_t order = 0;
+} DeviceAllocation;
+
+// Reserves large blocks of device memory per memory type and sub-allocates them with a buddy allocator,
+// so the resources don't run into maxMemoryAllocationCount. Large resources get a dedicated allocation.
+class DeviceAllocator
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull << 20;
+
+	typedef struct HeapStats_t {
+		uint32_t blockCount = 0;
+		VkDeviceSize blockBytes = 0;     // Reserved by the blocks
+		uint32_t allocationCount = 0;
+		VkDeviceSize allocatedBytes = 0; // Handed out of the blocks, rounded up to the buddy sizes
+		uint32_t dedicatedCount = 0;
+		VkDeviceSize dedicatedBytes = 0;
+	} HeapStats;
+
+	DeviceAllocator() = default;
+	DeviceAllocator(const DeviceAllocator&) = delete;
+	DeviceAllocator& operator=(const DeviceAllocator&) = delete;
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, const VkAllocationCallbacks* callbacks = nullptr,
+			  VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+	void Destroy() noexcept;
+
+	DeviceAllocation Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+							  ResourceTiling tiling, bool dedicated = false);
+	void Free(const DeviceAllocation& allocation) noexcept;
+
+	// Allocates and binds the memory of the resource, the driver decides whether it prefers a dedicated allocation
+	DeviceAllocation AllocateImage(VkImage image, VkMemoryPropertyFlags properties, ResourceTiling tiling = ResourceTiling::Optimal);
+	DeviceAllocation AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+
+	uint32_t FindMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+
+	HeapStats GetHeapStats(uint32_t heap) const;
+	void Report(std::ostream& stream) const;
+private:
+	void* Map(VkDeviceMemory memory, uint32_t memoryType);
+	DeviceAllocation AllocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryType, VkImage image, VkBuffer buffer);
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties{};
+	VkDeviceSize m_BlockSize = DEFAULT_BLOCK_SIZE;
+
+	// The blocks of every memory type and tiling, in the order they were created
+	std::vector<std::unique_ptr<DeviceMemoryBlock>> m_Blocks;
+	std::vector<HeapStats> m_HeapStats;
+
+	mutable std::mutex m_Mutex; // The resources may be created by the startup workers
+};
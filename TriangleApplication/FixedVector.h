@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// A vector with inline storage for at most N elements, so it never touches the heap.
+// Meant for the Vulkan enumerations: the count is clamped to the capacity before the second query,
+// which then fills what fits and returns VK_INCOMPLETE for the rest.
+template<typename T, uint32_t N>
+class FixedVector
+{
+public:
+	static constexpr uint32_t CAPACITY = N;
+
+	// Returns the new size, which may be smaller than the requested one
+	uint32_t resize(uint32_t size) noexcept
+	{
+		m_Size = std::min(size, N);
+		return m_Size;
+	}
+
+	// Returns false when the vector is full
+	bool push_back(const T& value) noexcept
+	{
+		if (m_Size == N)
+			return false;
+
+		m_Elements[m_Size++] = value;
+		return true;
+	}
+
+	void clear() noexcept { m_Size = 0; }
+
+	inline T* data() noexcept { return m_Elements; }
+	inline const T* data() const noexcept { return m_Elements; }
+	inline uint32_t size() const noexcept { return m_Size; }
+	inline bool empty() const noexcept { return m_Size == 0; }
+
+	inline T& operator[](uint32_t index) noexcept { return m_Elements[index]; }
+	inline const T& operator[](uint32_t index) const noexcept { return m_Elements[index]; }
+
+	inline T* begin() noexcept { return m_Elements; }
+	inline T* end() noexcept { return m_Elements + m_Size; }
+	inline const T* begin() const noexcept { return m_Elements; }
+	inline const T* end() const noexcept { return m_Elements + m_Size; }
+	inline const T* cbegin() const noexcept { return m_Elements; }
+	inline const T* cend() const noexcept { return m_Elements + m_Size; }
+private:
+	T m_Elements[N]{};
+	uint32_t m_Size = 0;
+};
@@ -0,0 +1,106 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+
+// Weight of the newest sample in the moving averages
+static constexpr double SMOOTHING = 0.1;
+
+static double ToMilliseconds(FramePacer::Clock::duration duration) noexcept
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void FramePacer::OnSubmit(uint64_t frame, Clock::time_point inputTime, Clock::time_point submitTime) noexcept
+{
+	// The oldest frame is dropped from its statistics if nobody has observed its present
+	if (m_PendingCount == MAX_PENDING_FRAMES)
+	{
+		m_PendingFirst = (m_PendingFirst + 1) % MAX_PENDING_FRAMES;
+		m_PendingCount--;
+	}
+
+	PendingFrame& pending = m_Pending[(m_PendingFirst + m_PendingCount) % MAX_PENDING_FRAMES];
+	pending.frame = frame;
+	pending.inputTime = inputTime;
+	pending.submitTime = submitTime;
+	m_PendingCount++;
+
+	double cpuFrameTime = ToMilliseconds(submitTime - inputTime);
+	m_CpuFrameTime = m_HasEstimate ? m_CpuFrameTime + (cpuFrameTime - m_CpuFrameTime) * SMOOTHING : cpuFrameTime;
+}
+
+void FramePacer::OnPresented(uint64_t frame, Clock::time_point presentTime) noexcept
+{
+	// The frames are presented in order, so the older pending frames are done as well
+	while (m_PendingCount > 0 && m_Pending[m_PendingFirst].frame <= frame)
+	{
+		const PendingFrame& pending = m_Pending[m_PendingFirst];
+
+		// The GPU starts a frame when it's submitted or when the previous one is finished
+		Clock::time_point gpuStart = std::max(pending.submitTime, m_LastPresent);
+		double gpuFrameTime = ToMilliseconds(presentTime - gpuStart);
+
+		if (!m_HasEstimate)
+		{
+			m_GpuFrameTime = gpuFrameTime;
+			m_HasEstimate = true;
+		}
+		else
+			m_GpuFrameTime += (gpuFrameTime - m_GpuFrameTime) * SMOOTHING;
+
+		double latency = ToMilliseconds(presentTime - pending.inputTime);
+		m_Latency.min = m_Latency.count ? std::min(m_Latency.min, latency) : latency;
+		m_Latency.max = std::max(m_Latency.max, latency);
+		m_Latency.sum += latency;
+		m_Latency.count++;
+
+		m_PendingFirst = (m_PendingFirst + 1) % MAX_PENDING_FRAMES;
+		m_PendingCount--;
+	}
+
+	m_LastPresent = presentTime;
+}
+
+void FramePacer::DiscardPending() noexcept
+{
+	m_PendingFirst = 0;
+	m_PendingCount = 0;
+}
+
+uint64_t FramePacer::GetOldestPendingFrame() const noexcept
+{
+	return m_PendingCount ? m_Pending[m_PendingFirst].frame : 0;
+}
+
+uint64_t FramePacer::GetNewestPendingFrame() const noexcept
+{
+	return m_PendingCount ? m_Pending[(m_PendingFirst + m_PendingCount - 1) % MAX_PENDING_FRAMES].frame : 0;
+}
+
+FramePacer::Clock::time_point FramePacer::GetSampleDeadline() const noexcept
+{
+	if (!m_HasEstimate || m_PendingCount == 0)
+		return Clock::now();
+
+	const PendingFrame& newest = m_Pending[(m_PendingFirst + m_PendingCount - 1) % MAX_PENDING_FRAMES];
+
+	Clock::time_point gpuStart = std::max(newest.submitTime, m_LastPresent);
+	double untilSample = m_GpuFrameTime - m_CpuFrameTime - m_SafetyMargin;
+
+	return gpuStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(untilSample));
+}
+
+void FramePacer::ResetStats() noexcept
+{
+	m_Latency = LatencyStats();
+}
+
+void FramePacer::Report(const char* mode, std::ostream& stream) const
+{
+	stream << "[LATENCY] " << mode << ": input-to-present "
+		   << m_Latency.GetMean() << " ms mean, "
+		   << m_Latency.min << " ms min, "
+		   << m_Latency.max << " ms max over "
+		   << m_Latency.count << " frames (predicted GPU frame time "
+		   << m_GpuFrameTime << " ms)\n";
+}
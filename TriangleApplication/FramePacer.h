@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+enum class FramePacing {
+	Throughput, // Input is sampled as early as possible, frames queue up behind the swapchain images
+	LowLatency  // Input sampling and recording are delayed until just before the GPU is ready
+};
+
+// Predicts the GPU frame time and measures the input-to-present latency.
+// The Vulkan side (waiting for the presents or the frames) is done by the application,
+// the pacer only keeps the timings of the frames that haven't been presented yet.
+class FramePacer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr uint32_t MAX_PENDING_FRAMES = 16;
+
+	typedef struct LatencyStats_t {
+		uint64_t count = 0;
+		double sum = 0.0, min = 0.0, max = 0.0; // Milliseconds
+
+		inline double GetMean() const noexcept { return count ? sum / count : 0.0; }
+	} LatencyStats;
+
+	void OnSubmit(uint64_t frame, Clock::time_point inputTime, Clock::time_point submitTime) noexcept;
+	void OnPresented(uint64_t frame, Clock::time_point presentTime) noexcept;
+
+	// Forgets the frames that will never be reported as presented (e.g. presented to a retired swapchain)
+	void DiscardPending() noexcept;
+
+	// Returns 0 if every submitted frame has been presented
+	uint64_t GetOldestPendingFrame() const noexcept;
+	uint64_t GetNewestPendingFrame() const noexcept;
+
+	// The moment when the input for the next frame should be sampled, so that its commands
+	// are submitted right when the GPU finishes the last submitted frame
+	Clock::time_point GetSampleDeadline() const noexcept;
+
+	inline double GetPredictedGpuFrameTime() const noexcept { return m_GpuFrameTime; }
+	inline const LatencyStats& GetLatency() const noexcept { return m_Latency; }
+
+	void ResetStats() noexcept;
+	void Report(const char* mode, std::ostream& stream) const;
+private:
+	typedef struct PendingFrame_t {
+		uint64_t frame = 0;
+		Clock::time_point inputTime;
+		Clock::time_point submitTime;
+	} PendingFrame;
+
+	std::array<PendingFrame, MAX_PENDING_FRAMES> m_Pending;
+	uint32_t m_PendingFirst = 0,
+			 m_PendingCount = 0;
+
+	Clock::time_point m_LastPresent;
+
+	// Exponential moving averages in milliseconds
+	double m_GpuFrameTime = 0.0;
+	double m_CpuFrameTime = 0.0;
+	bool m_HasEstimate = false;
+
+	double m_SafetyMargin = 0.5;
+
+	LatencyStats m_Latency;
+};
@@ -0,0 +1,103 @@
+#include "FrameScheduler.h"
+
+#include <stdexcept>
+
+void FrameScheduler::Init(VkDevice device, const VkAllocationCallbacks* callbacks)
+{
+	m_Device = device;
+	m_Callbacks = callbacks;
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = m_SubmittedFrame; // Frame 0 is always complete
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+
+	if (vkCreateSemaphore(m_Device, &semaphoreInfo, m_Callbacks, &m_Timeline) != VK_SUCCESS)
+		throw std::runtime_error("Timeline semaphore hasn't been created!");
+}
+
+void FrameScheduler::Destroy() noexcept
+{
+	if (m_Timeline != VK_NULL_HANDLE)
+		vkDestroySemaphore(m_Device, m_Timeline, m_Callbacks);
+
+	m_Timeline = VK_NULL_HANDLE;
+}
+
+uint64_t FrameScheduler::Submit(VkQueue queue, const VkSubmitInfo& submitInfo)
+{
+	if (submitInfo.signalSemaphoreCount >= MAX_SIGNAL_SEMAPHORES)
+		throw std::runtime_error("Too many signal semaphores!");
+
+	uint64_t frame = GetNextFrame();
+
+	VkSemaphore signalSemaphores[MAX_SIGNAL_SEMAPHORES];
+	uint64_t signalValues[MAX_SIGNAL_SEMAPHORES] = {}; // The values of binary semaphores are ignored
+
+	for (uint32_t i = 0; i < submitInfo.signalSemaphoreCount; i++)
+		signalSemaphores[i] = submitInfo.pSignalSemaphores[i];
+
+	signalSemaphores[submitInfo.signalSemaphoreCount] = m_Timeline;
+	signalValues[submitInfo.signalSemaphoreCount] = frame;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.pNext = submitInfo.pNext;
+	timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount + 1;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+
+	VkSubmitInfo timelineSubmit = submitInfo;
+	timelineSubmit.pNext = &timelineInfo;
+	timelineSubmit.signalSemaphoreCount = submitInfo.signalSemaphoreCount + 1;
+	timelineSubmit.pSignalSemaphores = signalSemaphores;
+
+	if (vkQueueSubmit(queue, 1, &timelineSubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+		throw std::runtime_error("Can't submit commands to the queue!");
+
+	m_SubmittedFrame = frame;
+
+	return frame;
+}
+
+void FrameScheduler::WaitForFrame(uint64_t frame) const
+{
+	if (IsFrameComplete(frame))
+		return;
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &m_Timeline;
+	waitInfo.pValues = &frame;
+
+	if (vkWaitSemaphores(m_Device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+		throw std::runtime_error("Can't wait for the frame!");
+
+	uint64_t completed = m_CompletedFrame.load(std::memory_order_relaxed);
+	while (completed < frame && !m_CompletedFrame.compare_exchange_weak(completed, frame, std::memory_order_relaxed));
+}
+
+bool FrameScheduler::IsFrameComplete(uint64_t frame) const
+{
+	if (frame <= m_CompletedFrame.load(std::memory_order_relaxed))
+		return true;
+
+	return frame <= GetCompletedFrame();
+}
+
+uint64_t FrameScheduler::GetCompletedFrame() const
+{
+	uint64_t value = 0;
+	if (vkGetSemaphoreCounterValue(m_Device, m_Timeline, &value) != VK_SUCCESS)
+		throw std::runtime_error("Can't query the timeline semaphore!");
+
+	// The counter only grows, so the cache is only moved forward
+	uint64_t completed = m_CompletedFrame.load(std::memory_order_relaxed);
+	while (completed < value && !m_CompletedFrame.compare_exchange_weak(completed, value, std::memory_order_relaxed));
+
+	return value;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+
+// Tracks the GPU progress with a single Vulkan 1.2 timeline semaphore.
+// Every submitted frame signals the semaphore with its own monotonically increasing number,
+// so any subsystem can wait for or poll a frame without owning a fence.
+class FrameScheduler
+{
+public:
+	static constexpr uint32_t MAX_SIGNAL_SEMAPHORES = 4;
+
+	FrameScheduler() = default;
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+	void Init(VkDevice device, const VkAllocationCallbacks* callbacks = nullptr);
+	void Destroy() noexcept;
+
+	// Submits the work of the next frame and signals the timeline with its number.
+	// The binary semaphores of submitInfo are kept, the timeline semaphore is appended to them
+	uint64_t Submit(VkQueue queue, const VkSubmitInfo& submitInfo);
+
+	void WaitForFrame(uint64_t frame) const;
+	bool IsFrameComplete(uint64_t frame) const;
+
+	inline uint64_t GetNextFrame() const noexcept { return m_SubmittedFrame + 1; }
+	inline uint64_t GetSubmittedFrame() const noexcept { return m_SubmittedFrame; }
+	uint64_t GetCompletedFrame() const;
+
+	// Used by other queues to wait for a frame (cross-queue dependencies)
+	inline VkSemaphore GetSemaphore() const noexcept { return m_Timeline; }
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+	VkSemaphore m_Timeline = VK_NULL_HANDLE;
+
+	uint64_t m_SubmittedFrame = 0;
+	mutable std::atomic<uint64_t> m_CompletedFrame{ 0 }; // Cached value, saves a driver call for the frames that are known to be finished
+};
@@ -0,0 +1,100 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+typedef struct TimingField_t {
+	const char* name;
+	double FrameTimings::* timing;
+} TimingField;
+
+static constexpr TimingField TIMING_FIELDS[] = {
+	{ "cpu", &FrameTimings::cpu },
+	{ "gpu", &FrameTimings::gpu },
+	{ "compute", &FrameTimings::compute },
+	{ "overlap", &FrameTimings::overlap },
+	{ "acquire", &FrameTimings::acquire },
+	{ "record", &FrameTimings::record },
+	{ "submit", &FrameTimings::submit },
+	{ "present", &FrameTimings::present }
+};
+
+// Nearest-rank percentile of sorted values
+static double GetPercentile(const std::vector<double>& sorted, double percentile) noexcept
+{
+	size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+	return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void FrameStats::Reserve(size_t frames)
+{
+	m_Samples.reserve(frames);
+}
+
+void FrameStats::Add(const FrameTimings& timings)
+{
+	m_Samples.push_back(timings);
+}
+
+void FrameStats::Clear() noexcept
+{
+	m_Samples.clear();
+}
+
+FrameStats::Summary FrameStats::Summarize(double FrameTimings::* timing) const
+{
+	std::vector<double> values;
+	values.reserve(m_Samples.size());
+
+	for (auto& sample : m_Samples)
+	{
+		if (sample.*timing >= 0.0)
+			values.push_back(sample.*timing);
+	}
+
+	return Summarize(std::move(values));
+}
+
+FrameStats::Summary FrameStats::Summarize(std::vector<double> values)
+{
+	Summary summary{};
+	if (values.empty())
+		return summary;
+
+	std::sort(values.begin(), values.end());
+
+	double sum = 0.0;
+	for (double value : values)
+		sum += value;
+
+	summary.count = values.size();
+	summary.mean = sum / values.size();
+	summary.p50 = GetPercentile(values, 50.0);
+	summary.p95 = GetPercentile(values, 95.0);
+	summary.p99 = GetPercentile(values, 99.0);
+	summary.max = values.back();
+	return summary;
+}
+
+void FrameStats::WriteJson(std::ostream& stream, const char* indent) const
+{
+	stream << "{\n";
+
+	for (size_t i = 0; i < std::size(TIMING_FIELDS); i++)
+	{
+		Summary summary = Summarize(TIMING_FIELDS[i].timing);
+
+		stream << indent << "\t\"" << TIMING_FIELDS[i].name << "_ms\": { "
+			   << "\"count\": " << summary.count << ", "
+			   << "\"mean\": " << summary.mean << ", "
+			   << "\"p50\": " << summary.p50 << ", "
+			   << "\"p95\": " << summary.p95 << ", "
+			   << "\"p99\": " << summary.p99 << ", "
+			   << "\"max\": " << summary.max << " }"
+			   << (i + 1 < std::size(TIMING_FIELDS) ? ",\n" : "\n");
+	}
+
+	stream << indent << "}";
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// The timings of a single frame in milliseconds, a negative value means the timing isn't available
+typedef struct FrameTimings_t {
+	double cpu = -1.0;     // From the start of the frame until the start of the next one
+	double gpu = -1.0;     // Between the first and the last command on the GPU, of the previous frame of the same slot
+	double compute = -1.0; // The same on the async compute queue
+	double overlap = -1.0; // The part of the compute time running alongside the graphics work
+	double acquire = -1.0;
+	double record = -1.0;
+	double submit = -1.0;
+	double present = -1.0;
+} FrameTimings;
+
+// Collects the frame timings of a benchmark run and reduces them to percentiles
+class FrameStats
+{
+public:
+	typedef struct Summary_t {
+		uint64_t count = 0;
+		double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+	} Summary;
+
+	// Allocating the samples up front, so the measured frames don't allocate
+	void Reserve(size_t frames);
+	void Add(const FrameTimings& timings);
+	void Clear() noexcept;
+
+	inline size_t GetCount() const noexcept { return m_Samples.size(); }
+
+	Summary Summarize(double FrameTimings::* timing) const;
+
+	// The same reduction of any other samples, like the latencies of the streamed uploads
+	static Summary Summarize(std::vector<double> values);
+
+	// Writes a JSON object with a summary for every timing
+	void WriteJson(std::ostream& stream, const char* indent = "") const;
+private:
+	std::vector<FrameTimings> m_Samples;
+};
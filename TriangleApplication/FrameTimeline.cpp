@@ -0,0 +1,142 @@
+#include "FrameTimeline.h"
+
+#include <iomanip>
+#include <stdexcept>
+
+static constexpr uint32_t CPU_TRACK = 1;
+static constexpr uint32_t GPU_TRACK = 2;
+
+static double ToMilliseconds(FrameTimeline::Clock::duration duration) noexcept
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static const char* GetBoundName(FrameBound bound) noexcept
+{
+	switch (bound)
+	{
+	case FrameBound::Cpu: return "CPU";
+	case FrameBound::Gpu: return "GPU";
+	default:              return "unknown";
+	}
+}
+
+FrameTimeline::~FrameTimeline()
+{
+	if (m_Trace.is_open())
+		m_Trace << "\n]}\n";
+}
+
+void FrameTimeline::OpenTrace(const std::filesystem::path& path)
+{
+	m_Trace.open(path);
+
+	if (!m_Trace)
+		throw std::runtime_error("Can't open the timeline trace file!");
+
+	m_Trace << std::fixed << std::setprecision(3);
+	m_Trace << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+			<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << CPU_TRACK << ",\"args\":{\"name\":\"CPU\"}},\n"
+			<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_TRACK << ",\"args\":{\"name\":\"GPU\"}}";
+
+	m_TraceStart = Clock::now();
+}
+
+void FrameTimeline::OnCpuFrame(uint64_t frame, const CpuFrameSpans& spans) noexcept
+{
+	FrameRecord& record = m_Frames[frame % MAX_FRAMES];
+	record.frame = frame;
+	record.cpu = spans;
+	record.gpuKnown = false;
+}
+
+void FrameTimeline::OnGpuFrame(uint64_t frame, Clock::time_point begin, Clock::time_point end)
+{
+	FrameRecord* record = Find(frame);
+	if (record == nullptr)
+		return;
+
+	record->gpuBegin = begin;
+	record->gpuEnd = end;
+	record->gpuKnown = true;
+
+	// The GPU was starved if it had finished the previous frame before this one was even submitted
+	FrameBound bound = FrameBound::Unknown;
+	const FrameRecord* previous = Find(frame - 1);
+
+	if (previous != nullptr && previous->gpuKnown)
+		bound = record->cpu.submitEnd > previous->gpuEnd ? FrameBound::Cpu : FrameBound::Gpu;
+
+	Classify(*record, bound, ToMilliseconds(end - begin));
+}
+
+void FrameTimeline::OnGpuFrameTime(uint64_t frame, double milliseconds)
+{
+	FrameRecord* record = Find(frame);
+	if (record == nullptr)
+		return;
+
+	double cpuMilliseconds = ToMilliseconds(record->cpu.submitEnd - record->cpu.recordBegin);
+	Classify(*record, milliseconds > cpuMilliseconds ? FrameBound::Gpu : FrameBound::Cpu, milliseconds);
+}
+
+void FrameTimeline::ResetStats() noexcept
+{
+	m_CpuBoundFrames = 0;
+	m_GpuBoundFrames = 0;
+}
+
+void FrameTimeline::Report(std::ostream& stream) const
+{
+	uint64_t frames = m_CpuBoundFrames + m_GpuBoundFrames;
+	if (frames == 0)
+		return;
+
+	stream << "[TIMELINE]: " << m_CpuBoundFrames << " CPU-bound, " << m_GpuBoundFrames << " GPU-bound frames ("
+		   << 100.0 * m_GpuBoundFrames / frames << "% GPU-bound)\n";
+}
+
+FrameTimeline::FrameRecord* FrameTimeline::Find(uint64_t frame) noexcept
+{
+	FrameRecord& record = m_Frames[frame % MAX_FRAMES];
+	return frame != 0 && record.frame == frame ? &record : nullptr;
+}
+
+void FrameTimeline::Classify(const FrameRecord& record, FrameBound bound, double gpuMilliseconds)
+{
+	if (bound == FrameBound::Cpu)
+		m_CpuBoundFrames++;
+	else if (bound == FrameBound::Gpu)
+		m_GpuBoundFrames++;
+
+	m_LastBound = bound;
+
+	if (!m_Trace.is_open())
+		return;
+
+	const char* boundName = GetBoundName(bound);
+
+	WriteSpan("Wait", CPU_TRACK, record.frame, record.cpu.begin, record.cpu.recordBegin, boundName);
+	WriteSpan("Record", CPU_TRACK, record.frame, record.cpu.recordBegin, record.cpu.recordEnd, boundName);
+	WriteSpan("Submit", CPU_TRACK, record.frame, record.cpu.submitBegin, record.cpu.submitEnd, boundName);
+
+	if (record.cpu.presentEnd > record.cpu.submitEnd)
+		WriteSpan("Present", CPU_TRACK, record.frame, record.cpu.submitEnd, record.cpu.presentEnd, boundName);
+
+	// Without calibration the GPU span can't be placed on the host clock, only its duration is known
+	if (record.gpuKnown)
+		WriteSpan("Execute", GPU_TRACK, record.frame, record.gpuBegin, record.gpuEnd, boundName);
+	else
+		m_Trace << ",\n{\"name\":\"GPU " << gpuMilliseconds << " ms\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << GPU_TRACK
+				<< ",\"ts\":" << ToMilliseconds(record.cpu.submitEnd - m_TraceStart) * 1000.0
+				<< ",\"args\":{\"frame\":" << record.frame << ",\"bound\":\"" << boundName << "\"}}";
+}
+
+void FrameTimeline::WriteSpan(const char* name, uint32_t track, uint64_t frame, Clock::time_point begin, Clock::time_point end, const char* bound)
+{
+	// The Chrome trace format uses microseconds
+	m_Trace << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track
+			<< ",\"ts\":" << ToMilliseconds(begin - m_TraceStart) * 1000.0
+			<< ",\"dur\":" << ToMilliseconds(end - begin) * 1000.0
+			<< ",\"args\":{\"frame\":" << frame << ",\"bound\":\"" << bound << "\"}}";
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+
+enum class FrameBound {
+	Unknown,
+	Cpu, // The GPU finished the previous frame before this one was submitted, so it waited for the CPU
+	Gpu  // The frame was already queued when the GPU finished the previous one
+};
+
+// The CPU side of a frame on the host steady clock
+typedef struct CpuFrameSpans_t {
+	std::chrono::steady_clock::time_point begin; // The start of the frame, before waiting for its slot and the image
+	std::chrono::steady_clock::time_point recordBegin, recordEnd;
+	std::chrono::steady_clock::time_point submitBegin, submitEnd;
+	std::chrono::steady_clock::time_point presentEnd; // Equals submitEnd when nothing is presented
+} CpuFrameSpans;
+
+// Puts the CPU spans of every frame next to its GPU execution and labels the frame CPU-bound or GPU-bound.
+// The GPU span arrives a few frames after the CPU one, when the profiler reads the timestamps back.
+class FrameTimeline
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr uint32_t MAX_FRAMES = 32; // Has to cover the frames in flight
+
+	~FrameTimeline();
+
+	// Writes the combined timeline as a Chrome trace with a CPU and a GPU track
+	void OpenTrace(const std::filesystem::path& path);
+
+	void OnCpuFrame(uint64_t frame, const CpuFrameSpans& spans) noexcept;
+
+	// The GPU span on the host clock, needs calibrated timestamps
+	void OnGpuFrame(uint64_t frame, Clock::time_point begin, Clock::time_point end);
+
+	// Without calibration only the durations can be compared: the frame is GPU-bound if the GPU took longer than the CPU
+	void OnGpuFrameTime(uint64_t frame, double milliseconds);
+
+	inline FrameBound GetLastBound() const noexcept { return m_LastBound; }
+
+	void ResetStats() noexcept;
+	void Report(std::ostream& stream) const;
+private:
+	typedef struct FrameRecord_t {
+		uint64_t frame = 0;
+		CpuFrameSpans cpu;
+		Clock::time_point gpuBegin, gpuEnd;
+		bool gpuKnown = false;
+	} FrameRecord;
+
+	FrameRecord* Find(uint64_t frame) noexcept;
+	void Classify(const FrameRecord& record, FrameBound bound, double gpuMilliseconds);
+	void WriteSpan(const char* name, uint32_t track, uint64_t frame, Clock::time_point begin, Clock::time_point end, const char* bound);
+
+	std::array<FrameRecord, MAX_FRAMES> m_Frames;
+	FrameBound m_LastBound = FrameBound::Unknown;
+
+	uint64_t m_CpuBoundFrames = 0,
+			 m_GpuBoundFrames = 0;
+
+	std::ofstream m_Trace;
+	Clock::time_point m_TraceStart;
+};
@@ -0,0 +1,311 @@
+#include "GpuProfiler.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// Weight of the newest sample in the moving averages
+static constexpr double SMOOTHING = 0.1;
+
+static constexpr uint32_t QUERIES_PER_SLOT = GpuProfiler::MAX_SCOPES * 2;
+
+static constexpr auto CALIBRATION_INTERVAL = std::chrono::seconds(1);
+
+// The steady clock is built on the same host clock as the calibrated time domain
+#ifdef _WIN32
+static constexpr VkTimeDomainEXT HOST_TIME_DOMAIN = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+
+static GpuProfiler::Clock::time_point GetHostTime(uint64_t counter) noexcept
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+
+	// Split like the steady clock does, so the multiplication doesn't overflow
+	uint64_t seconds = counter / frequency.QuadPart;
+	uint64_t remainder = counter % frequency.QuadPart;
+	return GpuProfiler::Clock::time_point(std::chrono::nanoseconds(seconds * 1'000'000'000 + remainder * 1'000'000'000 / frequency.QuadPart));
+}
+#else
+static constexpr VkTimeDomainEXT HOST_TIME_DOMAIN = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+static GpuProfiler::Clock::time_point GetHostTime(uint64_t nanoseconds) noexcept
+{
+	return GpuProfiler::Clock::time_point(std::chrono::nanoseconds(nanoseconds));
+}
+#endif
+
+void GpuProfiler::Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, const VkAllocationCallbacks* callbacks)
+{
+	m_Device = device;
+	m_Callbacks = callbacks;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	uint32_t count;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> familyProps(count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, familyProps.data());
+
+	// The queue may not support the timestamps at all, the profiler does nothing then
+	uint32_t validBits = familyProps[queueFamilyIndex].timestampValidBits;
+	if (validBits == 0)
+		return;
+
+	m_TimestampPeriod = properties.limits.timestampPeriod;
+	m_TimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = QUERIES_PER_SLOT;
+
+	for (auto& slot : m_Slots)
+	{
+		if (vkCreateQueryPool(m_Device, &queryPoolInfo, m_Callbacks, &slot.pool) != VK_SUCCESS)
+			throw std::runtime_error("A timestamp query pool hasn't been created!");
+	}
+
+	m_Supported = true;
+}
+
+void GpuProfiler::Destroy() noexcept
+{
+	for (auto& slot : m_Slots)
+	{
+		vkDestroyQueryPool(m_Device, slot.pool, m_Callbacks);
+		slot.pool = VK_NULL_HANDLE;
+	}
+
+	m_Supported = false;
+}
+
+void GpuProfiler::InitCalibration(VkInstance instance, VkPhysicalDevice physicalDevice)
+{
+	if (!m_Supported)
+		return;
+
+	auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+		vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+	auto getCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+		vkGetDeviceProcAddr(m_Device, "vkGetCalibratedTimestampsEXT"));
+
+	if (getTimeDomains == nullptr || getCalibratedTimestamps == nullptr)
+		return;
+
+	uint32_t count;
+	getTimeDomains(physicalDevice, &count, nullptr);
+
+	std::vector<VkTimeDomainEXT> timeDomains(count);
+	getTimeDomains(physicalDevice, &count, timeDomains.data());
+
+	bool deviceDomain = false, hostDomain = false;
+	for (auto timeDomain : timeDomains)
+	{
+		deviceDomain |= timeDomain == VK_TIME_DOMAIN_DEVICE_EXT;
+		hostDomain |= timeDomain == HOST_TIME_DOMAIN;
+	}
+
+	if (!deviceDomain || !hostDomain)
+		return;
+
+	m_GetCalibratedTimestamps = getCalibratedTimestamps;
+	m_HostDomain = HOST_TIME_DOMAIN;
+
+	// Calibrated only once a first pair is read, the host times would start at the epoch otherwise
+	if (!Calibrate())
+		m_GetCalibratedTimestamps = nullptr;
+}
+
+void GpuProfiler::OpenTrace(const std::filesystem::path& path)
+{
+	m_Trace.open(path);
+
+	if (!m_Trace)
+		throw std::runtime_error("Can't open the GPU trace file!");
+
+	m_Trace << "frame,scope,depth,begin_ms,duration_ms\n";
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t frameNumber)
+{
+	if (!m_Supported)
+		return;
+
+	m_Recording = &m_Slots[slot];
+	m_Recording->scopeCount = 0;
+	m_Recording->frameNumber = frameNumber;
+	m_Recording->pending = false;
+	m_Depth = 0;
+
+	// The queries can't be reset inside a render pass, so the whole pool is reset up front
+	vkCmdResetQueryPool(commandBuffer, m_Recording->pool, 0, QUERIES_PER_SLOT);
+
+	BeginScope(commandBuffer, "Frame");
+}
+
+void GpuProfiler::EndFrame(VkCommandBuffer commandBuffer)
+{
+	if (m_Recording == nullptr)
+		return;
+
+	EndScope(commandBuffer, 0);
+
+	m_Recording->pending = true;
+	m_Recording = nullptr;
+}
+
+void GpuProfiler::ReplayFrame(uint32_t slot, uint64_t frameNumber) noexcept
+{
+	Slot& replayed = m_Slots[slot];
+
+	if (!m_Supported || replayed.scopeCount == 0)
+		return;
+
+	replayed.frameNumber = frameNumber;
+	replayed.pending = true;
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, const char* name)
+{
+	if (m_Recording == nullptr || m_Recording->scopeCount == MAX_SCOPES)
+		return UINT32_MAX;
+
+	uint32_t index = m_Recording->scopeCount++;
+
+	Scope& scope = m_Recording->scopes[index];
+	scope.name = name;
+	scope.depth = m_Depth++;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_Recording->pool, index * 2);
+	return index;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+	if (m_Recording == nullptr || scope == UINT32_MAX)
+		return;
+
+	// The end is written once all the previous commands are finished
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_Recording->pool, scope * 2 + 1);
+	m_Depth--;
+}
+
+bool GpuProfiler::Collect(uint32_t slot)
+{
+	Slot& collected = m_Slots[slot];
+
+	if (!collected.pending)
+		return false;
+
+	if (IsCalibrated() && Clock::now() - m_CalibrationTime > CALIBRATION_INTERVAL)
+		Calibrate();
+
+	collected.pending = false;
+
+	uint64_t timestamps[QUERIES_PER_SLOT];
+	uint32_t queryCount = collected.scopeCount * 2;
+
+	// No VK_QUERY_RESULT_WAIT_BIT, a frame that isn't finished yet is skipped rather than waited for
+	if (vkGetQueryPoolResults(m_Device, collected.pool, 0, queryCount, queryCount * sizeof(uint64_t), timestamps,
+							  sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return false;
+
+	auto toMilliseconds = [this](uint64_t begin, uint64_t end) {
+		uint64_t ticks = ((end & m_TimestampMask) - (begin & m_TimestampMask)) & m_TimestampMask;
+		return ticks * m_TimestampPeriod / 1'000'000.0;
+	};
+
+	uint64_t frameBegin = timestamps[0];
+
+	for (uint32_t i = 0; i < collected.scopeCount; i++)
+	{
+		const Scope& scope = collected.scopes[i];
+		double duration = toMilliseconds(timestamps[i * 2], timestamps[i * 2 + 1]);
+
+		ScopeStats& stats = GetStats(scope.name);
+		stats.average = stats.count ? stats.average + (duration - stats.average) * SMOOTHING : duration;
+		stats.count++;
+
+		if (m_Trace.is_open())
+		{
+			m_Trace << collected.frameNumber << ',' << scope.name << ',' << scope.depth << ','
+					<< toMilliseconds(frameBegin, timestamps[i * 2]) << ',' << duration << '\n';
+		}
+	}
+
+	m_CollectedFrame = collected.frameNumber;
+	m_FrameTime = toMilliseconds(timestamps[0], timestamps[1]);
+	m_FrameBeginTicks = timestamps[0] & m_TimestampMask;
+	m_FrameEndTicks = timestamps[1] & m_TimestampMask;
+
+	if (IsCalibrated())
+	{
+		m_FrameBegin = ToHostTime(timestamps[0]);
+		m_FrameEnd = ToHostTime(timestamps[1]);
+	}
+
+	return true;
+}
+
+bool GpuProfiler::Calibrate()
+{
+	VkCalibratedTimestampInfoEXT infos[2]{};
+	infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	infos[1].timeDomain = m_HostDomain;
+
+	uint64_t timestamps[2];
+	uint64_t maxDeviation;
+
+	if (m_GetCalibratedTimestamps(m_Device, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS)
+		return false;
+
+	m_CalibrationTicks = timestamps[0] & m_TimestampMask;
+	m_CalibrationTime = GetHostTime(timestamps[1]);
+	return true;
+}
+
+GpuProfiler::Clock::time_point GpuProfiler::ToHostTime(uint64_t ticks) const noexcept
+{
+	// The frame may have run before or after the calibration, the difference wraps at the valid bits
+	uint64_t difference = ((ticks & m_TimestampMask) - m_CalibrationTicks) & m_TimestampMask;
+	double elapsed = difference > m_TimestampMask / 2 ? -static_cast<double>(m_TimestampMask - difference + 1) : static_cast<double>(difference);
+
+	return m_CalibrationTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::nano>(elapsed * m_TimestampPeriod));
+}
+
+void GpuProfiler::Report(std::ostream& stream, const char* title) const
+{
+	stream << "[" << title << "]:";
+
+	for (uint32_t i = 0; i < m_StatsCount; i++)
+		stream << (i ? ", " : " ") << m_Stats[i].name << " " << m_Stats[i].average << " ms";
+
+	stream << "\n";
+}
+
+GpuProfiler::ScopeStats& GpuProfiler::GetStats(const char* name) noexcept
+{
+	for (uint32_t i = 0; i < m_StatsCount; i++)
+	{
+		if (std::strcmp(m_Stats[i].name, name) == 0)
+			return m_Stats[i];
+	}
+
+	// The scopes beyond the limit share the last entry
+	if (m_StatsCount == MAX_SCOPES)
+		return m_Stats[MAX_SCOPES - 1];
+
+	ScopeStats& stats = m_Stats[m_StatsCount++];
+	stats.name = name;
+	return stats;
+}
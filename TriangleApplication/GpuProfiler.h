@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+
+// Measures the GPU time of the scopes recorded into a frame's command buffer.
+// Every slot of the frames-in-flight ring has its own timestamp query pool, the results of a slot
+// are read back when the slot is reused, so the GPU is already done with them and nothing stalls.
+class GpuProfiler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr uint32_t MAX_SLOTS = 4;
+	static constexpr uint32_t MAX_SCOPES = 16; // Per frame, the frame itself included
+
+	GpuProfiler() = default;
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// Doesn't create anything if the queue family doesn't support the timestamps
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, const VkAllocationCallbacks* callbacks = nullptr);
+	void Destroy() noexcept;
+
+	// Maps the timestamps onto the host steady clock, VK_EXT_calibrated_timestamps has to be enabled on the device
+	void InitCalibration(VkInstance instance, VkPhysicalDevice physicalDevice);
+
+	// Writes the scopes of every collected frame to a CSV file
+	void OpenTrace(const std::filesystem::path& path);
+
+	// The frame is a scope of its own, it contains every other scope of the slot
+	void BeginFrame(VkCommandBuffer commandBuffer, uint32_t slot, uint64_t frameNumber);
+	void EndFrame(VkCommandBuffer commandBuffer);
+
+	// The command buffer recorded for the slot is submitted again, it writes the same scopes under a new frame number
+	void ReplayFrame(uint32_t slot, uint64_t frameNumber) noexcept;
+
+	// Returns the index of the scope, or UINT32_MAX if the scope isn't recorded
+	uint32_t BeginScope(VkCommandBuffer commandBuffer, const char* name);
+	void EndScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+	// Reads back the last frame of the slot, the frame has to be complete. Returns false if there was nothing to read
+	bool Collect(uint32_t slot);
+
+	inline bool IsSupported() const noexcept { return m_Supported; }
+	inline bool IsCalibrated() const noexcept { return m_GetCalibratedTimestamps != nullptr; }
+
+	// Of the last collected frame, the host times are only known when the profiler is calibrated
+	inline uint64_t GetCollectedFrame() const noexcept { return m_CollectedFrame; }
+	inline double GetFrameTime() const noexcept { return m_FrameTime; }
+	inline Clock::time_point GetFrameBegin() const noexcept { return m_FrameBegin; }
+	inline Clock::time_point GetFrameEnd() const noexcept { return m_FrameEnd; }
+
+	// The raw timestamps of the last collected frame, the queues of a device write them on the same clock
+	inline uint64_t GetFrameBeginTicks() const noexcept { return m_FrameBeginTicks; }
+	inline uint64_t GetFrameEndTicks() const noexcept { return m_FrameEndTicks; }
+	inline uint64_t GetTimestampMask() const noexcept { return m_TimestampMask; }
+	inline double GetTimestampPeriod() const noexcept { return m_TimestampPeriod; }
+
+	void Report(std::ostream& stream, const char* title = "GPU") const;
+private:
+	typedef struct ScopeStats_t {
+		const char* name = nullptr;
+		double average = 0.0; // Exponential moving average in milliseconds
+		uint64_t count = 0;
+	} ScopeStats;
+
+	typedef struct Scope_t {
+		const char* name = nullptr;
+		uint32_t depth = 0;
+	} Scope;
+
+	typedef struct Slot_t {
+		VkQueryPool pool = VK_NULL_HANDLE;
+		std::array<Scope, MAX_SCOPES> scopes;
+		uint32_t scopeCount = 0;
+		uint64_t frameNumber = 0;
+		bool pending = false;
+	} Slot;
+
+	ScopeStats& GetStats(const char* name) noexcept;
+
+	// Keeps the previous pair when the timestamps can't be read
+	bool Calibrate();
+	Clock::time_point ToHostTime(uint64_t ticks) const noexcept;
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+	bool m_Supported = false;
+	double m_TimestampPeriod = 1.0; // Nanoseconds per tick
+	uint64_t m_TimestampMask = ~0ull;
+
+	std::array<Slot, MAX_SLOTS> m_Slots;
+	Slot* m_Recording = nullptr;
+	uint32_t m_Depth = 0;
+
+	std::array<ScopeStats, MAX_SCOPES> m_Stats;
+	uint32_t m_StatsCount = 0;
+
+	uint64_t m_CollectedFrame = 0;
+	double m_FrameTime = 0.0;
+	uint64_t m_FrameBeginTicks = 0,
+			 m_FrameEndTicks = 0;
+	Clock::time_point m_FrameBegin, m_FrameEnd;
+
+	// The GPU and the host clocks drift apart, so the pair is refreshed regularly
+	PFN_vkGetCalibratedTimestampsEXT m_GetCalibratedTimestamps = nullptr;
+	VkTimeDomainEXT m_HostDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+	uint64_t m_CalibrationTicks = 0;
+	Clock::time_point m_CalibrationTime;
+
+	std::ofstream m_Trace;
+};
+
+// Records a GPU scope until the end of the C++ scope
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+		: m_Profiler(profiler), m_CommandBuffer(commandBuffer), m_Scope(profiler.BeginScope(commandBuffer, name))
+	{
+	}
+
+	~GpuScope()
+	{
+		m_Profiler.EndScope(m_CommandBuffer, m_Scope);
+	}
+
+	GpuScope(const GpuScope&) = delete;
+	GpuScope& operator=(const GpuScope&) = delete;
+private:
+	GpuProfiler& m_Profiler;
+	VkCommandBuffer m_CommandBuffer;
+	uint32_t m_Scope;
+};
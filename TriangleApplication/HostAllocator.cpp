@@ -0,0 +1,314 @@
+#include "HostAllocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+static const char* GetScopeName(uint32_t scope) noexcept
+{
+	switch (scope)
+	{
+	case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+		return "command";
+	case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+		return "object";
+	case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+		return "cache";
+	case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+		return "device";
+	default:
+		return "instance";
+	}
+}
+
+static size_t AlignUp(size_t value, size_t alignment) noexcept
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+HostAllocator::HostAllocator()
+{
+	m_Callbacks.pUserData = this;
+	m_Callbacks.pfnAllocation = &HostAllocator::AllocationCallback;
+	m_Callbacks.pfnReallocation = &HostAllocator::ReallocationCallback;
+	m_Callbacks.pfnFree = &HostAllocator::FreeCallback;
+	m_Callbacks.pfnInternalAllocation = &HostAllocator::InternalAllocationCallback;
+	m_Callbacks.pfnInternalFree = &HostAllocator::InternalFreeCallback;
+}
+
+HostAllocator::~HostAllocator()
+{
+	for (auto slab : m_Slabs)
+		::operator delete(slab, std::align_val_t(MAX_CLASS_SIZE));
+
+	if (m_Arena != nullptr)
+		::operator delete(m_Arena, std::align_val_t(MAX_CLASS_SIZE));
+}
+
+HostAllocator::ScopeStats HostAllocator::GetStats(VkSystemAllocationScope scope) const noexcept
+{
+	const AtomicScopeStats& stats = m_Stats[scope];
+
+	ScopeStats result;
+	result.allocationCount = stats.allocationCount.load(std::memory_order_relaxed);
+	result.allocatedBytes = stats.allocatedBytes.load(std::memory_order_relaxed);
+	result.freeCount = stats.freeCount.load(std::memory_order_relaxed);
+	result.liveCount = stats.liveCount.load(std::memory_order_relaxed);
+	result.liveBytes = stats.liveBytes.load(std::memory_order_relaxed);
+	result.pooledCount = stats.pooledCount.load(std::memory_order_relaxed);
+	result.heapCount = stats.heapCount.load(std::memory_order_relaxed);
+	result.internalCount = stats.internalCount.load(std::memory_order_relaxed);
+	result.internalBytes = stats.internalBytes.load(std::memory_order_relaxed);
+	return result;
+}
+
+void HostAllocator::ResetCounters() noexcept
+{
+	for (auto& stats : m_Stats)
+	{
+		stats.allocationCount.store(0, std::memory_order_relaxed);
+		stats.allocatedBytes.store(0, std::memory_order_relaxed);
+		stats.freeCount.store(0, std::memory_order_relaxed);
+		stats.pooledCount.store(0, std::memory_order_relaxed);
+		stats.heapCount.store(0, std::memory_order_relaxed);
+		stats.internalCount.store(0, std::memory_order_relaxed);
+	}
+}
+
+void HostAllocator::Report(std::ostream& stream) const
+{
+	stream << "Host allocations by scope:\n";
+
+	for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+	{
+		ScopeStats stats = GetStats(static_cast<VkSystemAllocationScope>(scope));
+
+		stream << "  " << GetScopeName(scope) << ": "
+			   << stats.allocationCount << " allocations (" << stats.allocatedBytes << " bytes, "
+			   << stats.pooledCount << " pooled, " << stats.heapCount << " from the heap), "
+			   << stats.freeCount << " frees, "
+			   << stats.liveCount << " live (" << stats.liveBytes << " bytes)";
+
+		if (stats.internalCount > 0)
+			stream << ", " << stats.internalCount << " internal (" << stats.internalBytes << " bytes)";
+
+		stream << "\n";
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	stream << "  command arena peak: " << m_ArenaPeak << " of " << ARENA_SIZE << " bytes\n";
+}
+
+void* VKAPI_CALL HostAllocator::AllocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<HostAllocator*>(userData)->Allocate(size, alignment, scope);
+}
+
+void* VKAPI_CALL HostAllocator::ReallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(userData);
+
+	if (original == nullptr)
+		return allocator->Allocate(size, alignment, scope);
+
+	if (size == 0)
+	{
+		allocator->Free(original);
+		return nullptr;
+	}
+
+	// The original stays untouched if the new allocation fails
+	void* memory = allocator->Allocate(size, alignment, scope);
+	if (memory == nullptr)
+		return nullptr;
+
+	const Header* header = reinterpret_cast<const Header*>(static_cast<std::byte*>(original) - HEADER_SIZE);
+	std::memcpy(memory, original, std::min<size_t>(header->size, size));
+
+	allocator->Free(original);
+	return memory;
+}
+
+void VKAPI_CALL HostAllocator::FreeCallback(void* userData, void* memory)
+{
+	static_cast<HostAllocator*>(userData)->Free(memory);
+}
+
+void VKAPI_CALL HostAllocator::InternalAllocationCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	AtomicScopeStats& stats = static_cast<HostAllocator*>(userData)->m_Stats[scope];
+	stats.internalCount.fetch_add(1, std::memory_order_relaxed);
+	stats.internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VKAPI_CALL HostAllocator::InternalFreeCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	AtomicScopeStats& stats = static_cast<HostAllocator*>(userData)->m_Stats[scope];
+	stats.internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* HostAllocator::Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) noexcept
+{
+	if (size == 0)
+		return nullptr;
+
+	// The header sits right in front of the returned pointer, the padding keeps the pointer aligned
+	size_t padding = std::max(alignment, HEADER_SIZE);
+
+	void* memory = nullptr;
+	Source source = Source::Heap;
+
+	if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+	{
+		memory = AllocateFromArena(size, alignment);
+		source = Source::Arena;
+	}
+	else if (scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT)
+	{
+		memory = AllocateFromPool(size, padding);
+		source = Source::Pool;
+	}
+
+	if (memory == nullptr)
+	{
+		memory = AllocateFromHeap(size, padding);
+		source = Source::Heap;
+	}
+
+	if (memory == nullptr)
+		return nullptr;
+
+	Header* header = reinterpret_cast<Header*>(static_cast<std::byte*>(memory) - HEADER_SIZE);
+	header->size = size;
+	header->scope = static_cast<uint8_t>(scope);
+	header->source = source;
+
+	AtomicScopeStats& stats = m_Stats[scope];
+	stats.allocationCount.fetch_add(1, std::memory_order_relaxed);
+	stats.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	stats.liveCount.fetch_add(1, std::memory_order_relaxed);
+	stats.liveBytes.fetch_add(size, std::memory_order_relaxed);
+	(source == Source::Heap ? stats.heapCount : stats.pooledCount).fetch_add(1, std::memory_order_relaxed);
+
+	return memory;
+}
+
+void HostAllocator::Free(void* memory) noexcept
+{
+	if (memory == nullptr)
+		return;
+
+	Header* header = reinterpret_cast<Header*>(static_cast<std::byte*>(memory) - HEADER_SIZE);
+	std::byte* slot = static_cast<std::byte*>(memory) - header->padding;
+
+	AtomicScopeStats& stats = m_Stats[header->scope];
+	stats.freeCount.fetch_add(1, std::memory_order_relaxed);
+	stats.liveCount.fetch_sub(1, std::memory_order_relaxed);
+	stats.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+	switch (header->source)
+	{
+	case Source::Pool:
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		*reinterpret_cast<void**>(slot) = m_FreeSlots[header->sizeClass];
+		m_FreeSlots[header->sizeClass] = slot;
+		break;
+	}
+	case Source::Arena:
+	{
+		// The command scope allocations are short lived, the arena starts over once they are all gone
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (--m_ArenaLive == 0)
+			m_ArenaOffset = 0;
+		break;
+	}
+	case Source::Heap:
+		::operator delete(slot, std::align_val_t(header->padding));
+		break;
+	}
+}
+
+void* HostAllocator::AllocateFromPool(size_t size, size_t padding) noexcept
+{
+	// A slot is aligned to its own size, which covers the padding and so the requested alignment
+	size_t required = size + padding;
+	if (required > MAX_CLASS_SIZE)
+		return nullptr;
+
+	uint32_t sizeClass = 0;
+	while ((MIN_CLASS_SIZE << sizeClass) < required)
+		sizeClass++;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (m_FreeSlots[sizeClass] == nullptr)
+	{
+		std::byte* slab = static_cast<std::byte*>(::operator new(SLAB_SIZE, std::align_val_t(MAX_CLASS_SIZE), std::nothrow));
+		if (slab == nullptr)
+			return nullptr;
+
+		m_Slabs.push_back(slab);
+
+		// Threading the whole slab into the free list of the class
+		size_t slotSize = MIN_CLASS_SIZE << sizeClass;
+		for (size_t offset = SLAB_SIZE; offset >= slotSize; offset -= slotSize)
+		{
+			std::byte* slot = slab + offset - slotSize;
+			*reinterpret_cast<void**>(slot) = m_FreeSlots[sizeClass];
+			m_FreeSlots[sizeClass] = slot;
+		}
+	}
+
+	std::byte* slot = static_cast<std::byte*>(m_FreeSlots[sizeClass]);
+	m_FreeSlots[sizeClass] = *reinterpret_cast<void**>(slot);
+
+	Header* header = reinterpret_cast<Header*>(slot + padding - HEADER_SIZE);
+	header->padding = static_cast<uint32_t>(padding);
+	header->sizeClass = static_cast<uint8_t>(sizeClass);
+
+	return slot + padding;
+}
+
+void* HostAllocator::AllocateFromArena(size_t size, size_t alignment) noexcept
+{
+	if (alignment > MAX_CLASS_SIZE)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (m_Arena == nullptr)
+	{
+		m_Arena = static_cast<std::byte*>(::operator new(ARENA_SIZE, std::align_val_t(MAX_CLASS_SIZE), std::nothrow));
+		if (m_Arena == nullptr)
+			return nullptr;
+	}
+
+	size_t offset = AlignUp(m_ArenaOffset + HEADER_SIZE, std::max(alignment, HEADER_SIZE));
+	if (offset + size > ARENA_SIZE)
+		return nullptr;
+
+	Header* header = reinterpret_cast<Header*>(m_Arena + offset - HEADER_SIZE);
+	header->padding = static_cast<uint32_t>(offset - m_ArenaOffset);
+	header->sizeClass = 0;
+
+	m_ArenaOffset = offset + size;
+	m_ArenaPeak = std::max(m_ArenaPeak, m_ArenaOffset);
+	m_ArenaLive++;
+
+	return m_Arena + offset;
+}
+
+void* HostAllocator::AllocateFromHeap(size_t size, size_t padding) noexcept
+{
+	// The padding is a multiple of the alignment, so aligning the base to it aligns the returned pointer too
+	std::byte* base = static_cast<std::byte*>(::operator new(size + padding, std::align_val_t(padding), std::nothrow));
+	if (base == nullptr)
+		return nullptr;
+
+	Header* header = reinterpret_cast<Header*>(base + padding - HEADER_SIZE);
+	header->padding = static_cast<uint32_t>(padding);
+	header->sizeClass = 0;
+
+	return base + padding;
+}
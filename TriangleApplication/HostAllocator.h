@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+// The VkAllocationCallbacks handed to every vkCreate*/vkDestroy* call, so the host allocations of the driver
+// are counted per VkSystemAllocationScope and kept off the general heap where they churn:
+// - object scope allocations come from pooled power-of-two size classes,
+// - command scope allocations only live during a single command and come from a linear arena,
+//   which is rewound whenever its last allocation is freed,
+// - the rest (and whatever doesn't fit) goes to the heap.
+class HostAllocator
+{
+public:
+	static constexpr uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+	static constexpr size_t MIN_CLASS_SIZE = 32;
+	static constexpr size_t MAX_CLASS_SIZE = 4096;     // Larger object allocations go to the heap
+	static constexpr size_t SLAB_SIZE = 64 * 1024;     // The size classes are carved out of slabs
+	static constexpr size_t ARENA_SIZE = 256 * 1024;
+
+	typedef struct ScopeStats_t {
+		uint64_t allocationCount = 0;
+		uint64_t allocatedBytes = 0;  // Requested by the driver
+		uint64_t freeCount = 0;
+		uint64_t liveCount = 0;
+		uint64_t liveBytes = 0;
+		uint64_t pooledCount = 0;     // Served by a size class or the arena
+		uint64_t heapCount = 0;       // Fell back to the heap
+		uint64_t internalCount = 0;   // Reported through pfnInternalAllocation
+		uint64_t internalBytes = 0;   // Still held by the driver, like liveBytes
+	} ScopeStats;
+
+	HostAllocator();
+	~HostAllocator();
+	HostAllocator(const HostAllocator&) = delete;
+	HostAllocator& operator=(const HostAllocator&) = delete;
+
+	inline const VkAllocationCallbacks* GetCallbacks() const noexcept { return &m_Callbacks; }
+
+	ScopeStats GetStats(VkSystemAllocationScope scope) const noexcept;
+
+	// Clears the allocation, free and internal counters but keeps the live ones, so a loop can be measured on its own
+	void ResetCounters() noexcept;
+	void Report(std::ostream& stream) const;
+private:
+	enum class Source : uint8_t {
+		Pool,
+		Arena,
+		Heap
+	};
+
+	// Stored right in front of every allocation, pfnFree only gets the pointer
+	typedef struct alignas(16) Header_t {
+		uint64_t size;
+		uint32_t padding;   // From the start of the slot to the returned pointer
+		uint8_t scope;
+		Source source;
+		uint8_t sizeClass;
+	} Header;
+
+	static constexpr size_t HEADER_SIZE = sizeof(Header);
+	static constexpr uint32_t CLASS_COUNT = 8; // 32 to 4096 bytes
+
+	typedef struct AtomicScopeStats_t {
+		std::atomic<uint64_t> allocationCount{ 0 }, allocatedBytes{ 0 }, freeCount{ 0 },
+							  liveCount{ 0 }, liveBytes{ 0 }, pooledCount{ 0 }, heapCount{ 0 },
+							  internalCount{ 0 }, internalBytes{ 0 };
+	} AtomicScopeStats;
+
+	static void* VKAPI_CALL AllocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_CALL ReallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_CALL FreeCallback(void* userData, void* memory);
+	static void VKAPI_CALL InternalAllocationCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static void VKAPI_CALL InternalFreeCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+	void* Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) noexcept;
+	void Free(void* memory) noexcept;
+
+	void* AllocateFromPool(size_t size, size_t padding) noexcept;
+	void* AllocateFromArena(size_t size, size_t alignment) noexcept;
+	void* AllocateFromHeap(size_t size, size_t padding) noexcept;
+
+	VkAllocationCallbacks m_Callbacks{};
+	std::array<AtomicScopeStats, SCOPE_COUNT> m_Stats;
+
+	// The pools and the arena share a lock, the driver may allocate from the startup workers
+	mutable std::mutex m_Mutex;
+
+	std::array<void*, CLASS_COUNT> m_FreeSlots{}; // Intrusive free lists, the first bytes of a free slot point to the next one
+	std::vector<std::byte*> m_Slabs;
+
+	std::byte* m_Arena = nullptr;
+	size_t m_ArenaOffset = 0;
+	uint64_t m_ArenaLive = 0;
+	size_t m_ArenaPeak = 0;
+};
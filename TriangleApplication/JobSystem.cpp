@@ -0,0 +1,276 @@
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+
+// The failed steal attempts before an idle worker goes to sleep
+static constexpr uint32_t IDLE_SPINS = 64;
+
+// Tells the workers which scheduler they belong to, every other thread is the outside thread
+static thread_local const JobSystem* t_JobSystem = nullptr;
+static thread_local uint32_t t_ThreadIndex = 0;
+
+bool JobSystem::JobQueue::Push(Job* job) noexcept
+{
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	int64_t top = m_Top.load(std::memory_order_acquire);
+
+	if (bottom - top >= static_cast<int64_t>(QUEUE_CAPACITY))
+		return false;
+
+	// A release store rather than a release fence and a relaxed store, ThreadSanitizer doesn't model the fences
+	m_Jobs[bottom & (QUEUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+	m_Bottom.store(bottom + 1, std::memory_order_release);
+
+	return true;
+}
+
+JobSystem::Job* JobSystem::JobQueue::Pop() noexcept
+{
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_Top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// Empty, restoring the bottom
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_Jobs[bottom & (QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+
+	if (top == bottom)
+	{
+		// The last job, racing the thieves for it
+		if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+JobSystem::Job* JobSystem::JobQueue::Steal() noexcept
+{
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+		return nullptr;
+
+	Job* job = m_Jobs[top & (QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+
+	if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+
+	return job;
+}
+
+bool JobSystem::JobQueue::IsEmpty() const noexcept
+{
+	return m_Top.load(std::memory_order_seq_cst) >= m_Bottom.load(std::memory_order_seq_cst);
+}
+
+JobSystem::~JobSystem()
+{
+	StopWorkers();
+}
+
+void JobSystem::Init(uint32_t workerCount)
+{
+	m_ThreadCount = std::min(workerCount, MAX_WORKERS) + 1;
+	m_Threads = std::make_unique<ThreadState[]>(m_ThreadCount);
+
+	for (uint32_t i = 0; i < m_ThreadCount; i++)
+		m_Threads[i].random = i * 0x9E3779B9u + 1;
+
+	m_Stopping = false;
+	m_Workers.reserve(m_ThreadCount - 1);
+
+	for (uint32_t i = 1; i < m_ThreadCount; i++)
+		m_Workers.emplace_back(&JobSystem::RunWorker, this, i);
+}
+
+void JobSystem::Destroy() noexcept
+{
+	StopWorkers();
+
+	m_Threads.reset();
+	m_ThreadCount = 0;
+}
+
+void JobSystem::Run(JobFunction function, void* context, uint32_t count, JobCounter& counter)
+{
+	if (count == 0)
+		return;
+
+	uint32_t thread = GetThreadIndex();
+	ThreadState& state = m_Threads[thread];
+
+	// Counted up front, so the counter can't reach zero while the batch is still being queued
+	counter.value.fetch_add(count, std::memory_order_relaxed);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Job* job = AllocateJob(thread);
+		job->function = function;
+		job->context = context;
+		job->index = i;
+		job->counter = &counter;
+		job->pending.store(true, std::memory_order_relaxed);
+
+		if (!state.queue.Push(job))
+			Execute(job);
+	}
+
+	// Pairs with the fence of a worker going to sleep: either it sees the jobs or it's counted as sleeping here
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (m_Sleeping.load(std::memory_order_relaxed) > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Condition.notify_all();
+	}
+}
+
+void JobSystem::Wait(const JobCounter& counter)
+{
+	uint32_t thread = GetThreadIndex();
+
+	while (counter.value.load(std::memory_order_acquire) != 0)
+	{
+		// The remaining jobs are running elsewhere
+		if (!TryRunJob(thread))
+			std::this_thread::yield();
+	}
+}
+
+uint32_t JobSystem::GetThreadIndex() const noexcept
+{
+	return t_JobSystem == this ? t_ThreadIndex : 0;
+}
+
+JobSystem::Job* JobSystem::AllocateJob(uint32_t thread)
+{
+	ThreadState& state = m_Threads[thread];
+
+	while (true)
+	{
+		// Skipping the unfinished jobs, a job waiting on a nested batch holds its slot until the batch is done
+		for (uint32_t i = 0; i < QUEUE_CAPACITY; i++)
+		{
+			Job* job = &state.jobs[state.nextJob++ & (QUEUE_CAPACITY - 1)];
+
+			if (!job->pending.load(std::memory_order_acquire))
+				return job;
+		}
+
+		// Every slot is taken, helping until one is released
+		if (!TryRunJob(thread))
+			std::this_thread::yield();
+	}
+}
+
+bool JobSystem::TryRunJob(uint32_t thread)
+{
+	ThreadState& state = m_Threads[thread];
+	Job* job = state.queue.Pop();
+
+	if (job == nullptr)
+	{
+		// Starting at a random thread, so the thieves don't all pile onto the same queue
+		state.random ^= state.random << 13;
+		state.random ^= state.random >> 17;
+		state.random ^= state.random << 5;
+
+		for (uint32_t i = 0; job == nullptr && i < m_ThreadCount; i++)
+		{
+			uint32_t victim = (state.random + i) % m_ThreadCount;
+			if (victim != thread)
+				job = m_Threads[victim].queue.Steal();
+		}
+	}
+
+	if (job == nullptr)
+		return false;
+
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Execute(Job* job) noexcept
+{
+	job->function(job->context, job->index);
+
+	// The counter goes first, the slot may be reused as soon as it's released
+	job->counter->value.fetch_sub(1, std::memory_order_release);
+	job->pending.store(false, std::memory_order_release);
+}
+
+bool JobSystem::HasWork() const noexcept
+{
+	for (uint32_t i = 0; i < m_ThreadCount; i++)
+	{
+		if (!m_Threads[i].queue.IsEmpty())
+			return true;
+	}
+
+	return false;
+}
+
+void JobSystem::RunWorker(uint32_t thread)
+{
+	PROFILE_THREAD("Job worker");
+
+	t_JobSystem = this;
+	t_ThreadIndex = thread;
+
+	uint32_t idleSpins = 0;
+
+	while (true)
+	{
+		if (TryRunJob(thread))
+		{
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		idleSpins = 0;
+
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_Stopping)
+			return;
+
+		m_Sleeping.fetch_add(1, std::memory_order_seq_cst);
+
+		if (!HasWork())
+			m_Condition.wait(lock);
+
+		m_Sleeping.fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+void JobSystem::StopWorkers() noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+	}
+
+	m_Condition.notify_all();
+
+	for (auto& worker : m_Workers)
+		worker.join();
+
+	m_Workers.clear();
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished jobs of a batch, JobSystem::Wait() returns once it drops to zero
+typedef struct JobCounter_t {
+	std::atomic<uint32_t> value{ 0 };
+} JobCounter;
+
+// A work-stealing job scheduler. Every thread owns a Chase-Lev deque: the owner pushes and pops its jobs
+// at the bottom without a lock, while the idle threads steal the oldest jobs from the top of the others.
+// Jobs are submitted by the workers and by a single outside thread at a time, the one rendering the frames,
+// which runs jobs itself while it waits for a counter.
+class JobSystem
+{
+public:
+	static constexpr uint32_t MAX_WORKERS = 15;
+	static constexpr uint32_t QUEUE_CAPACITY = 1024; // The unfinished jobs a thread may have submitted, a power of two
+
+	// Runs the job index of a batch, a plain function pointer, so submitting doesn't allocate. Jobs must not throw
+	using JobFunction = void (*)(void* context, uint32_t index);
+
+	JobSystem() = default;
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void Init(uint32_t workerCount);
+	void Destroy() noexcept;
+
+	// Queues the jobs function(context, 0) to function(context, count - 1),
+	// the counter grows by count and drops by one as every job finishes
+	void Run(JobFunction function, void* context, uint32_t count, JobCounter& counter);
+
+	// Runs the queued jobs of any batch until the counter drops to zero
+	void Wait(const JobCounter& counter);
+
+	inline uint32_t GetWorkerCount() const noexcept { return static_cast<uint32_t>(m_Workers.size()); }
+	inline bool IsInitialized() const noexcept { return m_Threads != nullptr; }
+private:
+	typedef struct Job_t {
+		JobFunction function = nullptr;
+		void* context = nullptr;
+		uint32_t index = 0;
+		JobCounter* counter = nullptr;
+		std::atomic<bool> pending{ false }; // The slot can't be reused before the job has finished
+	} Job;
+
+	// The deque of "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al.) with a fixed capacity
+	class JobQueue
+	{
+	public:
+		// Owner only, false when the queue is full
+		bool Push(Job* job) noexcept;
+		Job* Pop() noexcept;
+
+		// Any thread, nullptr when empty or when another thread took the job first
+		Job* Steal() noexcept;
+
+		bool IsEmpty() const noexcept;
+	private:
+		alignas(64) std::atomic<int64_t> m_Top{ 0 };
+		alignas(64) std::atomic<int64_t> m_Bottom{ 0 };
+		std::array<std::atomic<Job*>, QUEUE_CAPACITY> m_Jobs{};
+	};
+
+	typedef struct ThreadState_t {
+		JobQueue queue;
+		std::array<Job, QUEUE_CAPACITY> jobs; // The ring the thread allocates its jobs from
+		uint32_t nextJob = 0;
+		uint32_t random = 0; // Picks the thread to steal from
+	} ThreadState;
+
+	// 0 is the outside thread, the workers follow
+	uint32_t GetThreadIndex() const noexcept;
+
+	Job* AllocateJob(uint32_t thread);
+	bool TryRunJob(uint32_t thread);
+	void Execute(Job* job) noexcept;
+	bool HasWork() const noexcept;
+
+	void RunWorker(uint32_t thread);
+	void StopWorkers() noexcept;
+
+	std::unique_ptr<ThreadState[]> m_Threads;
+	uint32_t m_ThreadCount = 0;
+	std::vector<std::thread> m_Workers;
+
+	// The idle workers sleep here, the submitters only take the lock when someone sleeps
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::atomic<uint32_t> m_Sleeping{ 0 };
+	bool m_Stopping = false;
+};
@@ -0,0 +1,86 @@
+#include "Mesh.h"
+
+#include <cmath>
+
+Mesh CreateTriangleMesh()
+{
+	Mesh mesh;
+
+	mesh.vertices = {
+		{ {  0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+		{ {  0.5f,  0.5f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f } }
+	};
+	mesh.indices = { 0, 1, 2 };
+
+	return mesh;
+}
+
+Mesh CreateGridMesh(uint32_t columns, uint32_t rows)
+{
+	Mesh mesh;
+
+	if (columns < 2 || rows < 2)
+		return mesh;
+
+	mesh.vertices.reserve(static_cast<size_t>(columns) * rows);
+	mesh.indices.reserve(static_cast<size_t>(columns - 1) * (rows - 1) * 6);
+
+	for (uint32_t y = 0; y < rows; y++)
+	{
+		for (uint32_t x = 0; x < columns; x++)
+		{
+			float u = static_cast<float>(x) / (columns - 1),
+				  v = static_cast<float>(y) / (rows - 1);
+
+			mesh.vertices.push_back({ { u * 2.0f - 1.0f, v * 2.0f - 1.0f }, { u, v, 1.0f - u } });
+		}
+	}
+
+	for (uint32_t y = 0; y + 1 < rows; y++)
+	{
+		for (uint32_t x = 0; x + 1 < columns; x++)
+		{
+			uint32_t corner = y * columns + x;
+
+			mesh.indices.insert(mesh.indices.end(), {
+				corner, corner + 1, corner + columns,
+				corner + 1, corner + columns + 1, corner + columns
+			});
+		}
+	}
+
+	return mesh;
+}
+
+std::vector<Instance> CreateInstanceGrid(uint32_t count)
+{
+	std::vector<Instance> instances;
+	instances.reserve(count);
+
+	if (count == 1)
+	{
+		instances.push_back({ { 0.0f, 0.0f, 1.0f, 0.0f }, { 1.0f, 1.0f, 1.0f } });
+		return instances;
+	}
+
+	uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	float cell = 2.0f / side;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t x = i % side,
+				 y = i / side;
+
+		float u = static_cast<float>(x) / side,
+			  v = static_cast<float>(y) / side;
+
+		// The triangle spans one unit, so scaling by the cell size keeps the neighbours from overlapping
+		instances.push_back({
+			{ -1.0f + (x + 0.5f) * cell, -1.0f + (y + 0.5f) * cell, cell, (u + v) * 6.2831853f },
+			{ 0.5f + 0.5f * u, 0.5f + 0.5f * v, 1.0f - 0.5f * u }
+		});
+	}
+
+	return instances;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The vertex layout of triangle.vert
+typedef struct Vertex_t {
+	float position[2];
+	float color[3];
+
+	static VkVertexInputBindingDescription GetBindingDescription() noexcept
+	{
+		VkVertexInputBindingDescription binding{};
+		binding.binding = 0;
+		binding.stride = sizeof(Vertex_t);
+		binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return binding;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions() noexcept
+	{
+		std::array<VkVertexInputAttributeDescription, 2> attributes{};
+
+		attributes[0].location = 0;
+		attributes[0].binding = 0;
+		attributes[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributes[0].offset = offsetof(Vertex_t, position);
+
+		attributes[1].location = 1;
+		attributes[1].binding = 0;
+		attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributes[1].offset = offsetof(Vertex_t, color);
+
+		return attributes;
+	}
+} Vertex;
+
+// The per-instance data of triangle.vert, read through an instance-rate binding
+typedef struct Instance_t {
+	float transform[4]; // Offset x/y, uniform scale, rotation in radians
+	float color[3];     // Multiplies the vertex colors
+
+	static VkVertexInputBindingDescription GetBindingDescription() noexcept
+	{
+		VkVertexInputBindingDescription binding{};
+		binding.binding = 1;
+		binding.stride = sizeof(Instance_t);
+		binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+		return binding;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions() noexcept
+	{
+		std::array<VkVertexInputAttributeDescription, 2> attributes{};
+
+		attributes[0].location = 2;
+		attributes[0].binding = 1;
+		attributes[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attributes[0].offset = offsetof(Instance_t, transform);
+
+		attributes[1].location = 3;
+		attributes[1].binding = 1;
+		attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributes[1].offset = offsetof(Instance_t, color);
+
+		return attributes;
+	}
+} Instance;
+
+typedef struct Mesh_t {
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+} Mesh;
+
+// The triangle the application always drew
+Mesh CreateTriangleMesh();
+
+// A grid of columns x rows vertices covering the viewport, two triangles per cell
+Mesh CreateGridMesh(uint32_t columns, uint32_t rows);
+
+// A single instance draws the mesh unchanged, more instances are laid out on a square grid covering the viewport
+std::vector<Instance> CreateInstanceGrid(uint32_t count);
@@ -0,0 +1,123 @@
+#include "ParallelRecorder.h"
+#include "CpuProfiler.h"
+#include "AllocationTracker.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void ParallelRecorder::Init(VkDevice device, uint32_t queueFamilyIndex, uint32_t chunkCount, JobSystem& jobs, const VkAllocationCallbacks* callbacks)
+{
+	m_Device = device;
+	m_Callbacks = callbacks;
+	m_Jobs = &jobs;
+	m_Chunks.resize(std::clamp(chunkCount, 1u, MAX_CHUNKS));
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // The whole pool is reset every frame
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+	for (auto& chunk : m_Chunks)
+	{
+		for (uint32_t slot = 0; slot < MAX_SLOTS; slot++)
+		{
+			if (vkCreateCommandPool(m_Device, &poolInfo, m_Callbacks, &chunk.pools[slot]) != VK_SUCCESS)
+				throw std::runtime_error("A recording command pool hasn't been created!");
+
+			VkCommandBufferAllocateInfo commandBufferInfo{};
+			commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferInfo.commandPool = chunk.pools[slot];
+			commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			commandBufferInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(m_Device, &commandBufferInfo, &chunk.commandBuffers[slot]) != VK_SUCCESS)
+				throw std::runtime_error("A secondary command buffer hasn't been allocated!");
+		}
+	}
+}
+
+void ParallelRecorder::Destroy() noexcept
+{
+	// Freeing a pool frees its command buffers
+	for (auto& chunk : m_Chunks)
+	{
+		for (auto pool : chunk.pools)
+			vkDestroyCommandPool(m_Device, pool, m_Callbacks);
+	}
+
+	m_Chunks.clear();
+}
+
+uint32_t ParallelRecorder::Record(uint32_t slot, const VkCommandBufferInheritanceInfo& inheritance, uint32_t itemCount,
+								  RecordFunction function, void* context)
+{
+	uint32_t chunkCount = std::min(itemCount, GetChunkCount());
+
+	if (chunkCount == 0)
+		return 0;
+
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		Chunk& chunk = m_Chunks[i];
+		chunk.first = static_cast<uint32_t>(static_cast<uint64_t>(itemCount) * i / chunkCount);
+		chunk.count = static_cast<uint32_t>(static_cast<uint64_t>(itemCount) * (i + 1) / chunkCount) - chunk.first;
+		chunk.error = nullptr;
+	}
+
+	m_Slot = slot;
+	m_Inheritance = &inheritance;
+	m_Function = function;
+	m_Context = context;
+
+	// The calling thread records chunks as well while it waits
+	JobCounter counter;
+	m_Jobs->Run(&ParallelRecorder::RecordChunkJob, this, chunkCount, counter);
+	m_Jobs->Wait(counter);
+
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		if (m_Chunks[i].error)
+			std::rethrow_exception(m_Chunks[i].error);
+
+		m_Recorded[i] = m_Chunks[i].commandBuffers[slot];
+	}
+
+	return chunkCount;
+}
+
+void ParallelRecorder::RecordChunkJob(void* recorder, uint32_t index)
+{
+	static_cast<ParallelRecorder*>(recorder)->RecordChunk(index);
+}
+
+void ParallelRecorder::RecordChunk(uint32_t index) noexcept
+{
+	PROFILE_ZONE("RecordChunk");
+	TRACK_FRAME_ALLOCATIONS("RecordChunk");
+
+	Chunk& chunk = m_Chunks[index];
+	VkCommandBuffer commandBuffer = chunk.commandBuffers[m_Slot];
+
+	try
+	{
+		vkResetCommandPool(m_Device, chunk.pools[m_Slot], 0);
+
+		// Continues the render pass of the primary command buffer
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = m_Inheritance;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("Can't begin recording a secondary command buffer!");
+
+		m_Function(m_Context, commandBuffer, chunk.first, chunk.count);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Can't record a secondary command buffer!");
+	}
+	catch (...)
+	{
+		chunk.error = std::current_exception();
+	}
+}
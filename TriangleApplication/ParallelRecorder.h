@@ -0,0 +1,62 @@
+#pragma once
+
+#include "JobSystem.h"
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+// Records the draws of a render pass as jobs into secondary command buffers,
+// which the primary command buffer then runs with vkCmdExecuteCommands.
+// The draws are split into chunks, and every chunk owns a command pool per slot of the frames-in-flight ring.
+// A chunk is recorded by a single job per frame, so the pools never need a lock
+// and a slot's pools are simply reset once the GPU is done with the slot.
+class ParallelRecorder
+{
+public:
+	static constexpr uint32_t MAX_CHUNKS = 16;
+	static constexpr uint32_t MAX_SLOTS = 4;
+
+	// Records the items [first, first + count) into the secondary command buffer.
+	// A plain function pointer, so dispatching a frame doesn't allocate
+	using RecordFunction = void (*)(void* context, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count);
+
+	void Init(VkDevice device, uint32_t queueFamilyIndex, uint32_t chunkCount, JobSystem& jobs, const VkAllocationCallbacks* callbacks = nullptr);
+	void Destroy() noexcept;
+
+	// Splits the items evenly into the chunks and runs jobs until every chunk is recorded, the first exception
+	// thrown by a chunk is rethrown. Returns the number of secondary command buffers in GetCommandBuffers().
+	// The GPU has to be done with the slot
+	uint32_t Record(uint32_t slot, const VkCommandBufferInheritanceInfo& inheritance, uint32_t itemCount,
+					RecordFunction function, void* context);
+
+	inline const VkCommandBuffer* GetCommandBuffers() const noexcept { return m_Recorded.data(); }
+	inline uint32_t GetChunkCount() const noexcept { return static_cast<uint32_t>(m_Chunks.size()); }
+private:
+	typedef struct Chunk_t {
+		std::array<VkCommandPool, MAX_SLOTS> pools{};
+		std::array<VkCommandBuffer, MAX_SLOTS> commandBuffers{};
+		uint32_t first = 0;
+		uint32_t count = 0;
+		std::exception_ptr error;
+	} Chunk;
+
+	static void RecordChunkJob(void* recorder, uint32_t index);
+	void RecordChunk(uint32_t index) noexcept;
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+	JobSystem* m_Jobs = nullptr;
+
+	std::vector<Chunk> m_Chunks;
+	std::array<VkCommandBuffer, MAX_CHUNKS> m_Recorded{};
+
+	// The current dispatch, read by the jobs
+	uint32_t m_Slot = 0;
+	const VkCommandBufferInheritanceInfo* m_Inheritance = nullptr;
+	RecordFunction m_Function = nullptr;
+	void* m_Context = nullptr;
+};
@@ -0,0 +1,178 @@
+#include "PipelineCache.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+
+static constexpr uint32_t FILE_MAGIC = 0x31435054; // "TPC1"
+
+void PipelineCache::Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::filesystem::path& directory,
+						 const VkAllocationCallbacks* callbacks)
+{
+	m_Device = device;
+	m_Callbacks = callbacks;
+	vkGetPhysicalDeviceProperties(physicalDevice, &m_Properties);
+
+	// Different GPUs get different files, so switching between them doesn't throw the other cache away
+	char fileName[64];
+	std::snprintf(fileName, sizeof(fileName), "pipeline_%04x_%04x.cache", m_Properties.vendorID, m_Properties.deviceID);
+	m_Path = directory / fileName;
+
+	std::vector<char> data = LoadData();
+	m_Warm = !data.empty();
+
+	VkPipelineCacheCreateInfo cacheInfo{};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	cacheInfo.initialDataSize = data.size();
+	cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(m_Device, &cacheInfo, m_Callbacks, &m_Cache) != VK_SUCCESS)
+		throw std::runtime_error("Pipeline cache hasn't been created!");
+}
+
+void PipelineCache::Destroy() noexcept
+{
+	if (m_Cache != VK_NULL_HANDLE)
+		vkDestroyPipelineCache(m_Device, m_Cache, m_Callbacks);
+
+	m_Cache = VK_NULL_HANDLE;
+}
+
+void PipelineCache::Save() const noexcept
+{
+	if (m_Cache == VK_NULL_HANDLE)
+		return;
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(m_Device, m_Cache, &size, nullptr) != VK_SUCCESS || size == 0)
+		return;
+
+	std::vector<char> data(sizeof(FileHeader) + size);
+	if (vkGetPipelineCacheData(m_Device, m_Cache, &size, data.data() + sizeof(FileHeader)) != VK_SUCCESS)
+		return;
+
+	FileHeader header{};
+	header.magic = FILE_MAGIC;
+	header.vendorID = m_Properties.vendorID;
+	header.deviceID = m_Properties.deviceID;
+	header.driverVersion = m_Properties.driverVersion;
+	std::memcpy(header.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = size;
+	header.checksum = GetChecksum(data.data() + sizeof(FileHeader), size);
+	std::memcpy(data.data(), &header, sizeof(FileHeader));
+
+	// Writing to a temporary file first, an interrupted write must not leave a truncated cache behind
+	std::filesystem::path temporaryPath = m_Path;
+	temporaryPath += ".tmp";
+
+	std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+	if (file.is_open())
+	{
+		// Closed before the check, the buffered part is only written then
+		file.write(data.data(), sizeof(FileHeader) + size);
+		file.close();
+	}
+
+	std::error_code error;
+	if (file.fail())
+		std::cerr << "Pipeline cache hasn't been saved: can't write " << temporaryPath.string() << "\n";
+	else
+	{
+		std::filesystem::rename(temporaryPath, m_Path, error);
+
+		if (!error)
+			return;
+
+		std::cerr << "Pipeline cache hasn't been saved: " << error.message() << "\n";
+	}
+
+	// A partial file is never picked up by the next run, but isn't left behind either
+	std::filesystem::remove(temporaryPath, error);
+}
+
+std::vector<char> PipelineCache::LoadData() const
+{
+	std::ifstream file(m_Path, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open())
+		return {};
+
+	size_t size = file.tellg();
+	std::vector<char> source(size);
+
+	file.seekg(0);
+	file.read(source.data(), size);
+
+	const char* reason = nullptr;
+	if (!file.good() || !IsValid(source, reason))
+	{
+		std::cout << "Pipeline cache " << m_Path.string() << " is ignored: " << (reason ? reason : "read error") << "\n";
+		return {};
+	}
+
+	// Only the driver's part is passed to Vulkan
+	return std::vector<char>(source.begin() + sizeof(FileHeader), source.end());
+}
+
+bool PipelineCache::IsValid(const std::vector<char>& file, const char*& reason) const noexcept
+{
+	if (file.size() < sizeof(FileHeader) + sizeof(VkPipelineCacheHeaderVersionOne))
+	{
+		reason = "the file is truncated";
+		return false;
+	}
+
+	FileHeader header;
+	std::memcpy(&header, file.data(), sizeof(FileHeader));
+
+	if (header.magic != FILE_MAGIC || header.dataSize != file.size() - sizeof(FileHeader))
+	{
+		reason = "the file header is corrupt";
+		return false;
+	}
+
+	if (header.vendorID != m_Properties.vendorID || header.deviceID != m_Properties.deviceID ||
+		header.driverVersion != m_Properties.driverVersion ||
+		std::memcmp(header.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		reason = "the file has been written by another device or driver";
+		return false;
+	}
+
+	if (header.checksum != GetChecksum(file.data() + sizeof(FileHeader), header.dataSize))
+	{
+		reason = "the checksum doesn't match";
+		return false;
+	}
+
+	// The driver validates its own header as well, but a mismatch there is treated the same way
+	VkPipelineCacheHeaderVersionOne driverHeader;
+	std::memcpy(&driverHeader, file.data() + sizeof(FileHeader), sizeof(driverHeader));
+
+	if (driverHeader.headerSize < sizeof(VkPipelineCacheHeaderVersionOne) || driverHeader.headerSize > header.dataSize ||
+		driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		driverHeader.vendorID != m_Properties.vendorID || driverHeader.deviceID != m_Properties.deviceID ||
+		std::memcmp(driverHeader.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		reason = "the driver header doesn't match the device";
+		return false;
+	}
+
+	return true;
+}
+
+uint64_t PipelineCache::GetChecksum(const char* data, size_t size) noexcept
+{
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
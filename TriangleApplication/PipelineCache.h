@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <filesystem>
+#include <vector>
+
+// VkPipelineCache persisted on disk between the launches.
+// The file is keyed on the device and the driver, a stale or corrupt file is ignored.
+class PipelineCache
+{
+public:
+	PipelineCache() = default;
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::filesystem::path& directory,
+			  const VkAllocationCallbacks* callbacks = nullptr);
+	void Destroy() noexcept;
+
+	// Writes the cache back to the disk, failures only cost a cold start next time
+	void Save() const noexcept;
+
+	inline VkPipelineCache GetHandle() const noexcept { return m_Cache; }
+	inline bool IsWarm() const noexcept { return m_Warm; }
+private:
+	// Prepended to the driver's data, VkPipelineCacheHeaderVersionOne doesn't contain the driver version
+	typedef struct FileHeader_t {
+		uint32_t magic;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t checksum;
+	} FileHeader;
+
+	std::vector<char> LoadData() const;
+	bool IsValid(const std::vector<char>& file, const char*& reason) const noexcept;
+	static uint64_t GetChecksum(const char* data, size_t size) noexcept;
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+	VkPipelineCache m_Cache = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties m_Properties{};
+
+	std::filesystem::path m_Path;
+	bool m_Warm = false;
+};
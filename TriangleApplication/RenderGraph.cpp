@@ -0,0 +1,594 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// The synchronization scope of a usage
+typedef struct UsageInfo_t {
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 readAccess = VK_ACCESS_2_NONE;
+	VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; // Ignored by the buffers
+} UsageInfo;
+
+static UsageInfo GetUsageInfo(ResourceUsage usage) noexcept
+{
+	switch (usage)
+	{
+	case ResourceUsage::TransferSource:
+		return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+	case ResourceUsage::TransferDestination:
+		return { VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+	case ResourceUsage::ComputeStorage:
+		return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+	case ResourceUsage::IndirectArguments:
+		return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED };
+	case ResourceUsage::VertexInput:
+		return { VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED };
+	case ResourceUsage::ColorAttachment:
+		return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	case ResourceUsage::FragmentSampled:
+		return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	case ResourceUsage::Present:
+		// The present waits on the semaphore signaled after all the commands
+		return { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+	default:
+		return {};
+	}
+}
+
+void RenderGraph::Init(VkDevice device, uint32_t queueFamilyIndex, DeviceAllocator& allocator, const VkAllocationCallbacks* callbacks)
+{
+	m_Device = device;
+	m_QueueFamilyIndex = queueFamilyIndex;
+	m_Allocator = &allocator;
+	m_Callbacks = callbacks;
+}
+
+void RenderGraph::Destroy() noexcept
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	Reset();
+	m_Device = VK_NULL_HANDLE;
+}
+
+void RenderGraph::Reset() noexcept
+{
+	DestroyTransientImages();
+
+	m_Resources.clear();
+	m_Passes.clear();
+	m_Order.clear();
+	m_Batches.clear();
+	m_BufferBarriers.clear();
+	m_ImageBarriers.clear();
+	m_BufferBarrierResources.clear();
+	m_ImageBarrierResources.clear();
+}
+
+RenderGraph::ResourceId RenderGraph::ImportBuffer(const char* name, bool persistent)
+{
+	Resource resource;
+	resource.name = name;
+	resource.persistent = persistent;
+
+	m_Resources.push_back(resource);
+	return static_cast<ResourceId>(m_Resources.size() - 1);
+}
+
+RenderGraph::ResourceId RenderGraph::ImportImage(const char* name, VkImageAspectFlags aspect)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.persistent = false;
+	resource.aspect = aspect;
+
+	m_Resources.push_back(resource);
+	return static_cast<ResourceId>(m_Resources.size() - 1);
+}
+
+void RenderGraph::AcquireBuffer(ResourceId resource, uint32_t srcQueueFamily)
+{
+	// Nothing to transfer within a family
+	if (srcQueueFamily != m_QueueFamilyIndex)
+		m_Resources[resource].acquireFamily = srcQueueFamily;
+}
+
+RenderGraph::ResourceId RenderGraph::CreateImage(const char* name, const VkImageCreateInfo& info, VkImageAspectFlags aspect)
+{
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.transient = true;
+	resource.persistent = false;
+	resource.aspect = aspect;
+	resource.imageInfo = info;
+	resource.imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	m_Resources.push_back(resource);
+	return static_cast<ResourceId>(m_Resources.size() - 1);
+}
+
+RenderGraph::PassId RenderGraph::AddPass(const char* name, PassFunction function, void* context)
+{
+	Pass pass;
+	pass.name = name;
+	pass.function = function;
+	pass.context = context;
+
+	m_Passes.push_back(std::move(pass));
+	return static_cast<PassId>(m_Passes.size() - 1);
+}
+
+void RenderGraph::Read(PassId pass, ResourceId resource, ResourceUsage usage)
+{
+	AddAccess(pass, resource, usage, true, false);
+}
+
+void RenderGraph::Write(PassId pass, ResourceId resource, ResourceUsage usage)
+{
+	AddAccess(pass, resource, usage, false, true);
+}
+
+void RenderGraph::ReadWrite(PassId pass, ResourceId resource, ResourceUsage usage)
+{
+	AddAccess(pass, resource, usage, true, true);
+}
+
+void RenderGraph::SetOutput(ResourceId resource, ResourceUsage finalUsage, uint32_t dstQueueFamily)
+{
+	m_Resources[resource].output = true;
+	m_Resources[resource].finalUsage = finalUsage;
+
+	if (dstQueueFamily != m_QueueFamilyIndex)
+		m_Resources[resource].releaseFamily = dstQueueFamily;
+}
+
+void RenderGraph::Compile()
+{
+	DestroyTransientImages();
+
+	m_Order.clear();
+	m_Batches.clear();
+	m_BufferBarriers.clear();
+	m_ImageBarriers.clear();
+	m_BufferBarrierResources.clear();
+	m_ImageBarrierResources.clear();
+
+	CullPasses();
+
+	for (auto& resource : m_Resources)
+	{
+		resource.firstPass = UINT32_MAX;
+		resource.lastPass = 0;
+	}
+
+	for (uint32_t order = 0; order < m_Order.size(); order++)
+	{
+		for (const Access& access : m_Passes[m_Order[order]].accesses)
+		{
+			Resource& resource = m_Resources[access.resource];
+			resource.firstPass = std::min(resource.firstPass, order);
+			resource.lastPass = std::max(resource.lastPass, order);
+		}
+	}
+
+	PlaceTransientImages();
+
+	// The first run finds the state the frame leaves the resources in, which is where the next frame starts.
+	// The imported images are acquired undefined every frame, the buffers of another queue family are acquired again
+	std::vector<ResourceState> states(m_Resources.size());
+	Simulate(states, false);
+
+	for (uint32_t i = 0; i < m_Resources.size(); i++)
+	{
+		if (!m_Resources[i].persistent && !m_Resources[i].transient)
+			states[i] = {};
+
+		states[i].acquire = m_Resources[i].acquireFamily != VK_QUEUE_FAMILY_IGNORED;
+	}
+
+	Simulate(states, true);
+}
+
+void RenderGraph::SetBuffer(ResourceId resource, VkBuffer buffer) noexcept
+{
+	m_Resources[resource].buffer = buffer;
+}
+
+void RenderGraph::SetImage(ResourceId resource, VkImage image) noexcept
+{
+	m_Resources[resource].image = image;
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer, GpuProfiler& profiler)
+{
+	for (uint32_t i = 0; i < m_Order.size(); i++)
+	{
+		const Pass& pass = m_Passes[m_Order[i]];
+
+		// The barriers are timed with the pass waiting on them
+		GpuScope scope(profiler, commandBuffer, pass.name);
+		RecordBarriers(commandBuffer, m_Batches[i]);
+		pass.function(pass.context, commandBuffer);
+	}
+
+	RecordBarriers(commandBuffer, m_Batches.back());
+}
+
+void RenderGraph::Report(std::ostream& stream, const char* title) const
+{
+	stream << "[" << title << "]:" << "\n\n";
+
+	for (uint32_t order = 0, i = 0; i < m_Passes.size(); i++)
+	{
+		stream << m_Passes[i].name << ": ";
+
+		if (m_Passes[i].culled)
+		{
+			stream << "culled\n";
+			continue;
+		}
+
+		const BarrierBatch& batch = m_Batches[order++];
+		stream << batch.bufferCount << " buffer and " << batch.imageCount << " image barriers\n";
+	}
+
+	VkDeviceSize transientBytes = 0;
+	for (auto& memorySlot : m_MemorySlots)
+		transientBytes += memorySlot.requirements.size;
+
+	stream << "Final: " << m_Batches.back().bufferCount << " buffer and " << m_Batches.back().imageCount << " image barriers\n"
+		   << "Transient images: " << transientBytes << " bytes in " << m_MemorySlots.size() << " allocations\n\n";
+}
+
+void RenderGraph::AddAccess(PassId pass, ResourceId resource, ResourceUsage usage, bool reads, bool writes)
+{
+	for (auto& access : m_Passes[pass].accesses)
+	{
+		if (access.resource != resource)
+			continue;
+
+		// A pass gets a single barrier per resource, so its uses have to agree
+		if (access.usage != usage)
+			throw std::runtime_error("A pass uses a resource in two different ways!");
+
+		access.reads |= reads;
+		access.writes |= writes;
+		return;
+	}
+
+	Access access;
+	access.resource = resource;
+	access.usage = usage;
+	access.reads = reads;
+	access.writes = writes;
+	m_Passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::CullPasses()
+{
+	// Walking backwards from the outputs, a pass is kept when it writes what an output or a kept pass after it needs
+	std::vector<bool> needed(m_Resources.size());
+	for (uint32_t i = 0; i < m_Resources.size(); i++)
+		needed[i] = m_Resources[i].output;
+
+	for (uint32_t i = static_cast<uint32_t>(m_Passes.size()); i-- > 0;)
+	{
+		Pass& pass = m_Passes[i];
+		pass.culled = true;
+
+		for (const Access& access : pass.accesses)
+		{
+			if (access.writes && needed[access.resource])
+				pass.culled = false;
+		}
+
+		if (pass.culled)
+			continue;
+
+		for (const Access& access : pass.accesses)
+		{
+			if (access.reads)
+				needed[access.resource] = true;
+		}
+	}
+
+	for (uint32_t i = 0; i < m_Passes.size(); i++)
+	{
+		if (!m_Passes[i].culled)
+			m_Order.push_back(i);
+	}
+}
+
+void RenderGraph::PlaceTransientImages()
+{
+	// The images used by a culled pass only aren't created
+	std::vector<ResourceId> images;
+	for (ResourceId i = 0; i < m_Resources.size(); i++)
+	{
+		if (m_Resources[i].transient && m_Resources[i].firstPass != UINT32_MAX)
+			images.push_back(i);
+	}
+
+	std::sort(images.begin(), images.end(), [this](ResourceId a, ResourceId b) {
+		return m_Resources[a].firstPass < m_Resources[b].firstPass;
+	});
+
+	// In the order of their first use, every image goes into the first memory that is free again by then
+	std::vector<uint32_t> slots(m_Resources.size());
+
+	for (ResourceId id : images)
+	{
+		Resource& resource = m_Resources[id];
+
+		if (vkCreateImage(m_Device, &resource.imageInfo, m_Callbacks, &resource.image) != VK_SUCCESS)
+			throw std::runtime_error("A transient image hasn't been created!");
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(m_Device, resource.image, &requirements);
+
+		uint32_t slot = 0;
+		while (slot < m_MemorySlots.size() && (m_MemorySlots[slot].lastPass >= resource.firstPass ||
+			   (m_MemorySlots[slot].requirements.memoryTypeBits & requirements.memoryTypeBits) == 0))
+			slot++;
+
+		if (slot == m_MemorySlots.size())
+		{
+			MemorySlot memorySlot;
+			memorySlot.requirements = requirements;
+			memorySlot.firstResource = id;
+			memorySlot.lastResource = id;
+			m_MemorySlots.push_back(memorySlot);
+		}
+
+		MemorySlot& memorySlot = m_MemorySlots[slot];
+		memorySlot.requirements.size = std::max(memorySlot.requirements.size, requirements.size);
+		memorySlot.requirements.alignment = std::max(memorySlot.requirements.alignment, requirements.alignment);
+		memorySlot.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+
+		resource.previous = memorySlot.lastResource;
+		memorySlot.lastPass = resource.lastPass;
+		memorySlot.lastResource = id;
+		slots[id] = slot;
+	}
+
+	// The first image of a memory follows the last one of the previous frame
+	for (auto& memorySlot : m_MemorySlots)
+	{
+		m_Resources[memorySlot.firstResource].previous = memorySlot.lastResource;
+		memorySlot.allocation = m_Allocator->Allocate(memorySlot.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Optimal);
+	}
+
+	for (ResourceId id : images)
+	{
+		const DeviceAllocation& allocation = m_MemorySlots[slots[id]].allocation;
+
+		if (vkBindImageMemory(m_Device, m_Resources[id].image, allocation.memory, allocation.offset) != VK_SUCCESS)
+			throw std::runtime_error("The memory of a transient image hasn't been bound!");
+	}
+}
+
+void RenderGraph::DestroyTransientImages() noexcept
+{
+	for (auto& resource : m_Resources)
+	{
+		if (!resource.transient || resource.image == VK_NULL_HANDLE)
+			continue;
+
+		vkDestroyImage(m_Device, resource.image, m_Callbacks);
+		resource.image = VK_NULL_HANDLE;
+	}
+
+	for (auto& memorySlot : m_MemorySlots)
+	{
+		if (memorySlot.allocation.memory != VK_NULL_HANDLE)
+			m_Allocator->Free(memorySlot.allocation);
+	}
+
+	m_MemorySlots.clear();
+}
+
+void RenderGraph::Simulate(std::vector<ResourceState>& states, bool record)
+{
+	for (uint32_t order = 0; order <= m_Order.size(); order++)
+	{
+		BarrierBatch batch;
+		batch.firstBuffer = static_cast<uint32_t>(m_BufferBarriers.size());
+		batch.firstImage = static_cast<uint32_t>(m_ImageBarriers.size());
+
+		if (order < m_Order.size())
+		{
+			for (const Access& access : m_Passes[m_Order[order]].accesses)
+			{
+				const Resource& resource = m_Resources[access.resource];
+				ResourceState& state = states[access.resource];
+
+				// A transient image waits for the one using its memory before, its content is undefined
+				if (resource.transient && resource.firstPass == order)
+				{
+					state = states[resource.previous];
+					state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+					state.visibleStages = 0;
+					state.visibleAccess = 0;
+				}
+
+				AddBarrier(access.resource, state, access.usage, access.reads, access.writes, false, record);
+			}
+		}
+		else
+		{
+			// After the last pass the outputs are handed over in their final usage or released to their queue family
+			for (ResourceId i = 0; i < m_Resources.size(); i++)
+			{
+				bool release = m_Resources[i].releaseFamily != VK_QUEUE_FAMILY_IGNORED;
+
+				if (m_Resources[i].output && (release || m_Resources[i].finalUsage != ResourceUsage::None))
+					AddBarrier(i, states[i], m_Resources[i].finalUsage, true, false, release, record);
+			}
+		}
+
+		if (!record)
+			continue;
+
+		batch.bufferCount = static_cast<uint32_t>(m_BufferBarriers.size()) - batch.firstBuffer;
+		batch.imageCount = static_cast<uint32_t>(m_ImageBarriers.size()) - batch.firstImage;
+		m_Batches.push_back(batch);
+	}
+}
+
+bool RenderGraph::AddBarrier(ResourceId resource, ResourceState& state, ResourceUsage usage, bool reads, bool writes, bool release, bool record)
+{
+	const Resource& target = m_Resources[resource];
+	UsageInfo info = GetUsageInfo(usage);
+
+	// The destination scope of a release is on the other queue, its acquire barrier waits instead
+	VkPipelineStageFlags2 dstStages = release ? VK_PIPELINE_STAGE_2_NONE : info.stages;
+	VkAccessFlags2 dstAccess = (reads ? info.readAccess : VK_ACCESS_2_NONE) | (writes ? info.writeAccess : VK_ACCESS_2_NONE);
+	bool transition = target.isImage && state.layout != info.layout;
+	bool acquire = state.acquire;
+
+	if (release)
+		dstAccess = VK_ACCESS_2_NONE;
+
+	VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+	uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED;
+	uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED;
+	bool barrier = false;
+
+	if (acquire)
+	{
+		// The release made the writes of the other queue available, the semaphore wait on the stage
+		// of this access chains with the barrier
+		srcStages = info.stages;
+		srcFamily = target.acquireFamily;
+		dstFamily = m_QueueFamilyIndex;
+		barrier = true;
+	}
+	else if (release)
+	{
+		// Every access since the last write is done before the other queue gets the resource
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+		srcFamily = m_QueueFamilyIndex;
+		dstFamily = target.releaseFamily;
+		barrier = true;
+	}
+	else if (transition)
+	{
+		// The layout transition writes the image, so it waits for every access since the last write.
+		// An image nothing has touched yet is acquired by a semaphore wait on the stage of its first use
+		srcStages = state.writeStages | state.readStages;
+		srcAccess = state.writeAccess;
+
+		if (srcStages == VK_PIPELINE_STAGE_2_NONE)
+			srcStages = info.stages;
+
+		barrier = true;
+	}
+	else if (writes && state.readStages != VK_PIPELINE_STAGE_2_NONE)
+	{
+		// Write after read, an execution dependency is enough, the reads already saw the last write
+		srcStages = state.readStages;
+		barrier = true;
+	}
+	else if (state.writeStages != VK_PIPELINE_STAGE_2_NONE &&
+			 (writes || (info.stages & ~state.visibleStages) != 0 || (dstAccess & ~state.visibleAccess) != 0))
+	{
+		// Write after write, or the first read of the last write by these stages and accesses
+		srcStages = state.writeStages;
+		srcAccess = state.writeAccess;
+		barrier = true;
+	}
+
+	if (barrier && record)
+	{
+		if (target.isImage)
+		{
+			VkImageMemoryBarrier2 imageBarrier{};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			imageBarrier.srcStageMask = srcStages;
+			imageBarrier.srcAccessMask = srcAccess;
+			imageBarrier.dstStageMask = dstStages;
+			imageBarrier.dstAccessMask = dstAccess;
+			imageBarrier.oldLayout = state.layout;
+			imageBarrier.newLayout = info.layout;
+			imageBarrier.srcQueueFamilyIndex = srcFamily;
+			imageBarrier.dstQueueFamilyIndex = dstFamily;
+			imageBarrier.subresourceRange = { target.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+			m_ImageBarriers.push_back(imageBarrier);
+			m_ImageBarrierResources.push_back(resource);
+		}
+		else
+		{
+			VkBufferMemoryBarrier2 bufferBarrier{};
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			bufferBarrier.srcStageMask = srcStages;
+			bufferBarrier.srcAccessMask = srcAccess;
+			bufferBarrier.dstStageMask = dstStages;
+			bufferBarrier.dstAccessMask = dstAccess;
+			bufferBarrier.srcQueueFamilyIndex = srcFamily;
+			bufferBarrier.dstQueueFamilyIndex = dstFamily;
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+
+			m_BufferBarriers.push_back(bufferBarrier);
+			m_BufferBarrierResources.push_back(resource);
+		}
+	}
+
+	state.acquire = false;
+
+	if (writes || transition || acquire)
+	{
+		// The later accesses wait for this one, a transition makes the image visible to its stages.
+		// The reads of a read-write access come before its write, they don't make the write visible to anyone
+		state.writeStages = info.stages;
+		state.writeAccess = writes ? info.writeAccess : VK_ACCESS_2_NONE;
+		state.readStages = reads && !writes ? info.stages : VK_PIPELINE_STAGE_2_NONE;
+		state.visibleStages = writes ? VK_PIPELINE_STAGE_2_NONE : info.stages;
+		state.visibleAccess = writes ? VK_ACCESS_2_NONE : dstAccess;
+
+		if (target.isImage)
+			state.layout = info.layout;
+	}
+	else
+	{
+		if (barrier)
+		{
+			state.visibleStages |= info.stages;
+			state.visibleAccess |= dstAccess;
+		}
+
+		state.readStages |= info.stages;
+	}
+
+	return barrier;
+}
+
+void RenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) noexcept
+{
+	if (batch.bufferCount == 0 && batch.imageCount == 0)
+		return;
+
+	// The imported handles may have changed since the last frame
+	for (uint32_t i = batch.firstBuffer; i < batch.firstBuffer + batch.bufferCount; i++)
+		m_BufferBarriers[i].buffer = m_Resources[m_BufferBarrierResources[i]].buffer;
+
+	for (uint32_t i = batch.firstImage; i < batch.firstImage + batch.imageCount; i++)
+		m_ImageBarriers[i].image = m_Resources[m_ImageBarrierResources[i]].image;
+
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.bufferMemoryBarrierCount = batch.bufferCount;
+	dependencyInfo.pBufferMemoryBarriers = m_BufferBarriers.data() + batch.firstBuffer;
+	dependencyInfo.imageMemoryBarrierCount = batch.imageCount;
+	dependencyInfo.pImageMemoryBarriers = m_ImageBarriers.data() + batch.firstImage;
+
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
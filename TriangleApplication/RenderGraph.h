@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+#include "GpuProfiler.h"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Where and how a pass touches a resource, selects the stages, the accesses and the image layout of its barriers
+enum class ResourceUsage {
+	None,
+	TransferSource,
+	TransferDestination,
+	ComputeStorage,     // A storage buffer or image of a compute shader
+	IndirectArguments,
+	VertexInput,        // Vertex or index buffer
+	ColorAttachment,
+	FragmentSampled,
+	Present
+};
+
+// The passes of a frame declare the resources they read and write, and Compile() turns the declarations into
+// a vkCmdPipelineBarrier2 batch in front of every pass with the stages and accesses of both sides.
+// A pass is culled, and never records, when nothing it writes reaches an output of the graph.
+// Imported buffers keep their content, so the first accesses of a frame wait for the last ones of the previous frame.
+// Imported images start every frame undefined (the swapchain images) and the transient images only live
+// between their first and last pass, the ones whose lifetimes don't overlap share their memory.
+// A graph records for a single queue family, the resources handed between the graphs of two families
+// are released by the final barriers of one and acquired by the first access in the other.
+// The graph is built and compiled outside the frame loop, executing it doesn't allocate.
+class RenderGraph
+{
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+
+	// Records the commands of a pass, its barriers have been recorded before.
+	// A plain function pointer like the jobs, so executing the graph doesn't allocate
+	using PassFunction = void (*)(void* context, VkCommandBuffer commandBuffer);
+
+	RenderGraph() = default;
+	RenderGraph(const RenderGraph&) = delete;
+	RenderGraph& operator=(const RenderGraph&) = delete;
+
+	void Init(VkDevice device, uint32_t queueFamilyIndex, DeviceAllocator& allocator, const VkAllocationCallbacks* callbacks = nullptr);
+	void Destroy() noexcept;
+
+	// Removes the passes and the resources, the GPU has to be done with the transient images
+	void Reset() noexcept;
+
+	// The handles of the imported resources may change between the frames, they're set with SetBuffer and SetImage.
+	// A buffer that isn't persistent starts every frame without pending accesses, like a buffer per frame in flight
+	// whose previous frame the host has waited for
+	ResourceId ImportBuffer(const char* name, bool persistent = true);
+	ResourceId ImportImage(const char* name, VkImageAspectFlags aspect);
+
+	// The buffer is released by another queue family every frame, its first access acquires it.
+	// The release must be waited on by a semaphore on the stage of that access
+	void AcquireBuffer(ResourceId resource, uint32_t srcQueueFamily);
+
+	// Created by Compile, the initial layout of the info is ignored
+	ResourceId CreateImage(const char* name, const VkImageCreateInfo& info, VkImageAspectFlags aspect);
+
+	// The passes run in the order they are added
+	PassId AddPass(const char* name, PassFunction function, void* context);
+	void Read(PassId pass, ResourceId resource, ResourceUsage usage);
+	void Write(PassId pass, ResourceId resource, ResourceUsage usage);
+	void ReadWrite(PassId pass, ResourceId resource, ResourceUsage usage);
+
+	// Keeps the passes writing the resource, which is left in the final usage at the end of the frame.
+	// With a queue family the resource is released to it instead, the final usage then only selects the layout
+	void SetOutput(ResourceId resource, ResourceUsage finalUsage, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+	// Culls the passes, places the transient images and computes the barriers.
+	// Imported images must be acquired by a semaphore wait on the stage of their first use
+	void Compile();
+
+	void SetBuffer(ResourceId resource, VkBuffer buffer) noexcept;
+	void SetImage(ResourceId resource, VkImage image) noexcept;
+	inline VkImage GetImage(ResourceId resource) const noexcept { return m_Resources[resource].image; }
+
+	// Every kept pass gets a GPU scope named after it
+	void Execute(VkCommandBuffer commandBuffer, GpuProfiler& profiler);
+
+	// Prints the kept and the culled passes with their barriers and the memory of the transient images
+	void Report(std::ostream& stream, const char* title = "RENDER GRAPH") const;
+private:
+	typedef struct Resource_t {
+		const char* name = nullptr;
+		bool isImage = false;
+		bool transient = false;
+		bool persistent = true;  // Keeps its state from the previous frame
+		VkImageAspectFlags aspect = 0;
+		VkImageCreateInfo imageInfo{};
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkImage image = VK_NULL_HANDLE;
+
+		bool output = false;
+		ResourceUsage finalUsage = ResourceUsage::None;
+
+		// The ownership transfers from and to the other queue families
+		uint32_t acquireFamily = VK_QUEUE_FAMILY_IGNORED;
+		uint32_t releaseFamily = VK_QUEUE_FAMILY_IGNORED;
+
+		// The kept passes using it, in execution order
+		uint32_t firstPass = UINT32_MAX;
+		uint32_t lastPass = 0;
+
+		// The transient image used the memory before, itself when it's alone in its memory
+		ResourceId previous = UINT32_MAX;
+	} Resource;
+
+	typedef struct Access_t {
+		ResourceId resource = 0;
+		ResourceUsage usage = ResourceUsage::None;
+		bool reads = false;
+		bool writes = false;
+	} Access;
+
+	typedef struct Pass_t {
+		const char* name = nullptr;
+		PassFunction function = nullptr;
+		void* context = nullptr;
+		std::vector<Access> accesses;
+		bool culled = false;
+	} Pass;
+
+	// The barriers recorded before a kept pass, or after the last one
+	typedef struct BarrierBatch_t {
+		uint32_t firstBuffer = 0;
+		uint32_t bufferCount = 0;
+		uint32_t firstImage = 0;
+		uint32_t imageCount = 0;
+	} BarrierBatch;
+
+	// What the next access of a resource has to wait for
+	typedef struct ResourceState_t {
+		VkPipelineStageFlags2 writeStages = 0; // The last write
+		VkAccessFlags2 writeAccess = 0;
+		VkPipelineStageFlags2 readStages = 0;  // The reads since the last write
+		VkPipelineStageFlags2 visibleStages = 0; // Where the last write has been made visible
+		VkAccessFlags2 visibleAccess = 0;
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		bool acquire = false; // The next access acquires the resource from another queue family
+	} ResourceState;
+
+	// Memory shared by transient images with disjoint lifetimes
+	typedef struct MemorySlot_t {
+		VkMemoryRequirements requirements{};
+		uint32_t lastPass = 0;
+		ResourceId firstResource = 0;
+		ResourceId lastResource = 0;
+		DeviceAllocation allocation;
+	} MemorySlot;
+
+	void AddAccess(PassId pass, ResourceId resource, ResourceUsage usage, bool reads, bool writes);
+
+	void CullPasses();
+	void PlaceTransientImages();
+	void DestroyTransientImages() noexcept;
+
+	// Plays the accesses of the kept passes, appending the barriers when recording
+	void Simulate(std::vector<ResourceState>& states, bool record);
+	bool AddBarrier(ResourceId resource, ResourceState& state, ResourceUsage usage, bool reads, bool writes, bool release, bool record);
+
+	void RecordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) noexcept;
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	uint32_t m_QueueFamilyIndex = 0;
+	DeviceAllocator* m_Allocator = nullptr;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+
+	std::vector<Resource> m_Resources;
+	std::vector<Pass> m_Passes;
+	std::vector<MemorySlot> m_MemorySlots;
+
+	// Compiled
+	std::vector<PassId> m_Order; // The kept passes
+	std::vector<BarrierBatch> m_Batches; // One per kept pass and the final one
+	std::vector<VkBufferMemoryBarrier2> m_BufferBarriers;
+	std::vector<VkImageMemoryBarrier2> m_ImageBarriers;
+	std::vector<ResourceId> m_BufferBarrierResources; // The handles are filled in when the barriers are recorded
+	std::vector<ResourceId> m_ImageBarrierResources;
+};
@@ -0,0 +1,201 @@
+#include "StagingUploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void StagingUploader::Init(VkDevice device, DeviceAllocator& allocator, VkQueue queue, uint32_t queueFamilyIndex,
+						   const VkAllocationCallbacks* callbacks)
+{
+	m_Device = device;
+	m_Allocator = &allocator;
+	m_Queue = queue;
+	m_QueueFamilyIndex = queueFamilyIndex;
+	m_Callbacks = callbacks;
+
+	VkCommandPoolCreateInfo commandPoolInfo{};
+	commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolInfo.queueFamilyIndex = queueFamilyIndex;
+
+	if (vkCreateCommandPool(m_Device, &commandPoolInfo, m_Callbacks, &m_CommandPool) != VK_SUCCESS)
+		throw std::runtime_error("The transfer command pool hasn't been created!");
+
+	VkCommandBufferAllocateInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = m_CommandPool;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	for (auto& slot : m_Slots)
+	{
+		if (vkAllocateCommandBuffers(m_Device, &commandBufferInfo, &slot.commandBuffer) != VK_SUCCESS ||
+			vkCreateFence(m_Device, &fenceInfo, m_Callbacks, &slot.fence) != VK_SUCCESS)
+			throw std::runtime_error("The transfer command buffers haven't been created!");
+	}
+
+	// Coherent, so the copies into the mapped memory never have to be flushed
+	m_Staging = CreateBuffer(STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+							 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+void StagingUploader::Destroy() noexcept
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	for (auto& slot : m_Slots)
+	{
+		if (slot.pending)
+			vkWaitForFences(m_Device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+
+		vkDestroyFence(m_Device, slot.fence, m_Callbacks);
+		slot = {};
+	}
+
+	DestroyBuffer(m_Staging);
+	vkDestroyCommandPool(m_Device, m_CommandPool, m_Callbacks);
+	m_CommandPool = VK_NULL_HANDLE;
+}
+
+DeviceBuffer StagingUploader::UploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, uint32_t sharedQueueFamily)
+{
+	DeviceBuffer buffer = CreateDeviceBuffer(size, usage, sharedQueueFamily);
+
+	try
+	{
+		WriteBuffer(buffer, data, size);
+	}
+	catch (...)
+	{
+		DestroyBuffer(buffer);
+		throw;
+	}
+
+	return buffer;
+}
+
+DeviceBuffer StagingUploader::CreateDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t sharedQueueFamily)
+{
+	return CreateBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sharedQueueFamily);
+}
+
+void StagingUploader::WriteBuffer(const DeviceBuffer& buffer, const void* data, VkDeviceSize size)
+{
+	const VkDeviceSize chunkSize = STAGING_SIZE / SLOT_COUNT;
+	const std::byte* source = static_cast<const std::byte*>(data);
+
+	for (VkDeviceSize offset = 0; offset < size; offset += chunkSize)
+	{
+		uint32_t slotIndex = m_NextSlot;
+		m_NextSlot = (m_NextSlot + 1) % SLOT_COUNT;
+
+		// The GPU may still be copying out of this half
+		StagingSlot& slot = m_Slots[slotIndex];
+		WaitForSlot(slot);
+
+		VkDeviceSize chunk = std::min(chunkSize, size - offset);
+		VkDeviceSize stagingOffset = slotIndex * chunkSize;
+		std::memcpy(static_cast<std::byte*>(m_Staging.allocation.mapped) + stagingOffset, source + offset, chunk);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkResetCommandBuffer(slot.commandBuffer, 0);
+		if (vkBeginCommandBuffer(slot.commandBuffer, &beginInfo) != VK_SUCCESS)
+			throw std::runtime_error("Can't begin recording the transfer command buffer!");
+
+		VkBufferCopy region{};
+		region.srcOffset = stagingOffset;
+		region.dstOffset = offset;
+		region.size = chunk;
+		vkCmdCopyBuffer(slot.commandBuffer, m_Staging.buffer, buffer.buffer, 1, &region);
+
+		// Makes the copy visible to the commands submitted after the upload, e.g. the vertex input of the frames
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+							 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (vkEndCommandBuffer(slot.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("Can't record the transfer command buffer!");
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &slot.commandBuffer;
+
+		if (vkQueueSubmit(m_Queue, 1, &submitInfo, slot.fence) != VK_SUCCESS)
+			throw std::runtime_error("Can't submit the transfer command buffer!");
+
+		slot.pending = true;
+	}
+
+	for (auto& slot : m_Slots)
+		WaitForSlot(slot);
+}
+
+void StagingUploader::DestroyBuffer(DeviceBuffer& buffer) noexcept
+{
+	if (buffer.buffer == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyBuffer(m_Device, buffer.buffer, m_Callbacks);
+	m_Allocator->Free(buffer.allocation);
+	buffer = {};
+}
+
+DeviceBuffer StagingUploader::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+											uint32_t sharedQueueFamily)
+{
+	uint32_t queueFamilies[] = { m_QueueFamilyIndex, sharedQueueFamily };
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (sharedQueueFamily != VK_QUEUE_FAMILY_IGNORED && sharedQueueFamily != m_QueueFamilyIndex)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = 2;
+		bufferInfo.pQueueFamilyIndices = queueFamilies;
+	}
+
+	DeviceBuffer buffer;
+	buffer.size = size;
+
+	if (vkCreateBuffer(m_Device, &bufferInfo, m_Callbacks, &buffer.buffer) != VK_SUCCESS)
+		throw std::runtime_error("A buffer hasn't been created!");
+
+	try
+	{
+		buffer.allocation = m_Allocator->AllocateBuffer(buffer.buffer, properties);
+	}
+	catch (...)
+	{
+		vkDestroyBuffer(m_Device, buffer.buffer, m_Callbacks);
+		throw;
+	}
+
+	return buffer;
+}
+
+void StagingUploader::WaitForSlot(StagingSlot& slot)
+{
+	if (!slot.pending)
+		return;
+
+	if (vkWaitForFences(m_Device, 1, &slot.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS ||
+		vkResetFences(m_Device, 1, &slot.fence) != VK_SUCCESS)
+		throw std::runtime_error("Can't wait for the transfer!");
+
+	slot.pending = false;
+}
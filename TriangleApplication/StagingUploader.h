@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+
+#include <array>
+#include <cstdint>
+
+typedef struct DeviceBuffer_t {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	DeviceAllocation allocation;
+	VkDeviceSize size = 0;
+} DeviceBuffer;
+
+// Fills DEVICE_LOCAL buffers through a host visible staging buffer and a transfer command buffer.
+// The staging buffer is split in two halves: the CPU copies the next chunk into one half
+// while the GPU copies the previous chunk out of the other one.
+// The submissions go to the given queue, so they have to be externally synchronized with the frame submissions.
+class StagingUploader
+{
+public:
+	static constexpr VkDeviceSize STAGING_SIZE = 16ull << 20;
+	static constexpr uint32_t SLOT_COUNT = 2;
+
+	void Init(VkDevice device, DeviceAllocator& allocator, VkQueue queue, uint32_t queueFamilyIndex,
+			  const VkAllocationCallbacks* callbacks = nullptr);
+	void Destroy() noexcept;
+
+	// Returns once the data is in the buffer and visible to every later submission on the queue.
+	// A shared queue family gets concurrent access to the buffer, without ownership transfers
+	DeviceBuffer UploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+							  uint32_t sharedQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+	void DestroyBuffer(DeviceBuffer& buffer) noexcept;
+
+	// The two halves of UploadBuffer, so the copies can be measured without the buffer creation
+	DeviceBuffer CreateDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+									uint32_t sharedQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+	void WriteBuffer(const DeviceBuffer& buffer, const void* data, VkDeviceSize size);
+private:
+	typedef struct StagingSlot_t {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		bool pending = false;
+	} StagingSlot;
+
+	DeviceBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+							  uint32_t sharedQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+	void WaitForSlot(StagingSlot& slot);
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	DeviceAllocator* m_Allocator = nullptr;
+	VkQueue m_Queue = VK_NULL_HANDLE;
+	uint32_t m_QueueFamilyIndex = 0;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+
+	VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+	DeviceBuffer m_Staging;
+	std::array<StagingSlot, SLOT_COUNT> m_Slots;
+	uint32_t m_NextSlot = 0;
+};
@@ -0,0 +1,158 @@
+#include "StartupGraph.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <thread>
+
+StartupGraph::StepId StartupGraph::AddStep(const char* name, std::function<void()> function, std::initializer_list<StepId> dependencies, StepAffinity affinity)
+{
+	StepId id = static_cast<StepId>(m_Steps.size());
+
+	Step step{};
+	step.name = name;
+	step.function = std::move(function);
+	step.affinity = affinity;
+	step.remainingDependencies = static_cast<uint32_t>(dependencies.size());
+	m_Steps.push_back(std::move(step));
+
+	// The dependencies are always added first, so the graph can't contain cycles
+	for (StepId dependency : dependencies)
+		m_Steps[dependency].dependents.push_back(id);
+
+	return id;
+}
+
+void StartupGraph::Run(uint32_t workerCount)
+{
+	m_Start = Clock::now();
+	m_Pending = m_Steps.size();
+
+	for (StepId id = 0; id < m_Steps.size(); id++)
+	{
+		if (m_Steps[id].remainingDependencies == 0)
+			(m_Steps[id].affinity == StepAffinity::MainThread ? m_ReadyMain : m_Ready).push_back(id);
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(workerCount);
+
+	for (uint32_t i = 0; i < workerCount; i++)
+		workers.emplace_back(&StartupGraph::RunWorker, this, i + 1);
+
+	// The main thread runs its own steps first and helps with the rest while it's free
+	RunWorker(0);
+
+	for (auto& worker : workers)
+		worker.join();
+
+	m_End = Clock::now();
+
+	if (m_Error)
+		std::rethrow_exception(m_Error);
+}
+
+void StartupGraph::RunWorker(uint32_t thread)
+{
+	if (thread != 0)
+		PROFILE_THREAD("Startup worker");
+
+	StepId step;
+
+	while (TryTakeStep(thread == 0, step))
+		ExecuteStep(step, thread);
+}
+
+bool StartupGraph::TryTakeStep(bool mainThread, StepId& step)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	m_Condition.wait(lock, [&]() {
+		return m_Pending == 0 || m_Error || !m_Ready.empty() || (mainThread && !m_ReadyMain.empty());
+	});
+
+	if (m_Pending == 0 || m_Error)
+		return false;
+
+	auto& queue = mainThread && !m_ReadyMain.empty() ? m_ReadyMain : m_Ready;
+	step = queue.back();
+	queue.pop_back();
+
+	return true;
+}
+
+void StartupGraph::ExecuteStep(StepId id, uint32_t thread)
+{
+	Step& step = m_Steps[id];
+	step.thread = thread;
+	step.start = Clock::now();
+
+	std::exception_ptr error;
+
+	try
+	{
+		PROFILE_ZONE(step.name);
+		step.function();
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	step.end = Clock::now();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		if (error)
+		{
+			// The remaining steps are abandoned, they may depend on the failed one
+			if (!m_Error)
+				m_Error = error;
+		}
+		else
+		{
+			for (StepId dependent : step.dependents)
+			{
+				if (--m_Steps[dependent].remainingDependencies == 0)
+					(m_Steps[dependent].affinity == StepAffinity::MainThread ? m_ReadyMain : m_Ready).push_back(dependent);
+			}
+		}
+
+		m_Pending--;
+	}
+
+	m_Condition.notify_all();
+}
+
+void StartupGraph::Report(std::ostream& stream) const
+{
+	using Milliseconds = std::chrono::duration<double, std::milli>;
+
+	std::vector<const Step*> steps;
+	for (auto& step : m_Steps)
+		steps.push_back(&step);
+
+	std::sort(steps.begin(), steps.end(), [](const Step* a, const Step* b) { return a->start < b->start; });
+
+	stream << "[STARTUP]:" << "\n\n";
+
+	double serialTime = 0.0;
+
+	for (auto step : steps)
+	{
+		double start = Milliseconds(step->start - m_Start).count();
+		double duration = Milliseconds(step->end - step->start).count();
+		serialTime += duration;
+
+		stream << step->name << ": " << duration << " ms (started at " << start << " ms on "
+			   << (step->thread == 0 ? "the main thread" : "worker ");
+
+		if (step->thread != 0)
+			stream << step->thread;
+
+		stream << ")\n";
+	}
+
+	stream << "Total: " << Milliseconds(m_End - m_Start).count() << " ms, "
+		   << serialTime << " ms if run sequentially\n\n";
+}
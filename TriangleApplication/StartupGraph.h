@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+enum class StepAffinity {
+	AnyThread,
+	MainThread // GLFW window functions may only be called from the main thread
+};
+
+// Runs the initialization steps as a dependency graph.
+// Independent steps are executed in parallel on a small thread pool, the thread calling Run() takes part as well.
+class StartupGraph
+{
+public:
+	using StepId = uint32_t;
+	using Clock = std::chrono::steady_clock;
+
+	StepId AddStep(const char* name, std::function<void()> function, std::initializer_list<StepId> dependencies = {},
+				   StepAffinity affinity = StepAffinity::AnyThread);
+
+	// Blocks until every step is done, the first exception thrown by a step is rethrown
+	void Run(uint32_t workerCount);
+
+	void Report(std::ostream& stream) const;
+private:
+	typedef struct Step_t {
+		const char* name = nullptr;
+		std::function<void()> function;
+		std::vector<StepId> dependents;
+		uint32_t remainingDependencies = 0;
+		StepAffinity affinity = StepAffinity::AnyThread;
+
+		uint32_t thread = 0; // 0 is the main thread
+		Clock::time_point start, end;
+	} Step;
+
+	void RunWorker(uint32_t thread);
+	bool TryTakeStep(bool mainThread, StepId& step);
+	void ExecuteStep(StepId step, uint32_t thread);
+
+	std::vector<Step> m_Steps;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::vector<StepId> m_Ready, m_ReadyMain;
+	size_t m_Pending = 0;
+	std::exception_ptr m_Error;
+
+	Clock::time_point m_Start, m_End;
+};
@@ -0,0 +1,99 @@
+#include "TestFramework.h"
+#include "../AllocationTracker.h"
+
+#include <new>
+#include <sstream>
+#include <thread>
+
+// The new expressions may be elided, calling the replaced functions directly can't be
+static void AllocateAndFree(size_t size)
+{
+	::operator delete(::operator new(size));
+}
+
+TEST(AllocationTracker, CountsTheAllocationsInsideAFrameScope)
+{
+	AllocationTracker::ResetCounters();
+
+	{
+		TRACK_FRAME_ALLOCATIONS("Test frame");
+		AllocateAndFree(64);
+		::operator delete[](::operator new[](32));
+		::operator delete(::operator new(128, std::align_val_t(64)), std::align_val_t(64));
+	}
+
+	CHECK_EQUAL(3u, AllocationTracker::GetFrameAllocationCount());
+	CHECK_EQUAL(64u + 32u + 128u, AllocationTracker::GetFrameAllocatedBytes());
+
+	std::ostringstream report;
+	AllocationTracker::Report(report);
+	CHECK(report.str().find("3 heap allocations") != std::string::npos);
+}
+
+TEST(AllocationTracker, IgnoresTheAllocationsOutsideTheFrameScope)
+{
+	AllocationTracker::ResetCounters();
+
+	AllocateAndFree(64);
+
+	{
+		FrameAllocationScope outer("Outer");
+		{
+			// A nested scope doesn't count twice
+			FrameAllocationScope inner("Inner");
+			AllocateAndFree(16);
+		}
+		AllocateAndFree(16);
+	}
+
+	AllocateAndFree(64);
+
+	CHECK_EQUAL(2u, AllocationTracker::GetFrameAllocationCount());
+}
+
+TEST(AllocationTracker, ExemptScopeSuppressesTheCount)
+{
+	AllocationTracker::ResetCounters();
+
+	{
+		TRACK_FRAME_ALLOCATIONS("Test frame");
+
+		{
+			ALLOW_FRAME_ALLOCATIONS();
+			AllocateAndFree(256);
+			AllocateAndFree(256);
+		}
+
+		CHECK_EQUAL(0u, AllocationTracker::GetFrameAllocationCount());
+
+		// The exemption ends with its scope
+		AllocateAndFree(8);
+	}
+
+	CHECK_EQUAL(1u, AllocationTracker::GetFrameAllocationCount());
+
+	std::ostringstream report;
+	AllocationTracker::ResetCounters();
+	AllocationTracker::Report(report);
+	CHECK(report.str().find("No heap allocations") != std::string::npos);
+}
+
+TEST(AllocationTracker, OnlyCountsTheThreadInsideTheScope)
+{
+	AllocationTracker::ResetCounters();
+
+	{
+		TRACK_FRAME_ALLOCATIONS("Test frame");
+
+		// Starting the thread allocates on this one
+		std::thread worker;
+		{
+			ALLOW_FRAME_ALLOCATIONS();
+			worker = std::thread([]() { AllocateAndFree(64); });
+		}
+
+		worker.join();
+	}
+
+	CHECK_EQUAL(0u, AllocationTracker::GetFrameAllocationCount());
+}
@@ -0,0 +1,94 @@
+#include "TestFramework.h"
+#include "../BuddyAllocator.h"
+
+TEST(BuddyAllocator, RoundsTheSizeDownToAPowerOfTwo)
+{
+	CHECK_EQUAL(512u, BuddyAllocator(1000).GetSize());
+	CHECK_EQUAL(4096u, BuddyAllocator(4096).GetSize());
+}
+
+TEST(BuddyAllocator, SplitsDownToTheRequestedSize)
+{
+	BuddyAllocator allocator(1024);
+
+	auto first = allocator.Allocate(1, 1);
+	auto second = allocator.Allocate(256, 1);
+	auto third = allocator.Allocate(300, 1);
+
+	CHECK(first && second && third);
+
+	// The smallest block is MIN_BLOCK_SIZE, 300 bytes take the next power of two
+	CHECK_EQUAL(0u, first->offset);
+	CHECK_EQUAL(0u, first->order);
+	CHECK_EQUAL(256u, second->offset);
+	CHECK_EQUAL(512u, third->offset);
+	CHECK_EQUAL(1u, third->order);
+	CHECK_EQUAL(1024u, allocator.GetUsedSize());
+}
+
+TEST(BuddyAllocator, FailsWhenFull)
+{
+	BuddyAllocator allocator(1024);
+
+	CHECK(!allocator.Allocate(2048, 1));
+
+	auto half = allocator.Allocate(512, 1);
+	CHECK(half);
+	CHECK(!allocator.Allocate(1024, 1));
+	CHECK(allocator.Allocate(512, 1));
+	CHECK(!allocator.Allocate(1, 1));
+}
+
+TEST(BuddyAllocator, MergesTheFreedBuddies)
+{
+	BuddyAllocator allocator(1024);
+
+	auto a = allocator.Allocate(256, 1);
+	auto b = allocator.Allocate(256, 1);
+	auto c = allocator.Allocate(512, 1);
+
+	// Freed out of order, the whole range only comes back once every pair has been merged
+	allocator.Free(*b);
+	CHECK(!allocator.Allocate(1024, 1));
+	allocator.Free(*c);
+	CHECK(!allocator.Allocate(1024, 1));
+	allocator.Free(*a);
+	CHECK(allocator.IsEmpty());
+
+	auto whole = allocator.Allocate(1024, 1);
+	CHECK(whole);
+	CHECK_EQUAL(0u, whole->offset);
+	CHECK_EQUAL(2u, whole->order);
+}
+
+TEST(BuddyAllocator, DoesntMergeWithAnAllocatedBuddy)
+{
+	BuddyAllocator allocator(1024);
+
+	auto a = allocator.Allocate(256, 1);
+	CHECK(allocator.Allocate(256, 1));
+	allocator.Free(*a);
+
+	// The free 256 bytes at 0 can't become a 512 byte block while 256 is taken
+	auto block = allocator.Allocate(512, 1);
+	CHECK(block);
+	CHECK_EQUAL(512u, block->offset);
+	CHECK(!allocator.Allocate(512, 1));
+
+	auto reused = allocator.Allocate(256, 1);
+	CHECK(reused);
+	CHECK_EQUAL(0u, reused->offset);
+}
+
+TEST(BuddyAllocator, MeetsTheAlignment)
+{
+	BuddyAllocator allocator(4096);
+
+	auto small = allocator.Allocate(256, 1);
+	auto aligned = allocator.Allocate(256, 1024);
+
+	CHECK(small && aligned);
+	CHECK_EQUAL(0u, aligned->offset % 1024);
+	CHECK_EQUAL(1024u, aligned->offset);
+	CHECK_EQUAL(1024u, BuddyAllocator::GetBlockSize(aligned->order));
+}
@@ -0,0 +1,80 @@
+#include "TestFramework.h"
+#include "../CpuProfiler.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string WriteTrace()
+{
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "TriangleTests_cpu_trace.json";
+	CpuProfiler::WriteChromeTrace(path);
+
+	std::ifstream file(path);
+	std::stringstream trace;
+	trace << file.rdbuf();
+	file.close();
+
+	std::filesystem::remove(path);
+	return trace.str();
+}
+
+static uint32_t CountOccurrences(const std::string& text, const std::string& pattern)
+{
+	uint32_t count = 0;
+	for (size_t position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+		count++;
+
+	return count;
+}
+
+TEST(CpuProfiler, KeepsTheNewestZonesOfAThread)
+{
+	std::thread thread([]() {
+		CpuProfiler::SetThreadName("Wrapping thread");
+
+		for (uint64_t i = 0; i < CpuProfiler::EVENTS_PER_THREAD + 10; i++)
+			CpuProfiler::Record("Wrapped", i, i + 1);
+	});
+	thread.join();
+
+	// The buffer outlives the thread. The oldest ten zones were overwritten, and the slot the thread
+	// would write next is skipped as if it was being written
+	std::string trace = WriteTrace();
+	CHECK_EQUAL(1u, CountOccurrences(trace, "{\"name\":\"Wrapping thread\"}"));
+	CHECK_EQUAL(CpuProfiler::EVENTS_PER_THREAD - 1, CountOccurrences(trace, "\"name\":\"Wrapped\""));
+}
+
+TEST(CpuProfiler, WritesTheTraceWhileThreadsRecord)
+{
+	std::atomic<bool> stop{ false };
+	std::vector<std::thread> threads;
+
+	// The threads overwrite their buffers many times over while the trace is written
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		threads.emplace_back([&stop]() {
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				uint64_t begin = CpuProfiler::Now();
+				CpuProfiler::Record("Busy", begin, CpuProfiler::Now());
+			}
+		});
+	}
+
+	// Every written zone is a whole one, none of them is torn by the owner rewriting its slot
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		std::string trace = WriteTrace();
+		CHECK_EQUAL(CountOccurrences(trace, "\"ph\":\"X\""),
+					CountOccurrences(trace, "{\"name\":\"Busy\",\"ph\":\"X\"") + CountOccurrences(trace, "{\"name\":\"Wrapped\",\"ph\":\"X\""));
+	}
+
+	stop.store(true, std::memory_order_relaxed);
+	for (auto& thread : threads)
+		thread.join();
+}
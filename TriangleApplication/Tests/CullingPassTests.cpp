@@ -0,0 +1,214 @@
+#include "TestFramework.h"
+#include "MockVulkan.h"
+#include "../CullingPass.h"
+#include "../Mesh.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The push constant block of cull.comp in the std430 layout
+static_assert(offsetof(CullingConstants, planes) == 0, "The planes are the first member of the push constants");
+static_assert(offsetof(CullingConstants, objectCount) == 64, "objectCount follows the vec4 planes[4]");
+static_assert(offsetof(CullingConstants, meshRadius) == 76, "meshRadius is the last member of the push constants");
+static_assert(sizeof(CullingConstants) == 80, "The push constants are 80 bytes");
+
+// cull.comp reads the instances as a float array
+static_assert(sizeof(Instance) == 7 * sizeof(float), "An instance is INSTANCE_STRIDE floats");
+
+// The test of cull.comp: an instance is culled when its bounding circle is entirely behind one of the planes
+static bool IsVisible(const CullingConstants& constants, const Instance& instance)
+{
+	float radius = constants.meshRadius * instance.transform[2];
+
+	for (const auto& plane : constants.planes)
+	{
+		if (plane[0] * instance.transform[0] + plane[1] * instance.transform[1] + plane[2] < -radius)
+			return false;
+	}
+
+	return true;
+}
+
+static Instance MakeInstance(float x, float y, float scale)
+{
+	return Instance{ { x, y, scale, 0.0f }, { 1.0f, 1.0f, 1.0f } };
+}
+
+// A culling pass on the mock device and the buffer of its instances
+typedef struct CullingFixture_t {
+	DeviceAllocator allocator;
+	CullingPass culling;
+	DeviceBuffer instances;
+
+	CullingFixture_t(uint32_t maxDrawIndirectCount)
+	{
+		ResetMockDevice();
+		allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+		const uint32_t code[] = { 0x07230203 };
+		culling.Init(MOCK_DEVICE, allocator, code, sizeof(code), VK_NULL_HANDLE, maxDrawIndirectCount);
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = 1024;
+		bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		vkCreateBuffer(MOCK_DEVICE, &bufferInfo, nullptr, &instances.buffer);
+	}
+
+	~CullingFixture_t()
+	{
+		vkDestroyBuffer(MOCK_DEVICE, instances.buffer, nullptr);
+		culling.Destroy();
+		allocator.Destroy();
+	}
+
+	// Records the culling of the slot and returns the constants it pushed
+	CullingConstants Cull(uint32_t slot, uint32_t* groupCount = nullptr)
+	{
+		VkCommandBuffer commandBuffer = CreateMockCommandBuffer();
+		culling.Cull(commandBuffer, slot);
+
+		CullingConstants constants{};
+		for (const MockCommand& command : GetMockCommandBuffer(commandBuffer).commands)
+		{
+			if (command.type == MockCommandType::PushConstants)
+			{
+				CHECK(command.stages == VK_SHADER_STAGE_COMPUTE_BIT);
+				CHECK_EQUAL(sizeof(CullingConstants), command.data.size());
+				std::memcpy(&constants, command.data.data(), sizeof(constants));
+			}
+			else if (command.type == MockCommandType::Dispatch && groupCount != nullptr)
+				*groupCount = command.counts[0];
+		}
+
+		return constants;
+	}
+} CullingFixture;
+
+TEST(CullingPass, PushesTheObjects)
+{
+	CullingFixture fixture(1000);
+	fixture.culling.SetObjects(fixture.instances, 130, 36, 0.5f);
+
+	uint32_t groupCount = 0;
+	CullingConstants constants = fixture.Cull(1, &groupCount);
+
+	CHECK_EQUAL(130u, constants.objectCount);
+	CHECK_EQUAL(130u, constants.maxDrawCount);
+	CHECK_EQUAL(36u, constants.indexCount);
+	CHECK_EQUAL(0.5f, constants.meshRadius);
+
+	// A group of 64 invocations per started 64 objects
+	CHECK_EQUAL(3u, groupCount);
+}
+
+TEST(CullingPass, ClampsTheDrawsToTheDeviceLimit)
+{
+	CullingFixture fixture(100);
+	fixture.culling.SetObjects(fixture.instances, 500, 3, 1.0f);
+
+	CHECK_EQUAL(100u, fixture.Cull(0).maxDrawCount);
+
+	VkCommandBuffer commandBuffer = CreateMockCommandBuffer();
+	fixture.culling.Draw(commandBuffer, 2);
+
+	const MockCommand& draw = GetMockCommandBuffer(commandBuffer).commands.at(0);
+	CHECK(draw.type == MockCommandType::DrawIndexedIndirectCount);
+	CHECK(draw.buffer == fixture.culling.GetDrawBuffer(2));
+	CHECK(draw.countBuffer == fixture.culling.GetCountBuffer(2));
+	CHECK_EQUAL(100u, draw.counts[0]);
+	CHECK_EQUAL(sizeof(VkDrawIndexedIndirectCommand), draw.counts[1]);
+}
+
+TEST(CullingPass, GivesEverySlotItsOwnBuffers)
+{
+	CullingFixture fixture(1000);
+	fixture.culling.SetObjects(fixture.instances, 10, 3, 1.0f);
+
+	MockDevice& device = GetMockDevice();
+
+	for (uint32_t slot = 0; slot < CullingPass::MAX_SLOTS; slot++)
+	{
+		VkCommandBuffer commandBuffer = CreateMockCommandBuffer();
+		fixture.culling.ClearCount(commandBuffer, slot);
+		fixture.culling.Cull(commandBuffer, slot);
+
+		const std::vector<MockCommand>& commands = GetMockCommandBuffer(commandBuffer).commands;
+		CHECK(commands.at(0).type == MockCommandType::FillBuffer);
+		CHECK(commands.at(0).buffer == fixture.culling.GetCountBuffer(slot));
+
+		// The bound set points at the instances and at the buffers of the slot
+		VkDescriptorSet set = commands.at(2).descriptorSet;
+		const std::map<uint32_t, VkBuffer>& bindings = device.descriptorSets.at(set);
+		CHECK(bindings.at(0) == fixture.instances.buffer);
+		CHECK(bindings.at(1) == fixture.culling.GetDrawBuffer(slot));
+		CHECK(bindings.at(2) == fixture.culling.GetCountBuffer(slot));
+
+		for (uint32_t other = 0; other < slot; other++)
+			CHECK(fixture.culling.GetDrawBuffer(other) != fixture.culling.GetDrawBuffer(slot));
+	}
+
+	// The draw buffers are only replaced when the objects outgrow them
+	VkBuffer drawBuffer = fixture.culling.GetDrawBuffer(0);
+	fixture.culling.SetObjects(fixture.instances, 5, 3, 1.0f);
+	CHECK(fixture.culling.GetDrawBuffer(0) == drawBuffer);
+	fixture.culling.SetObjects(fixture.instances, 5000, 3, 1.0f);
+	CHECK(fixture.culling.GetDrawBuffer(0) != drawBuffer);
+}
+
+TEST(CullingPass, DestroysEverything)
+{
+	{
+		CullingFixture fixture(1000);
+		fixture.culling.SetObjects(fixture.instances, 10, 3, 1.0f);
+	}
+
+	MockDevice& device = GetMockDevice();
+	CHECK_EQUAL(0u, device.objectCount);
+	CHECK(device.buffers.empty());
+	CHECK(device.memories.empty());
+}
+
+TEST(CullingPass, CullsAgainstTheClipSquare)
+{
+	CullingFixture fixture(1000);
+	fixture.culling.SetObjects(fixture.instances, 1, 3, 0.5f);
+	CullingConstants constants = fixture.Cull(0);
+
+	// Bounding circles of radius 0.5 * scale
+	CHECK(IsVisible(constants, MakeInstance(0.0f, 0.0f, 1.0f)));
+	CHECK(IsVisible(constants, MakeInstance(-0.9f, 0.9f, 0.1f)));
+
+	// Outside of one plane, but overlapping the square
+	CHECK(IsVisible(constants, MakeInstance(1.4f, 0.0f, 1.0f)));
+	CHECK(IsVisible(constants, MakeInstance(0.0f, -1.4f, 1.0f)));
+
+	// Entirely beyond each of the planes
+	CHECK(!IsVisible(constants, MakeInstance(1.6f, 0.0f, 1.0f)));
+	CHECK(!IsVisible(constants, MakeInstance(-1.6f, 0.0f, 1.0f)));
+	CHECK(!IsVisible(constants, MakeInstance(0.0f, 1.6f, 1.0f)));
+	CHECK(!IsVisible(constants, MakeInstance(0.0f, -1.6f, 1.0f)));
+
+	// The scale grows the circle
+	CHECK(IsVisible(constants, MakeInstance(1.6f, 0.0f, 2.0f)));
+
+	// The planes are tested one by one, a circle off the corner but within reach of both planes is kept
+	CHECK(IsVisible(constants, MakeInstance(1.4f, 1.4f, 1.0f)));
+	CHECK(!IsVisible(constants, MakeInstance(1.4f, 1.6f, 1.0f)));
+}
+
+TEST(CullingPass, MatchesTheShader)
+{
+	std::ifstream file(TRIANGLE_SHADER_DIR "/cull.comp");
+	CHECK(file.is_open());
+
+	std::stringstream source;
+	source << file.rdbuf();
+
+	// The dispatch and the instance layout of the C++ side
+	CHECK(source.str().find("local_size_x = " + std::to_string(CullingPass::WORKGROUP_SIZE) + ")") != std::string::npos);
+	CHECK(source.str().find("INSTANCE_STRIDE = " + std::to_string(sizeof(Instance) / sizeof(float)) + ";") != std::string::npos);
+}
@@ -0,0 +1,268 @@
+#include "TestFramework.h"
+#include "MockVulkan.h"
+#include "../DeviceAllocator.h"
+
+static VkMemoryRequirements MakeRequirements(VkDeviceSize size, VkDeviceSize alignment = 256)
+{
+	VkMemoryRequirements requirements{};
+	requirements.size = size;
+	requirements.alignment = alignment;
+	requirements.memoryTypeBits = ~0u;
+	return requirements;
+}
+
+TEST(DeviceAllocator, SubAllocatesOneBlock)
+{
+	MockDevice& device = ResetMockDevice();
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	DeviceAllocation a = allocator.Allocate(MakeRequirements(1024), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+	DeviceAllocation b = allocator.Allocate(MakeRequirements(4096, 4096), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+
+	CHECK_EQUAL(1u, device.allocateCount);
+	CHECK_EQUAL(DeviceAllocator::DEFAULT_BLOCK_SIZE, device.memories.at(a.memory).size);
+	CHECK(a.memory == b.memory);
+	CHECK(a.block == b.block);
+	CHECK(a.offset != b.offset);
+	CHECK_EQUAL(0u, b.offset % 4096);
+	CHECK(a.mapped == nullptr);
+
+	allocator.Free(a);
+	allocator.Free(b);
+	allocator.Destroy();
+	CHECK(device.memories.empty());
+}
+
+TEST(DeviceAllocator, ReusesTheEmptyBlock)
+{
+	MockDevice& device = ResetMockDevice();
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	// The only block of its pool stays allocated while it's empty, recreating a resource doesn't reallocate it
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		DeviceAllocation allocation = allocator.Allocate(MakeRequirements(1 << 20), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+		allocator.Free(allocation);
+	}
+
+	CHECK_EQUAL(1u, device.allocateCount);
+	CHECK_EQUAL(0u, device.freeCount);
+	CHECK_EQUAL(1u, allocator.GetHeapStats(0).blockCount);
+
+	allocator.Destroy();
+	CHECK_EQUAL(1u, device.freeCount);
+}
+
+TEST(DeviceAllocator, FreesAnEmptyBlockThatIsntTheLast)
+{
+	MockDevice& device = ResetMockDevice();
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	// Two halves fill the first block, the third allocation needs a second one
+	VkMemoryRequirements half = MakeRequirements(DeviceAllocator::DEFAULT_BLOCK_SIZE / 2);
+	DeviceAllocation a = allocator.Allocate(half, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+	DeviceAllocation b = allocator.Allocate(half, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+	DeviceAllocation c = allocator.Allocate(half, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+
+	CHECK(a.block != nullptr && a.block == b.block);
+	CHECK(c.block != a.block);
+	CHECK_EQUAL(2u, device.allocateCount);
+	CHECK_EQUAL(2u, allocator.GetHeapStats(0).blockCount);
+
+	allocator.Free(c);
+	CHECK_EQUAL(1u, device.freeCount);
+	CHECK_EQUAL(0u, device.memories.count(c.memory));
+	CHECK_EQUAL(1u, allocator.GetHeapStats(0).blockCount);
+
+	// The remaining block is kept once it's empty
+	allocator.Free(a);
+	allocator.Free(b);
+	CHECK_EQUAL(1u, device.freeCount);
+
+	allocator.Destroy();
+}
+
+TEST(DeviceAllocator, CapsTheBlockSizeOfASmallHeap)
+{
+	MockDevice& device = ResetMockDevice();
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	// The device local and host visible heap only has 256 MiB, its blocks take an eighth of it
+	DeviceAllocation allocation = allocator.Allocate(MakeRequirements(1024), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+													 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, ResourceTiling::Linear);
+
+	CHECK_EQUAL(2u, allocation.memoryType);
+	CHECK_EQUAL(MOCK_SHARED_HEAP_SIZE / 8, device.memories.at(allocation.memory).size);
+	CHECK(allocation.mapped == device.memories.at(allocation.memory).data.data() + allocation.offset);
+
+	DeviceAllocator::HeapStats stats = allocator.GetHeapStats(2);
+	CHECK_EQUAL(1u, stats.blockCount);
+	CHECK_EQUAL(MOCK_SHARED_HEAP_SIZE / 8, stats.blockBytes);
+
+	allocator.Free(allocation);
+	allocator.Destroy();
+}
+
+TEST(DeviceAllocator, GivesLargeResourcesADedicatedAllocation)
+{
+	MockDevice& device = ResetMockDevice();
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	// Up to half a block is sub-allocated, anything larger gets its own memory
+	VkDeviceSize blockSize = MOCK_SHARED_HEAP_SIZE / 8;
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+	DeviceAllocation half = allocator.Allocate(MakeRequirements(blockSize / 2), properties, ResourceTiling::Linear);
+	DeviceAllocation large = allocator.Allocate(MakeRequirements(blockSize / 2 + 256), properties, ResourceTiling::Linear);
+	DeviceAllocation forced = allocator.Allocate(MakeRequirements(1024), properties, ResourceTiling::Linear, true);
+
+	CHECK(half.block != nullptr);
+	CHECK(large.block == nullptr);
+	CHECK(forced.block == nullptr);
+	CHECK_EQUAL(blockSize / 2 + 256, device.memories.at(large.memory).size);
+	CHECK_EQUAL(1024u, device.memories.at(forced.memory).size);
+	CHECK(large.mapped == device.memories.at(large.memory).data.data());
+
+	DeviceAllocator::HeapStats stats = allocator.GetHeapStats(2);
+	CHECK_EQUAL(2u, stats.dedicatedCount);
+	CHECK_EQUAL(blockSize / 2 + 256 + 1024, stats.dedicatedBytes);
+
+	allocator.Free(large);
+	allocator.Free(forced);
+	CHECK_EQUAL(0u, device.memories.count(large.memory));
+	CHECK_EQUAL(0u, allocator.GetHeapStats(2).dedicatedCount);
+
+	allocator.Free(half);
+	allocator.Destroy();
+}
+
+TEST(DeviceAllocator, FollowsTheDriverPreferenceForDedicatedMemory)
+{
+	MockDevice& device = ResetMockDevice();
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = 4096;
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	VkBuffer small;
+	vkCreateBuffer(MOCK_DEVICE, &bufferInfo, nullptr, &small);
+
+	device.prefersDedicated = true;
+	VkBuffer preferred;
+	vkCreateBuffer(MOCK_DEVICE, &bufferInfo, nullptr, &preferred);
+
+	DeviceAllocation smallAllocation = allocator.AllocateBuffer(small, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	DeviceAllocation preferredAllocation = allocator.AllocateBuffer(preferred, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	CHECK(smallAllocation.block != nullptr);
+	CHECK(device.buffers.at(small).memory == smallAllocation.memory);
+	CHECK(preferredAllocation.block == nullptr);
+	CHECK(device.buffers.at(preferred).memory == preferredAllocation.memory);
+	CHECK(device.memories.at(preferredAllocation.memory).dedicatedBuffer == preferred);
+
+	allocator.Free(smallAllocation);
+	allocator.Free(preferredAllocation);
+	allocator.Destroy();
+}
+
+TEST(DeviceAllocator, KeepsLinearAndOptimalResourcesApart)
+{
+	MockDevice& device = ResetMockDevice();
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	DeviceAllocation buffer = allocator.Allocate(MakeRequirements(1024), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+	DeviceAllocation image = allocator.Allocate(MakeRequirements(1024), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Optimal);
+	DeviceAllocation secondBuffer = allocator.Allocate(MakeRequirements(1024), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+	DeviceAllocation secondImage = allocator.Allocate(MakeRequirements(1024), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Optimal);
+
+	// Same memory type, but never the same block
+	CHECK_EQUAL(buffer.memoryType, image.memoryType);
+	CHECK(buffer.memory != image.memory);
+	CHECK(buffer.memory == secondBuffer.memory);
+	CHECK(image.memory == secondImage.memory);
+	CHECK_EQUAL(2u, device.allocateCount);
+
+	allocator.Free(buffer);
+	allocator.Free(image);
+	allocator.Free(secondBuffer);
+	allocator.Free(secondImage);
+	allocator.Destroy();
+}
+
+TEST(DeviceAllocator, CountsEveryHeapApart)
+{
+	ResetMockDevice();
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	DeviceAllocation local = allocator.Allocate(MakeRequirements(1000), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+	DeviceAllocation second = allocator.Allocate(MakeRequirements(300), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Optimal);
+	DeviceAllocation host = allocator.Allocate(MakeRequirements(256), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+											   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ResourceTiling::Linear);
+
+	// The allocated bytes are rounded up to the buddy blocks
+	DeviceAllocator::HeapStats localStats = allocator.GetHeapStats(0);
+	CHECK_EQUAL(2u, localStats.blockCount);
+	CHECK_EQUAL(2 * DeviceAllocator::DEFAULT_BLOCK_SIZE, localStats.blockBytes);
+	CHECK_EQUAL(2u, localStats.allocationCount);
+	CHECK_EQUAL(1024u + 512u, localStats.allocatedBytes);
+	CHECK_EQUAL(0u, localStats.dedicatedCount);
+
+	DeviceAllocator::HeapStats hostStats = allocator.GetHeapStats(1);
+	CHECK_EQUAL(1u, hostStats.blockCount);
+	CHECK_EQUAL(1u, hostStats.allocationCount);
+	CHECK_EQUAL(256u, hostStats.allocatedBytes);
+	CHECK(host.mapped != nullptr);
+
+	CHECK_EQUAL(0u, allocator.GetHeapStats(2).blockCount);
+
+	allocator.Free(local);
+	allocator.Free(second);
+	allocator.Free(host);
+
+	localStats = allocator.GetHeapStats(0);
+	CHECK_EQUAL(0u, localStats.allocationCount);
+	CHECK_EQUAL(0u, localStats.allocatedBytes);
+	CHECK_EQUAL(0u, allocator.GetHeapStats(1).allocationCount);
+
+	allocator.Destroy();
+}
+
+TEST(DeviceAllocator, ThrowsWhenTheHeapIsExhausted)
+{
+	MockDevice& device = ResetMockDevice();
+	device.memoryProperties.memoryHeaps[0].size = 8ull << 20;
+
+	DeviceAllocator allocator;
+	allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+
+	// 1 MiB blocks on the 8 MiB heap, a dedicated allocation over the whole heap doesn't fit
+	DeviceAllocation allocation = allocator.Allocate(MakeRequirements(1024), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear);
+	CHECK_EQUAL(1ull << 20, device.memories.at(allocation.memory).size);
+	CHECK_THROWS(allocator.Allocate(MakeRequirements(8ull << 20), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear));
+
+	// None of the allowed memory types has the properties
+	VkMemoryRequirements hostOnly = MakeRequirements(1024);
+	hostOnly.memoryTypeBits = 1u << 1;
+	CHECK_THROWS(allocator.Allocate(hostOnly, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceTiling::Linear));
+
+	allocator.Free(allocation);
+	allocator.Destroy();
+}
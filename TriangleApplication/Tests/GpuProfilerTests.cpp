@@ -0,0 +1,119 @@
+#include "TestFramework.h"
+#include "MockVulkan.h"
+#include "../GpuProfiler.h"
+
+#include <vector>
+
+// A profiler on the graphics family of the mock device, whose timestamps are one nanosecond ticks
+typedef struct ProfilerFixture_t {
+	GpuProfiler profiler;
+
+	ProfilerFixture_t()
+	{
+		ResetMockDevice();
+		profiler.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE, 0);
+	}
+
+	~ProfilerFixture_t()
+	{
+		profiler.Destroy();
+	}
+
+	// Records a frame with a single scope into the slot
+	VkCommandBuffer RecordFrame(uint32_t slot, uint64_t frameNumber)
+	{
+		VkCommandBuffer commandBuffer = CreateMockCommandBuffer();
+
+		profiler.BeginFrame(commandBuffer, slot, frameNumber);
+		{
+			GpuScope scope(profiler, commandBuffer, "Pass");
+		}
+		profiler.EndFrame(commandBuffer);
+
+		return commandBuffer;
+	}
+
+	// What the GPU writes into the queries when it executes the frame's command buffer
+	void WriteTimestamps(VkCommandBuffer commandBuffer, uint64_t begin, uint64_t frameTicks)
+	{
+		for (const MockCommand& command : GetMockCommandBuffer(commandBuffer).commands)
+		{
+			if (command.type != MockCommandType::WriteTimestamp)
+				continue;
+
+			// The end of the frame comes last
+			uint32_t query = command.counts[0];
+			GetMockDevice().queryPools.at(command.queryPool)[query] = query == 1 ? begin + frameTicks : begin + query;
+		}
+	}
+} ProfilerFixture;
+
+TEST(GpuProfiler, CollectsTheRecordedFrame)
+{
+	ProfilerFixture fixture;
+	GpuProfiler& profiler = fixture.profiler;
+	CHECK(profiler.IsSupported());
+
+	VkCommandBuffer commandBuffer = fixture.RecordFrame(1, 7);
+
+	// The queries are reset before they're written, so every submission of the command buffer writes them anew
+	const std::vector<MockCommand>& commands = GetMockCommandBuffer(commandBuffer).commands;
+	CHECK_EQUAL(5u, commands.size());
+	CHECK(commands[0].type == MockCommandType::ResetQueryPool);
+	CHECK_EQUAL(0u, commands[0].counts[0]);
+	CHECK_EQUAL(GpuProfiler::MAX_SCOPES * 2, commands[0].counts[1]);
+
+	for (size_t i = 1; i < commands.size(); i++)
+	{
+		CHECK(commands[i].type == MockCommandType::WriteTimestamp);
+		CHECK(commands[i].queryPool == commands[0].queryPool);
+	}
+
+	fixture.WriteTimestamps(commandBuffer, 1000, 2'000'000);
+
+	// Only the recorded slot has a frame to read
+	CHECK(!profiler.Collect(0));
+	CHECK(profiler.Collect(1));
+	CHECK_EQUAL(7u, profiler.GetCollectedFrame());
+	CHECK_EQUAL(2.0, profiler.GetFrameTime());
+	CHECK_EQUAL(1000u, profiler.GetFrameBeginTicks());
+
+	// Read once
+	CHECK(!profiler.Collect(1));
+}
+
+TEST(GpuProfiler, ReplayFrameRearmsTheSlot)
+{
+	ProfilerFixture fixture;
+	GpuProfiler& profiler = fixture.profiler;
+
+	VkCommandBuffer commandBuffer = fixture.RecordFrame(2, 7);
+	fixture.WriteTimestamps(commandBuffer, 1000, 2'000'000);
+	CHECK(profiler.Collect(2));
+
+	// The cached command buffer is submitted again for frame 11 and writes the same queries
+	profiler.ReplayFrame(2, 11);
+	fixture.WriteTimestamps(commandBuffer, 5000, 3'000'000);
+
+	CHECK(profiler.Collect(2));
+	CHECK_EQUAL(11u, profiler.GetCollectedFrame());
+	CHECK_EQUAL(3.0, profiler.GetFrameTime());
+	CHECK_EQUAL(5000u, profiler.GetFrameBeginTicks());
+	CHECK(!profiler.Collect(2));
+
+	// The other slots stay as they are
+	CHECK(!profiler.Collect(0));
+}
+
+TEST(GpuProfiler, ReplaysNothingWithoutARecordedFrame)
+{
+	ProfilerFixture fixture;
+
+	fixture.profiler.ReplayFrame(3, 5);
+	CHECK(!fixture.profiler.Collect(3));
+
+	// Without timestamp support nothing is recorded, so nothing is replayed either
+	GpuProfiler unsupported;
+	unsupported.ReplayFrame(0, 5);
+	CHECK(!unsupported.Collect(0));
+}
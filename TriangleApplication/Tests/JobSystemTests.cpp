@@ -0,0 +1,248 @@
+#include "TestFramework.h"
+#include "../JobSystem.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Counts the runs of every job index, so a job that's lost or run twice shows up
+typedef struct JobRecord_t {
+	std::unique_ptr<std::atomic<uint32_t>[]> runs;
+	uint32_t count = 0;
+
+	JobRecord_t(uint32_t jobCount)
+		: runs(new std::atomic<uint32_t>[jobCount]), count(jobCount)
+	{
+		for (uint32_t i = 0; i < count; i++)
+			runs[i].store(0, std::memory_order_relaxed);
+	}
+
+	uint32_t GetRunCount() const noexcept
+	{
+		uint32_t total = 0;
+		for (uint32_t i = 0; i < count; i++)
+			total += runs[i].load(std::memory_order_relaxed);
+
+		return total;
+	}
+
+	bool RanEveryJobOnce() const noexcept
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (runs[i].load(std::memory_order_relaxed) != 1)
+				return false;
+		}
+
+		return true;
+	}
+} JobRecord;
+
+static void RecordJob(void* context, uint32_t index)
+{
+	static_cast<JobRecord*>(context)->runs[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+TEST(JobSystem, RunsEveryJobOnce)
+{
+	for (uint32_t workerCount : { 0u, 1u, 4u, JobSystem::MAX_WORKERS })
+	{
+		JobSystem jobs;
+		jobs.Init(workerCount);
+		CHECK_EQUAL(workerCount, jobs.GetWorkerCount());
+
+		JobRecord record(1000);
+		JobCounter counter;
+		jobs.Run(&RecordJob, &record, record.count, counter);
+		jobs.Wait(counter);
+
+		CHECK_EQUAL(0u, counter.value.load());
+		CHECK(record.RanEveryJobOnce());
+
+		jobs.Destroy();
+		CHECK(!jobs.IsInitialized());
+	}
+}
+
+TEST(JobSystem, WaitRunsTheJobsWithoutWorkers)
+{
+	JobSystem jobs;
+	jobs.Init(0);
+
+	typedef struct Context_t {
+		std::thread::id threads[8];
+	} Context;
+
+	Context context;
+	JobCounter counter;
+	jobs.Run([](void* context, uint32_t index) { static_cast<Context*>(context)->threads[index] = std::this_thread::get_id(); },
+			 &context, 8, counter);
+
+	// Nobody runs them until the thread waits
+	CHECK_EQUAL(8u, counter.value.load());
+
+	jobs.Wait(counter);
+
+	for (const std::thread::id& thread : context.threads)
+		CHECK(thread == std::this_thread::get_id());
+
+	jobs.Destroy();
+}
+
+TEST(JobSystem, HelpsWhenEveryJobSlotIsTaken)
+{
+	JobSystem jobs;
+	jobs.Init(0);
+
+	// More jobs in one batch than a thread has slots: once the ring is full, the submitting thread runs
+	// the newest queued job to release a slot, so it never has more than QUEUE_CAPACITY jobs outstanding
+	JobRecord record(3 * JobSystem::QUEUE_CAPACITY + 7);
+	JobCounter counter;
+	jobs.Run(&RecordJob, &record, record.count, counter);
+
+	CHECK_EQUAL(record.count - JobSystem::QUEUE_CAPACITY, record.GetRunCount());
+	CHECK_EQUAL(JobSystem::QUEUE_CAPACITY, counter.value.load());
+
+	jobs.Wait(counter);
+	CHECK(record.RanEveryJobOnce());
+
+	jobs.Destroy();
+}
+
+TEST(JobSystem, ReusesTheJobSlotsAcrossBatches)
+{
+	JobSystem jobs;
+	jobs.Init(4);
+
+	// Several batches in flight at once, together many times the slots of a thread
+	constexpr uint32_t BATCH_COUNT = 500;
+	constexpr uint32_t IN_FLIGHT = 4;
+
+	std::vector<std::unique_ptr<JobRecord>> records;
+	JobCounter counters[IN_FLIGHT];
+
+	for (uint32_t batch = 0; batch < BATCH_COUNT; batch++)
+	{
+		JobCounter& counter = counters[batch % IN_FLIGHT];
+		if (batch >= IN_FLIGHT)
+			jobs.Wait(counter);
+
+		records.push_back(std::make_unique<JobRecord>(1 + batch * 37 % 300));
+		jobs.Run(&RecordJob, records.back().get(), records.back()->count, counter);
+	}
+
+	for (JobCounter& counter : counters)
+		jobs.Wait(counter);
+
+	for (const auto& record : records)
+		CHECK(record->RanEveryJobOnce());
+
+	jobs.Destroy();
+}
+
+// An outer job submits a batch of inner jobs and waits for them
+typedef struct NestedContext_t {
+	JobSystem* jobs = nullptr;
+	uint32_t depth = 0;     // Levels of batches below the outer one
+	uint32_t fanOut = 0;
+	std::atomic<uint32_t> leaves{ 0 };
+	std::atomic<uint32_t> incomplete{ 0 }; // Waits that returned before their batch was done
+} NestedContext;
+
+static void RunNested(NestedContext& context, uint32_t depth)
+{
+	typedef struct Batch_t {
+		NestedContext* context;
+		uint32_t depth;
+		std::atomic<uint32_t> finished{ 0 };
+	} Batch;
+
+	if (depth == 0)
+	{
+		context.leaves.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Batch batch{ &context, depth - 1 };
+	JobCounter counter;
+	context.jobs->Run([](void* data, uint32_t index)
+	{
+		Batch& batch = *static_cast<Batch*>(data);
+		RunNested(*batch.context, batch.depth);
+		batch.finished.fetch_add(1, std::memory_order_relaxed);
+	}, &batch, context.fanOut, counter);
+	context.jobs->Wait(counter);
+
+	if (batch.finished.load(std::memory_order_relaxed) != context.fanOut)
+		context.incomplete.fetch_add(1, std::memory_order_relaxed);
+}
+
+TEST(JobSystem, RunsNestedBatches)
+{
+	for (uint32_t workerCount : { 0u, 3u })
+	{
+		JobSystem jobs;
+		jobs.Init(workerCount);
+
+		NestedContext context;
+		context.jobs = &jobs;
+		context.fanOut = 6;
+
+		// 6^4 leaves, every job of the inner levels waits on its own batch
+		RunNested(context, 4);
+
+		CHECK_EQUAL(6u * 6u * 6u * 6u, context.leaves.load());
+		CHECK_EQUAL(0u, context.incomplete.load());
+
+		jobs.Destroy();
+	}
+}
+
+TEST(JobSystem, SurvivesContention)
+{
+	JobSystem jobs;
+	jobs.Init(JobSystem::MAX_WORKERS);
+
+	// Tiny jobs, so the owners pop and the thieves steal the last jobs of the queues at the same time
+	for (uint32_t round = 0; round < 200; round++)
+	{
+		JobRecord record(1 + round * 13 % 2000);
+		JobCounter counter;
+		jobs.Run(&RecordJob, &record, record.count, counter);
+		jobs.Wait(counter);
+
+		CHECK(record.RanEveryJobOnce());
+	}
+
+	// The jobs themselves submit, so every queue has an owner pushing and popping
+	NestedContext context;
+	context.jobs = &jobs;
+	context.fanOut = 16;
+
+	for (uint32_t round = 0; round < 20; round++)
+		RunNested(context, 3);
+
+	CHECK_EQUAL(20u * 16u * 16u * 16u, context.leaves.load());
+	CHECK_EQUAL(0u, context.incomplete.load());
+
+	jobs.Destroy();
+}
+
+TEST(JobSystem, RestartsAfterDestroy)
+{
+	JobSystem jobs;
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		jobs.Init(2);
+
+		JobRecord record(100);
+		JobCounter counter;
+		jobs.Run(&RecordJob, &record, record.count, counter);
+		jobs.Wait(counter);
+		CHECK(record.RanEveryJobOnce());
+
+		jobs.Destroy();
+	}
+}
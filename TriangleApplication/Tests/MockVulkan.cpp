@@ -0,0 +1,780 @@
+#include "MockVulkan.h"
+#include "../AllocationTracker.h"
+
+#include <algorithm>
+
+static MockDevice s_Device;
+static uint64_t s_NextHandle = 0x1000;
+
+// Only compared, never dereferenced
+const VkPhysicalDevice MOCK_PHYSICAL_DEVICE = reinterpret_cast<VkPhysicalDevice>(uintptr_t(0x10));
+const VkDevice MOCK_DEVICE = reinterpret_cast<VkDevice>(uintptr_t(0x20));
+
+// The non-dispatchable handles are pointers on 64-bit platforms and integers otherwise
+template<typename Handle>
+static Handle CreateHandle() noexcept
+{
+	return (Handle)(uintptr_t)s_NextHandle++;
+}
+
+template<typename Info>
+static const Info* FindInfo(const void* next, VkStructureType type) noexcept
+{
+	for (auto info = static_cast<const VkBaseInStructure*>(next); info != nullptr; info = info->pNext)
+	{
+		if (info->sType == type)
+			return reinterpret_cast<const Info*>(info);
+	}
+
+	return nullptr;
+}
+
+MockDevice& ResetMockDevice()
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	s_Device.memoryProperties = {};
+	s_Device.memoryProperties.memoryTypeCount = 3;
+	s_Device.memoryProperties.memoryTypes[0] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+	s_Device.memoryProperties.memoryTypes[1] = { VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1 };
+	s_Device.memoryProperties.memoryTypes[2] = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+												 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 2 };
+	s_Device.memoryProperties.memoryHeapCount = 3;
+	s_Device.memoryProperties.memoryHeaps[0] = { MOCK_DEVICE_HEAP_SIZE, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+	s_Device.memoryProperties.memoryHeaps[1] = { MOCK_DEVICE_HEAP_SIZE, 0 };
+	s_Device.memoryProperties.memoryHeaps[2] = { MOCK_SHARED_HEAP_SIZE, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+
+	s_Device.alignment = 256;
+	s_Device.memoryTypeBits = ~0u;
+	s_Device.prefersDedicated = false;
+
+	s_Device.properties = {};
+	s_Device.properties.limits.timestampPeriod = 1.0f;
+	s_Device.queueFamilies.assign(2, VkQueueFamilyProperties{});
+	s_Device.queueFamilies[0].queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+	s_Device.queueFamilies[1].queueFlags = VK_QUEUE_TRANSFER_BIT;
+
+	for (auto& queueFamily : s_Device.queueFamilies)
+	{
+		queueFamily.queueCount = 1;
+		queueFamily.timestampValidBits = 64;
+	}
+
+	s_Device.allocateCount = 0;
+	s_Device.freeCount = 0;
+	s_Device.memories.clear();
+	s_Device.buffers.clear();
+	s_Device.images.clear();
+
+	s_Device.objectCount = 0;
+	s_Device.descriptorSets.clear();
+	s_Device.commandBuffers.clear();
+	s_Device.commandPools.clear();
+	s_Device.commandPoolCount = 0;
+	s_Device.queryPools.clear();
+	s_Device.semaphores.clear();
+	s_Device.submits.clear();
+	s_Device.waitCount = 0;
+
+	return s_Device;
+}
+
+MockDevice& GetMockDevice()
+{
+	return s_Device;
+}
+
+VkCommandBuffer CreateMockCommandBuffer()
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	s_Device.commandBuffers.push_back(std::make_unique<MockCommandBuffer>());
+	return reinterpret_cast<VkCommandBuffer>(s_Device.commandBuffers.back().get());
+}
+
+MockCommandBuffer& GetMockCommandBuffer(VkCommandBuffer commandBuffer) noexcept
+{
+	return *reinterpret_cast<MockCommandBuffer*>(commandBuffer);
+}
+
+MockCommandPool& GetMockCommandPool(VkCommandPool commandPool) noexcept
+{
+	return *reinterpret_cast<MockCommandPool*>((uintptr_t)commandPool);
+}
+
+template<typename Handle>
+static Handle CreateObject() noexcept
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	s_Device.objectCount++;
+	return CreateHandle<Handle>();
+}
+
+template<typename Handle>
+static void DestroyObject(Handle handle) noexcept
+{
+	if (handle == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	s_Device.objectCount--;
+}
+
+// The recording takes driver memory, not the memory of the frame the tracker checks
+static MockCommand& AddCommand(VkCommandBuffer commandBuffer, MockCommandType type)
+{
+	ALLOW_FRAME_ALLOCATIONS();
+
+	MockCommand command;
+	command.type = type;
+
+	std::vector<MockCommand>& commands = GetMockCommandBuffer(commandBuffer).commands;
+	commands.push_back(std::move(command));
+	return commands.back();
+}
+
+static VkMemoryRequirements GetRequirements(VkDeviceSize size) noexcept
+{
+	VkMemoryRequirements requirements{};
+	requirements.size = (size + s_Device.alignment - 1) / s_Device.alignment * s_Device.alignment;
+	requirements.alignment = s_Device.alignment;
+	requirements.memoryTypeBits = s_Device.memoryTypeBits;
+	return requirements;
+}
+
+static void GetDedicatedRequirements(const MockResource& resource, VkMemoryRequirements2* pMemoryRequirements) noexcept
+{
+	pMemoryRequirements->memoryRequirements = resource.requirements;
+
+	for (auto info = static_cast<VkBaseOutStructure*>(pMemoryRequirements->pNext); info != nullptr; info = info->pNext)
+	{
+		if (info->sType != VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS)
+			continue;
+
+		auto dedicated = reinterpret_cast<VkMemoryDedicatedRequirements*>(info);
+		dedicated->prefersDedicatedAllocation = resource.prefersDedicated ? VK_TRUE : VK_FALSE;
+		dedicated->requiresDedicatedAllocation = VK_FALSE;
+	}
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+	*pMemoryProperties = s_Device.memoryProperties;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice physicalDevice, VkPhysicalDeviceProperties* pProperties)
+{
+	*pProperties = s_Device.properties;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice physicalDevice, uint32_t* pQueueFamilyPropertyCount,
+																	VkQueueFamilyProperties* pQueueFamilyProperties)
+{
+	if (pQueueFamilyProperties == nullptr)
+	{
+		*pQueueFamilyPropertyCount = static_cast<uint32_t>(s_Device.queueFamilies.size());
+		return;
+	}
+
+	*pQueueFamilyPropertyCount = std::min(*pQueueFamilyPropertyCount, static_cast<uint32_t>(s_Device.queueFamilies.size()));
+	std::copy_n(s_Device.queueFamilies.begin(), *pQueueFamilyPropertyCount, pQueueFamilyProperties);
+}
+
+// No extension is enabled on the mock device
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance instance, const char* pName)
+{
+	return nullptr;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice device, const char* pName)
+{
+	return nullptr;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice device, const VkMemoryAllocateInfo* pAllocateInfo,
+												const VkAllocationCallbacks* pAllocator, VkDeviceMemory* pMemory)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	uint32_t heap = s_Device.memoryProperties.memoryTypes[pAllocateInfo->memoryTypeIndex].heapIndex;
+	VkDeviceSize heapUsed = 0;
+
+	for (auto& [handle, memory] : s_Device.memories)
+	{
+		if (s_Device.memoryProperties.memoryTypes[memory.memoryType].heapIndex == heap)
+			heapUsed += memory.size;
+	}
+
+	s_Device.allocateCount++;
+
+	if (heapUsed + pAllocateInfo->allocationSize > s_Device.memoryProperties.memoryHeaps[heap].size)
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	MockMemory memory;
+	memory.size = pAllocateInfo->allocationSize;
+	memory.memoryType = pAllocateInfo->memoryTypeIndex;
+
+	auto dedicatedInfo = FindInfo<VkMemoryDedicatedAllocateInfo>(pAllocateInfo->pNext, VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO);
+	if (dedicatedInfo != nullptr)
+	{
+		memory.dedicatedBuffer = dedicatedInfo->buffer;
+		memory.dedicatedImage = dedicatedInfo->image;
+	}
+
+	*pMemory = CreateHandle<VkDeviceMemory>();
+	s_Device.memories.emplace(*pMemory, std::move(memory));
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice device, VkDeviceMemory memory, const VkAllocationCallbacks* pAllocator)
+{
+	if (memory == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	s_Device.freeCount++;
+	s_Device.memories.erase(memory);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice device, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize size,
+										   VkMemoryMapFlags flags, void** ppData)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	MockMemory& mapped = s_Device.memories.at(memory);
+	if (!(s_Device.memoryProperties.memoryTypes[mapped.memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+		return VK_ERROR_MEMORY_MAP_FAILED;
+
+	mapped.data.resize(mapped.size);
+	*ppData = mapped.data.data() + offset;
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice device, VkDeviceMemory memory)
+{
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice device, const VkBufferCreateInfo* pCreateInfo,
+											  const VkAllocationCallbacks* pAllocator, VkBuffer* pBuffer)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	MockResource buffer;
+	buffer.requirements = GetRequirements(pCreateInfo->size);
+	buffer.prefersDedicated = s_Device.prefersDedicated;
+
+	if (pCreateInfo->sharingMode == VK_SHARING_MODE_CONCURRENT)
+		buffer.queueFamilies.assign(pCreateInfo->pQueueFamilyIndices, pCreateInfo->pQueueFamilyIndices + pCreateInfo->queueFamilyIndexCount);
+
+	*pBuffer = CreateHandle<VkBuffer>();
+	s_Device.buffers.emplace(*pBuffer, buffer);
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice device, VkBuffer buffer, const VkAllocationCallbacks* pAllocator)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	s_Device.buffers.erase(buffer);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice device, const VkImageCreateInfo* pCreateInfo,
+											 const VkAllocationCallbacks* pAllocator, VkImage* pImage)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	const VkExtent3D& extent = pCreateInfo->extent;
+
+	MockResource image;
+	image.requirements = GetRequirements(VkDeviceSize(extent.width) * extent.height * extent.depth * pCreateInfo->arrayLayers * 4);
+	image.prefersDedicated = s_Device.prefersDedicated;
+
+	*pImage = CreateHandle<VkImage>();
+	s_Device.images.emplace(*pImage, image);
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice device, VkImage image, const VkAllocationCallbacks* pAllocator)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	s_Device.images.erase(image);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(VkDevice device, const VkBufferMemoryRequirementsInfo2* pInfo,
+														  VkMemoryRequirements2* pMemoryRequirements)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	GetDedicatedRequirements(s_Device.buffers.at(pInfo->buffer), pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(VkDevice device, const VkImageMemoryRequirementsInfo2* pInfo,
+														 VkMemoryRequirements2* pMemoryRequirements)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	GetDedicatedRequirements(s_Device.images.at(pInfo->image), pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice device, VkImage image, VkMemoryRequirements* pMemoryRequirements)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	*pMemoryRequirements = s_Device.images.at(image).requirements;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice device, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	MockResource& bound = s_Device.buffers.at(buffer);
+	if (s_Device.memories.count(memory) == 0 || memoryOffset % bound.requirements.alignment != 0)
+		return VK_ERROR_UNKNOWN;
+
+	bound.memory = memory;
+	bound.offset = memoryOffset;
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice device, VkImage image, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	MockResource& bound = s_Device.images.at(image);
+	if (s_Device.memories.count(memory) == 0 || memoryOffset % bound.requirements.alignment != 0)
+		return VK_ERROR_UNKNOWN;
+
+	bound.memory = memory;
+	bound.offset = memoryOffset;
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice device, const VkDescriptorSetLayoutCreateInfo* pCreateInfo,
+														   const VkAllocationCallbacks* pAllocator, VkDescriptorSetLayout* pSetLayout)
+{
+	*pSetLayout = CreateObject<VkDescriptorSetLayout>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout,
+														const VkAllocationCallbacks* pAllocator)
+{
+	DestroyObject(descriptorSetLayout);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo* pCreateInfo,
+													  const VkAllocationCallbacks* pAllocator, VkDescriptorPool* pDescriptorPool)
+{
+	*pDescriptorPool = CreateObject<VkDescriptorPool>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, const VkAllocationCallbacks* pAllocator)
+{
+	DestroyObject(descriptorPool);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice device, const VkDescriptorSetAllocateInfo* pAllocateInfo,
+														VkDescriptorSet* pDescriptorSets)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	// Freed with their pool
+	for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; i++)
+	{
+		pDescriptorSets[i] = CreateHandle<VkDescriptorSet>();
+		s_Device.descriptorSets[pDescriptorSets[i]];
+	}
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice device, uint32_t descriptorWriteCount, const VkWriteDescriptorSet* pDescriptorWrites,
+												  uint32_t descriptorCopyCount, const VkCopyDescriptorSet* pDescriptorCopies)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	for (uint32_t i = 0; i < descriptorWriteCount; i++)
+	{
+		const VkWriteDescriptorSet& write = pDescriptorWrites[i];
+		s_Device.descriptorSets.at(write.dstSet)[write.dstBinding] = write.pBufferInfo != nullptr ? write.pBufferInfo->buffer : VK_NULL_HANDLE;
+	}
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(VkDevice device, const VkPipelineLayoutCreateInfo* pCreateInfo,
+													  const VkAllocationCallbacks* pAllocator, VkPipelineLayout* pPipelineLayout)
+{
+	*pPipelineLayout = CreateObject<VkPipelineLayout>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineLayout(VkDevice device, VkPipelineLayout pipelineLayout, const VkAllocationCallbacks* pAllocator)
+{
+	DestroyObject(pipelineLayout);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice device, const VkShaderModuleCreateInfo* pCreateInfo,
+													const VkAllocationCallbacks* pAllocator, VkShaderModule* pShaderModule)
+{
+	*pShaderModule = CreateObject<VkShaderModule>();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyShaderModule(VkDevice device, VkShaderModule shaderModule, const VkAllocationCallbacks* pAllocator)
+{
+	DestroyObject(shaderModule);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines(VkDevice device, VkPipelineCache pipelineCache, uint32_t createInfoCount,
+														const VkComputePipelineCreateInfo* pCreateInfos, const VkAllocationCallbacks* pAllocator,
+														VkPipeline* pPipelines)
+{
+	for (uint32_t i = 0; i < createInfoCount; i++)
+		pPipelines[i] = CreateObject<VkPipeline>();
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice device, VkPipeline pipeline, const VkAllocationCallbacks* pAllocator)
+{
+	DestroyObject(pipeline);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(VkDevice device, const VkQueryPoolCreateInfo* pCreateInfo,
+												 const VkAllocationCallbacks* pAllocator, VkQueryPool* pQueryPool)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	*pQueryPool = CreateHandle<VkQueryPool>();
+	s_Device.queryPools.emplace(*pQueryPool, std::vector<uint64_t>(pCreateInfo->queryCount));
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(VkDevice device, VkQueryPool queryPool, const VkAllocationCallbacks* pAllocator)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	s_Device.queryPools.erase(queryPool);
+}
+
+// Only the 64-bit results the profiler reads, without the availability
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(VkDevice device, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount,
+													 size_t dataSize, void* pData, VkDeviceSize stride, VkQueryResultFlags flags)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	const std::vector<uint64_t>& results = s_Device.queryPools.at(queryPool);
+	if ((flags & VK_QUERY_RESULT_64_BIT) == 0 || stride != sizeof(uint64_t) || firstQuery + queryCount > results.size())
+		return VK_ERROR_UNKNOWN;
+
+	std::copy_n(results.begin() + firstQuery, queryCount, static_cast<uint64_t*>(pData));
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice device, const VkCommandPoolCreateInfo* pCreateInfo,
+												   const VkAllocationCallbacks* pAllocator, VkCommandPool* pCommandPool)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	s_Device.commandPools.push_back(std::make_unique<MockCommandPool>());
+	s_Device.commandPools.back()->queueFamilyIndex = pCreateInfo->queueFamilyIndex;
+	s_Device.commandPoolCount++;
+
+	*pCommandPool = (VkCommandPool)(uintptr_t)s_Device.commandPools.back().get();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice device, VkCommandPool commandPool, const VkAllocationCallbacks* pAllocator)
+{
+	if (commandPool == VK_NULL_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	GetMockCommandPool(commandPool).destroyed = true;
+	s_Device.commandPoolCount--;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool(VkDevice device, VkCommandPool commandPool, VkCommandPoolResetFlags flags)
+{
+	for (MockCommandBuffer* commandBuffer : GetMockCommandPool(commandPool).commandBuffers)
+	{
+		commandBuffer->recording = false;
+		commandBuffer->commands.clear();
+	}
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandBuffer(VkCommandBuffer commandBuffer, VkCommandBufferResetFlags flags)
+{
+	MockCommandBuffer& recorded = GetMockCommandBuffer(commandBuffer);
+	recorded.recording = false;
+	recorded.commands.clear();
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice device, const VkCommandBufferAllocateInfo* pAllocateInfo,
+														VkCommandBuffer* pCommandBuffers)
+{
+	for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++)
+	{
+		pCommandBuffers[i] = CreateMockCommandBuffer();
+
+		MockCommandBuffer& commandBuffer = GetMockCommandBuffer(pCommandBuffers[i]);
+		commandBuffer.pool = pAllocateInfo->commandPool;
+		commandBuffer.level = pAllocateInfo->level;
+
+		std::lock_guard<std::mutex> lock(s_Device.mutex);
+		GetMockCommandPool(pAllocateInfo->commandPool).commandBuffers.push_back(&commandBuffer);
+	}
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo* pBeginInfo)
+{
+	MockCommandBuffer& recorded = GetMockCommandBuffer(commandBuffer);
+
+	// Beginning implicitly resets the command buffer
+	recorded.recording = true;
+	recorded.beginCount++;
+	recorded.usage = pBeginInfo->flags;
+	recorded.inheritance = pBeginInfo->pInheritanceInfo;
+	recorded.commands.clear();
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer commandBuffer)
+{
+	MockCommandBuffer& recorded = GetMockCommandBuffer(commandBuffer);
+
+	if (!recorded.recording)
+		return VK_ERROR_UNKNOWN;
+
+	recorded.recording = false;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdFillBuffer(VkCommandBuffer commandBuffer, VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size, uint32_t data)
+{
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::FillBuffer);
+	command.buffer = dstBuffer;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline)
+{
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::BindPipeline);
+	command.pipeline = pipeline;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer commandBuffer, VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout,
+												   uint32_t firstSet, uint32_t descriptorSetCount, const VkDescriptorSet* pDescriptorSets,
+												   uint32_t dynamicOffsetCount, const uint32_t* pDynamicOffsets)
+{
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::BindDescriptorSets);
+	command.descriptorSet = pDescriptorSets[0];
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants(VkCommandBuffer commandBuffer, VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+											  uint32_t offset, uint32_t size, const void* pValues)
+{
+	ALLOW_FRAME_ALLOCATIONS();
+
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::PushConstants);
+	command.stages = stageFlags;
+	command.data.assign(static_cast<const std::byte*>(pValues), static_cast<const std::byte*>(pValues) + size);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::Dispatch);
+	command.counts[0] = groupCountX;
+	command.counts[1] = groupCountY;
+	command.counts[2] = groupCountZ;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex,
+											int32_t vertexOffset, uint32_t firstInstance)
+{
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::DrawIndexed);
+	command.counts[0] = indexCount;
+	command.counts[1] = instanceCount;
+	command.counts[2] = firstInstance;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexedIndirectCount(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer,
+														 VkDeviceSize countBufferOffset, uint32_t maxDrawCount, uint32_t stride)
+{
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::DrawIndexedIndirectCount);
+	command.buffer = buffer;
+	command.countBuffer = countBuffer;
+	command.counts[0] = maxDrawCount;
+	command.counts[1] = stride;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier2(VkCommandBuffer commandBuffer, const VkDependencyInfo* pDependencyInfo)
+{
+	ALLOW_FRAME_ALLOCATIONS();
+
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::PipelineBarrier);
+	command.memoryBarriers.assign(pDependencyInfo->pMemoryBarriers,
+								  pDependencyInfo->pMemoryBarriers + pDependencyInfo->memoryBarrierCount);
+	command.bufferBarriers.assign(pDependencyInfo->pBufferMemoryBarriers,
+								  pDependencyInfo->pBufferMemoryBarriers + pDependencyInfo->bufferMemoryBarrierCount);
+	command.imageBarriers.assign(pDependencyInfo->pImageMemoryBarriers,
+								 pDependencyInfo->pImageMemoryBarriers + pDependencyInfo->imageMemoryBarrierCount);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount)
+{
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::ResetQueryPool);
+	command.queryPool = queryPool;
+	command.counts[0] = firstQuery;
+	command.counts[1] = queryCount;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(VkCommandBuffer commandBuffer, VkPipelineStageFlagBits pipelineStage, VkQueryPool queryPool, uint32_t query)
+{
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::WriteTimestamp);
+	command.queryPool = queryPool;
+	command.stages = pipelineStage;
+	command.counts[0] = query;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount,
+										   const VkBufferCopy* pRegions)
+{
+	ALLOW_FRAME_ALLOCATIONS();
+
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::CopyBuffer);
+	command.source = srcBuffer;
+	command.buffer = dstBuffer;
+	command.bufferRegions.assign(pRegions, pRegions + regionCount);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage, VkImageLayout dstImageLayout,
+												  uint32_t regionCount, const VkBufferImageCopy* pRegions)
+{
+	ALLOW_FRAME_ALLOCATIONS();
+
+	MockCommand& command = AddCommand(commandBuffer, MockCommandType::CopyBufferToImage);
+	command.source = srcBuffer;
+	command.image = dstImage;
+	command.imageRegions.assign(pRegions, pRegions + regionCount);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice device, const VkSemaphoreCreateInfo* pCreateInfo,
+												 const VkAllocationCallbacks* pAllocator, VkSemaphore* pSemaphore)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	MockSemaphore semaphore;
+	if (auto typeInfo = FindInfo<VkSemaphoreTypeCreateInfo>(pCreateInfo->pNext, VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO))
+	{
+		semaphore.timeline = typeInfo->semaphoreType == VK_SEMAPHORE_TYPE_TIMELINE;
+		semaphore.value = typeInfo->initialValue;
+		semaphore.signaledValue = typeInfo->initialValue;
+	}
+
+	*pSemaphore = CreateHandle<VkSemaphore>();
+	s_Device.semaphores.emplace(*pSemaphore, semaphore);
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks* pAllocator)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	s_Device.semaphores.erase(semaphore);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	for (uint32_t i = 0; i < submitCount; i++)
+	{
+		const VkSubmitInfo& submitInfo = pSubmits[i];
+		auto timelineInfo = FindInfo<VkTimelineSemaphoreSubmitInfo>(submitInfo.pNext, VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO);
+
+		MockSubmit submit;
+		submit.queue = queue;
+		submit.commandBuffers.assign(submitInfo.pCommandBuffers, submitInfo.pCommandBuffers + submitInfo.commandBufferCount);
+
+		for (uint32_t j = 0; j < submitInfo.signalSemaphoreCount; j++)
+		{
+			MockSemaphore& semaphore = s_Device.semaphores.at(submitInfo.pSignalSemaphores[j]);
+			uint64_t value = 0;
+
+			if (semaphore.timeline)
+			{
+				// A timeline only grows
+				if (timelineInfo == nullptr || j >= timelineInfo->signalSemaphoreValueCount ||
+					timelineInfo->pSignalSemaphoreValues[j] <= semaphore.signaledValue)
+					return VK_ERROR_UNKNOWN;
+
+				value = timelineInfo->pSignalSemaphoreValues[j];
+				semaphore.signaledValue = value;
+			}
+
+			submit.signalSemaphores.push_back(submitInfo.pSignalSemaphores[j]);
+			submit.signalValues.push_back(value);
+		}
+
+		for (VkCommandBuffer commandBuffer : submit.commandBuffers)
+		{
+			if (GetMockCommandBuffer(commandBuffer).recording)
+				return VK_ERROR_UNKNOWN;
+		}
+
+		s_Device.submits.push_back(std::move(submit));
+	}
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueWaitIdle(VkQueue queue)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	for (auto& [handle, semaphore] : s_Device.semaphores)
+		semaphore.value = semaphore.signaledValue;
+
+	return VK_SUCCESS;
+}
+
+// Finishes the work up to the values, a value nothing has been submitted for would never be reached
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores(VkDevice device, const VkSemaphoreWaitInfo* pWaitInfo, uint64_t timeout)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+	s_Device.waitCount++;
+
+	for (uint32_t i = 0; i < pWaitInfo->semaphoreCount; i++)
+	{
+		if (pWaitInfo->pValues[i] > s_Device.semaphores.at(pWaitInfo->pSemaphores[i]).signaledValue)
+			return VK_TIMEOUT;
+	}
+
+	for (uint32_t i = 0; i < pWaitInfo->semaphoreCount; i++)
+	{
+		MockSemaphore& semaphore = s_Device.semaphores.at(pWaitInfo->pSemaphores[i]);
+		semaphore.value = std::max(semaphore.value, pWaitInfo->pValues[i]);
+	}
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(VkDevice device, VkSemaphore semaphore, uint64_t* pValue)
+{
+	std::lock_guard<std::mutex> lock(s_Device.mutex);
+
+	*pValue = s_Device.semaphores.at(semaphore).value;
+	return VK_SUCCESS;
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// The device the tests run against: MockVulkan.cpp defines the vk* functions the tested sources call,
+// so the tests link against no driver. Every object is a fake handle and the device memory is host memory,
+// allocated when it's first mapped.
+
+typedef struct MockMemory_t {
+	VkDeviceSize size = 0;
+	uint32_t memoryType = 0;
+	VkBuffer dedicatedBuffer = VK_NULL_HANDLE; // From VkMemoryDedicatedAllocateInfo
+	VkImage dedicatedImage = VK_NULL_HANDLE;
+	std::vector<std::byte> data;
+} MockMemory;
+
+// A buffer or an image
+typedef struct MockResource_t {
+	VkMemoryRequirements requirements{};
+	bool prefersDedicated = false;
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	std::vector<uint32_t> queueFamilies; // Of a buffer shared concurrently
+} MockResource;
+
+enum class MockCommandType {
+	FillBuffer,
+	BindPipeline,
+	BindDescriptorSets,
+	PushConstants,
+	Dispatch,
+	DrawIndexed,
+	DrawIndexedIndirectCount,
+	PipelineBarrier,
+	ResetQueryPool,
+	WriteTimestamp,
+	CopyBuffer,
+	CopyBufferToImage
+};
+
+// The arguments of a recorded command, the fields the command doesn't have stay zero
+typedef struct MockCommand_t {
+	MockCommandType type = MockCommandType::FillBuffer;
+	VkBuffer buffer = VK_NULL_HANDLE;      // The filled, the indirect or the destination buffer
+	VkBuffer countBuffer = VK_NULL_HANDLE;
+	VkBuffer source = VK_NULL_HANDLE;      // Of a copy
+	VkImage image = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	VkShaderStageFlags stages = 0;         // Or the pipeline stage of a timestamp
+	uint32_t counts[3] = {};               // The group counts, the index count, instance count and first instance,
+										   // the maximum draw count and its stride, the first query and the query count
+	std::vector<std::byte> data;           // The push constants
+	std::vector<VkMemoryBarrier2> memoryBarriers;
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkBufferCopy> bufferRegions;
+	std::vector<VkBufferImageCopy> imageRegions;
+} MockCommand;
+
+// The handle of a command buffer points to it, so the commands are recorded without a lock
+typedef struct MockCommandBuffer_t {
+	VkCommandPool pool = VK_NULL_HANDLE;
+	VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	bool recording = false;
+	uint32_t beginCount = 0;
+	VkCommandBufferUsageFlags usage = 0;
+	const VkCommandBufferInheritanceInfo* inheritance = nullptr;
+	std::vector<MockCommand> commands;
+} MockCommandBuffer;
+
+// Resetting a pool resets its command buffers, destroying it frees them
+typedef struct MockCommandPool_t {
+	uint32_t queueFamilyIndex = 0;
+	bool destroyed = false;
+	std::vector<MockCommandBuffer*> commandBuffers;
+} MockCommandPool;
+
+// The GPU never finishes on its own: a timeline reaches a value when a test sets it, when it's waited for or when the queue idles
+typedef struct MockSemaphore_t {
+	bool timeline = false;
+	uint64_t value = 0;
+	uint64_t signaledValue = 0; // The largest value submitted
+} MockSemaphore;
+
+typedef struct MockSubmit_t {
+	VkQueue queue = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VkSemaphore> signalSemaphores;
+	std::vector<uint64_t> signalValues;
+} MockSubmit;
+
+typedef struct MockDevice_t {
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	VkPhysicalDeviceProperties properties{};
+	std::vector<VkQueueFamilyProperties> queueFamilies;
+
+	// The requirements of the buffers and the images created next, an image takes 4 bytes per texel
+	VkDeviceSize alignment = 256;
+	uint32_t memoryTypeBits = ~0u;
+	bool prefersDedicated = false;
+
+	uint32_t allocateCount = 0; // vkAllocateMemory calls
+	uint32_t freeCount = 0;
+	std::map<VkDeviceMemory, MockMemory> memories; // The live allocations
+	std::map<VkBuffer, MockResource> buffers;
+	std::map<VkImage, MockResource> images;
+
+	// The descriptor set layouts, pools, pipeline layouts, shader modules and pipelines alive
+	uint32_t objectCount = 0;
+	std::map<VkDescriptorSet, std::map<uint32_t, VkBuffer>> descriptorSets; // The buffer written to every binding
+
+	// Kept until the reset, so the tests can look at the destroyed ones
+	std::vector<std::unique_ptr<MockCommandBuffer>> commandBuffers;
+	std::vector<std::unique_ptr<MockCommandPool>> commandPools;
+	uint32_t commandPoolCount = 0; // Alive
+
+	// The timestamps read back from every live query pool, written by the tests
+	std::map<VkQueryPool, std::vector<uint64_t>> queryPools;
+
+	std::map<VkSemaphore, MockSemaphore> semaphores;
+	std::vector<MockSubmit> submits;
+	uint32_t waitCount = 0; // vkWaitSemaphores calls
+
+	std::mutex mutex; // The allocators may be called from the workers
+} MockDevice;
+
+// Default memory types: 0 device local on heap 0 (1 GiB), 1 host visible and coherent on heap 1 (1 GiB),
+// 2 device local, host visible and coherent on heap 2 (256 MiB).
+// Default queue families: 0 graphics, compute and transfer, 1 transfer only, both with 64-bit timestamps of 1 ns
+static constexpr VkDeviceSize MOCK_DEVICE_HEAP_SIZE = 1ull << 30;
+static constexpr VkDeviceSize MOCK_SHARED_HEAP_SIZE = 256ull << 20;
+
+extern const VkPhysicalDevice MOCK_PHYSICAL_DEVICE;
+extern const VkDevice MOCK_DEVICE;
+
+// Every test starts with a reset, it drops the objects the previous test left behind
+MockDevice& ResetMockDevice();
+MockDevice& GetMockDevice();
+
+VkCommandBuffer CreateMockCommandBuffer();
+MockCommandBuffer& GetMockCommandBuffer(VkCommandBuffer commandBuffer) noexcept;
+MockCommandPool& GetMockCommandPool(VkCommandPool commandPool) noexcept;
@@ -0,0 +1,198 @@
+#include "TestFramework.h"
+#include "MockVulkan.h"
+#include "../ParallelRecorder.h"
+#include "../AllocationTracker.h"
+
+#include <stdexcept>
+#include <vector>
+
+// Draws every item as its own instance, like the per-object draws of the application
+static void RecordItems(void* context, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)
+{
+	for (uint32_t i = first; i < first + count; i++)
+		vkCmdDrawIndexed(commandBuffer, 3, 1, 0, 0, i);
+}
+
+static void RecordItemsFailingAtFive(void* context, VkCommandBuffer commandBuffer, uint32_t first, uint32_t count)
+{
+	if (first <= 5 && 5 < first + count)
+	{
+		// The message is allocated on the error path only
+		ALLOW_FRAME_ALLOCATIONS();
+		throw std::runtime_error("Item five can't be recorded!");
+	}
+
+	RecordItems(context, commandBuffer, first, count);
+}
+
+// The items recorded into each of the secondary command buffers, in order
+static std::vector<std::vector<uint32_t>> GetRecordedItems(const ParallelRecorder& recorder, uint32_t count)
+{
+	std::vector<std::vector<uint32_t>> chunks(count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const MockCommandBuffer& commandBuffer = GetMockCommandBuffer(recorder.GetCommandBuffers()[i]);
+		CHECK(!commandBuffer.recording);
+
+		for (const MockCommand& command : commandBuffer.commands)
+			chunks[i].push_back(command.counts[2]);
+	}
+
+	return chunks;
+}
+
+TEST(ParallelRecorder, SplitsTheItemsEvenly)
+{
+	ResetMockDevice();
+
+	JobSystem jobs;
+	jobs.Init(3);
+
+	ParallelRecorder recorder;
+	recorder.Init(MOCK_DEVICE, 0, 4, jobs);
+
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+	CHECK_EQUAL(4u, recorder.Record(0, inheritance, 10, &RecordItems, nullptr));
+
+	// The chunks take 2, 3, 2 and 3 items, together every item once and in order
+	std::vector<std::vector<uint32_t>> chunks = GetRecordedItems(recorder, 4);
+	CHECK_EQUAL(2u, chunks[0].size());
+	CHECK_EQUAL(3u, chunks[1].size());
+	CHECK_EQUAL(2u, chunks[2].size());
+	CHECK_EQUAL(3u, chunks[3].size());
+
+	uint32_t next = 0;
+	for (auto& chunk : chunks)
+	{
+		for (uint32_t item : chunk)
+			CHECK_EQUAL(next++, item);
+	}
+
+	// Secondary command buffers continuing the render pass of the primary one
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		const MockCommandBuffer& commandBuffer = GetMockCommandBuffer(recorder.GetCommandBuffers()[i]);
+		CHECK(commandBuffer.level == VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		CHECK(commandBuffer.usage & VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+		CHECK(commandBuffer.inheritance == &inheritance);
+	}
+
+	recorder.Destroy();
+	jobs.Destroy();
+
+	CHECK_EQUAL(0u, GetMockDevice().commandPoolCount);
+}
+
+TEST(ParallelRecorder, UsesNoMoreChunksThanItems)
+{
+	ResetMockDevice();
+
+	JobSystem jobs;
+	jobs.Init(2);
+
+	ParallelRecorder recorder;
+	recorder.Init(MOCK_DEVICE, 0, 8, jobs);
+
+	VkCommandBufferInheritanceInfo inheritance{};
+
+	CHECK_EQUAL(3u, recorder.Record(0, inheritance, 3, &RecordItems, nullptr));
+
+	std::vector<std::vector<uint32_t>> chunks = GetRecordedItems(recorder, 3);
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		CHECK_EQUAL(1u, chunks[i].size());
+		CHECK_EQUAL(i, chunks[i][0]);
+	}
+
+	CHECK_EQUAL(0u, recorder.Record(1, inheritance, 0, &RecordItems, nullptr));
+
+	recorder.Destroy();
+	jobs.Destroy();
+}
+
+TEST(ParallelRecorder, ClampsTheChunkCount)
+{
+	ResetMockDevice();
+
+	JobSystem jobs;
+	jobs.Init(1);
+
+	ParallelRecorder recorder;
+	recorder.Init(MOCK_DEVICE, 0, 0, jobs);
+	CHECK_EQUAL(1u, recorder.GetChunkCount());
+	CHECK_EQUAL(ParallelRecorder::MAX_SLOTS, GetMockDevice().commandPoolCount);
+	recorder.Destroy();
+
+	recorder.Init(MOCK_DEVICE, 0, 100, jobs);
+	CHECK_EQUAL(ParallelRecorder::MAX_CHUNKS, recorder.GetChunkCount());
+	CHECK_EQUAL(ParallelRecorder::MAX_CHUNKS * ParallelRecorder::MAX_SLOTS, GetMockDevice().commandPoolCount);
+	recorder.Destroy();
+
+	jobs.Destroy();
+}
+
+TEST(ParallelRecorder, GivesEverySlotItsOwnPools)
+{
+	ResetMockDevice();
+
+	JobSystem jobs;
+	jobs.Init(2);
+
+	ParallelRecorder recorder;
+	recorder.Init(MOCK_DEVICE, 0, 2, jobs);
+
+	VkCommandBufferInheritanceInfo inheritance{};
+
+	recorder.Record(0, inheritance, 4, &RecordItems, nullptr);
+	std::vector<VkCommandBuffer> slot0(recorder.GetCommandBuffers(), recorder.GetCommandBuffers() + 2);
+
+	recorder.Record(1, inheritance, 6, &RecordItems, nullptr);
+	std::vector<VkCommandBuffer> slot1(recorder.GetCommandBuffers(), recorder.GetCommandBuffers() + 2);
+
+	// Recording slot 1 left the command buffers of slot 0 alone
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		CHECK(slot0[i] != slot1[i]);
+		CHECK(GetMockCommandBuffer(slot0[i]).pool != GetMockCommandBuffer(slot1[i]).pool);
+		CHECK_EQUAL(2u, GetMockCommandBuffer(slot0[i]).commands.size());
+		CHECK_EQUAL(3u, GetMockCommandBuffer(slot1[i]).commands.size());
+	}
+
+	// Reusing slot 0 resets its pools and records into the same command buffers again
+	recorder.Record(0, inheritance, 2, &RecordItems, nullptr);
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		CHECK(recorder.GetCommandBuffers()[i] == slot0[i]);
+		CHECK_EQUAL(2u, GetMockCommandBuffer(slot0[i]).beginCount);
+		CHECK_EQUAL(1u, GetMockCommandBuffer(slot0[i]).commands.size());
+	}
+
+	recorder.Destroy();
+	jobs.Destroy();
+}
+
+TEST(ParallelRecorder, RethrowsTheErrorOfAChunk)
+{
+	ResetMockDevice();
+
+	JobSystem jobs;
+	jobs.Init(3);
+
+	ParallelRecorder recorder;
+	recorder.Init(MOCK_DEVICE, 0, 4, jobs);
+
+	VkCommandBufferInheritanceInfo inheritance{};
+
+	CHECK_THROWS(recorder.Record(0, inheritance, 16, &RecordItemsFailingAtFive, nullptr));
+
+	// The error doesn't stick to the chunk
+	CHECK_EQUAL(4u, recorder.Record(0, inheritance, 16, &RecordItems, nullptr));
+	CHECK_EQUAL(4u, GetRecordedItems(recorder, 4)[1].size());
+
+	recorder.Destroy();
+	jobs.Destroy();
+}
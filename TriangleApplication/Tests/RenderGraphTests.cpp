@@ -0,0 +1,676 @@
+#include "TestFramework.h"
+#include "MockVulkan.h"
+#include "../RenderGraph.h"
+
+#include <sstream>
+#include <vector>
+
+// Every pass dispatches its own number, so the recorded commands tell the passes apart
+static void* GetPassMarker(uint32_t marker)
+{
+	return reinterpret_cast<void*>(uintptr_t(marker));
+}
+
+static void RecordPass(void* context, VkCommandBuffer commandBuffer)
+{
+	vkCmdDispatch(commandBuffer, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(context)), 0, 0);
+}
+
+static VkBuffer CreateBuffer()
+{
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = 256;
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	VkBuffer buffer;
+	vkCreateBuffer(MOCK_DEVICE, &bufferInfo, nullptr, &buffer);
+	return buffer;
+}
+
+static VkImageCreateInfo GetImageInfo(uint32_t width, uint32_t height)
+{
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_B8G8R8A8_UNORM;
+	imageInfo.extent = { width, height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+	return imageInfo;
+}
+
+// A graph on the mock device, executed with a profiler that isn't initialized unless a test does it
+typedef struct GraphFixture_t {
+	DeviceAllocator allocator;
+	GpuProfiler profiler;
+	RenderGraph graph;
+
+	GraphFixture_t(uint32_t queueFamilyIndex = 0)
+	{
+		ResetMockDevice();
+		allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+		graph.Init(MOCK_DEVICE, queueFamilyIndex, allocator);
+	}
+
+	~GraphFixture_t()
+	{
+		graph.Destroy();
+		profiler.Destroy();
+		allocator.Destroy();
+	}
+
+	RenderGraph::PassId AddPass(const char* name, uint32_t marker)
+	{
+		return graph.AddPass(name, &RecordPass, GetPassMarker(marker));
+	}
+
+	VkCommandBuffer Execute()
+	{
+		VkCommandBuffer commandBuffer = CreateMockCommandBuffer();
+		graph.Execute(commandBuffer, profiler);
+		return commandBuffer;
+	}
+} GraphFixture;
+
+// The markers of the recorded passes, in order
+static std::vector<uint32_t> GetPassOrder(VkCommandBuffer commandBuffer)
+{
+	std::vector<uint32_t> order;
+	for (const MockCommand& command : GetMockCommandBuffer(commandBuffer).commands)
+	{
+		if (command.type == MockCommandType::Dispatch)
+			order.push_back(command.counts[0]);
+	}
+
+	return order;
+}
+
+// The barriers recorded right before the pass, or after the last pass for UINT32_MAX. Empty without any
+static MockCommand GetBarriers(VkCommandBuffer commandBuffer, uint32_t marker)
+{
+	const std::vector<MockCommand>& commands = GetMockCommandBuffer(commandBuffer).commands;
+
+	for (size_t i = 0; i < commands.size(); i++)
+	{
+		bool last = marker == UINT32_MAX && i + 1 == commands.size();
+		bool beforePass = i + 1 < commands.size() && commands[i + 1].type == MockCommandType::Dispatch &&
+						  commands[i + 1].counts[0] == marker;
+
+		if (commands[i].type == MockCommandType::PipelineBarrier && (last || beforePass))
+			return commands[i];
+	}
+
+	return MockCommand{};
+}
+
+// Whether two commands record the same barriers
+static bool IsSameBarrier(const MockCommand& first, const MockCommand& second)
+{
+	if (first.type != second.type || first.bufferBarriers.size() != second.bufferBarriers.size() ||
+		first.imageBarriers.size() != second.imageBarriers.size())
+		return false;
+
+	for (size_t i = 0; i < first.bufferBarriers.size(); i++)
+	{
+		const VkBufferMemoryBarrier2& a = first.bufferBarriers[i];
+		const VkBufferMemoryBarrier2& b = second.bufferBarriers[i];
+
+		if (a.buffer != b.buffer || a.srcStageMask != b.srcStageMask || a.srcAccessMask != b.srcAccessMask ||
+			a.dstStageMask != b.dstStageMask || a.dstAccessMask != b.dstAccessMask ||
+			a.srcQueueFamilyIndex != b.srcQueueFamilyIndex || a.dstQueueFamilyIndex != b.dstQueueFamilyIndex)
+			return false;
+	}
+
+	for (size_t i = 0; i < first.imageBarriers.size(); i++)
+	{
+		const VkImageMemoryBarrier2& a = first.imageBarriers[i];
+		const VkImageMemoryBarrier2& b = second.imageBarriers[i];
+
+		if (a.image != b.image || a.srcStageMask != b.srcStageMask || a.srcAccessMask != b.srcAccessMask ||
+			a.dstStageMask != b.dstStageMask || a.dstAccessMask != b.dstAccessMask ||
+			a.oldLayout != b.oldLayout || a.newLayout != b.newLayout)
+			return false;
+	}
+
+	return true;
+}
+
+TEST(RenderGraph, CullsThePassesThatDontReachAnOutput)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+
+	RenderGraph::ResourceId draws = graph.ImportBuffer("Draws");
+	RenderGraph::ResourceId unused = graph.ImportBuffer("Unused");
+	RenderGraph::ResourceId scratch = graph.ImportBuffer("Scratch");
+	RenderGraph::ResourceId indirect = graph.ImportBuffer("Indirect");
+	RenderGraph::ResourceId counts = graph.ImportBuffer("Counts");
+
+	RenderGraph::PassId clear = fixture.AddPass("Clear", 0);
+	graph.Write(clear, draws, ResourceUsage::TransferDestination);
+
+	// Only feeds a culled pass
+	RenderGraph::PassId fill = fixture.AddPass("Fill", 1);
+	graph.Write(fill, unused, ResourceUsage::ComputeStorage);
+
+	RenderGraph::PassId consume = fixture.AddPass("Consume", 2);
+	graph.Read(consume, unused, ResourceUsage::ComputeStorage);
+	graph.Write(consume, scratch, ResourceUsage::ComputeStorage);
+
+	// Kept through the pass after it, which writes an output
+	RenderGraph::PassId count = fixture.AddPass("Count", 3);
+	graph.Write(count, counts, ResourceUsage::ComputeStorage);
+
+	RenderGraph::PassId cull = fixture.AddPass("Cull", 4);
+	graph.Read(cull, draws, ResourceUsage::ComputeStorage);
+	graph.Read(cull, counts, ResourceUsage::ComputeStorage);
+	graph.Write(cull, indirect, ResourceUsage::ComputeStorage);
+
+	graph.SetOutput(indirect, ResourceUsage::IndirectArguments);
+	graph.Compile();
+
+	CHECK(GetPassOrder(fixture.Execute()) == std::vector<uint32_t>({ 0, 3, 4 }));
+
+	std::ostringstream report;
+	graph.Report(report);
+	CHECK(report.str().find("Fill: culled") != std::string::npos);
+	CHECK(report.str().find("Consume: culled") != std::string::npos);
+	CHECK(report.str().find("Count: culled") == std::string::npos);
+}
+
+TEST(RenderGraph, OrdersTheAccessesOfABuffer)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+
+	// Start every frame without pending accesses
+	RenderGraph::ResourceId draws = graph.ImportBuffer("Draws", false);
+	RenderGraph::ResourceId visible = graph.ImportBuffer("Visible", false);
+	RenderGraph::ResourceId counts = graph.ImportBuffer("Counts", false);
+	RenderGraph::ResourceId swapchain = graph.ImportImage("Swapchain", VK_IMAGE_ASPECT_COLOR_BIT);
+
+	RenderGraph::PassId clear = fixture.AddPass("Clear", 0);
+	graph.Write(clear, draws, ResourceUsage::TransferDestination);
+
+	// The readers write outputs of their own, so they're kept
+	RenderGraph::PassId cull = fixture.AddPass("Cull", 1);
+	graph.Read(cull, draws, ResourceUsage::ComputeStorage);
+	graph.Write(cull, visible, ResourceUsage::ComputeStorage);
+
+	RenderGraph::PassId count = fixture.AddPass("Count", 2);
+	graph.Read(count, draws, ResourceUsage::ComputeStorage);
+	graph.Write(count, counts, ResourceUsage::ComputeStorage);
+
+	RenderGraph::PassId draw = fixture.AddPass("Draw", 3);
+	graph.Read(draw, draws, ResourceUsage::IndirectArguments);
+	graph.Write(draw, swapchain, ResourceUsage::ColorAttachment);
+
+	RenderGraph::PassId rewrite = fixture.AddPass("Rewrite", 4);
+	graph.Write(rewrite, draws, ResourceUsage::ComputeStorage);
+
+	graph.SetOutput(draws, ResourceUsage::None);
+	graph.SetOutput(visible, ResourceUsage::None);
+	graph.SetOutput(counts, ResourceUsage::None);
+	graph.SetOutput(swapchain, ResourceUsage::None);
+	graph.Compile();
+
+	VkBuffer buffer = CreateBuffer();
+	graph.SetBuffer(draws, buffer);
+	VkCommandBuffer commandBuffer = fixture.Execute();
+
+	CHECK(GetBarriers(commandBuffer, 0).bufferBarriers.empty());
+
+	// Read after write
+	MockCommand barriers = GetBarriers(commandBuffer, 1);
+	CHECK_EQUAL(1u, barriers.bufferBarriers.size());
+	const VkBufferMemoryBarrier2& read = barriers.bufferBarriers[0];
+	CHECK(read.buffer == buffer);
+	CHECK(read.srcStageMask == VK_PIPELINE_STAGE_2_TRANSFER_BIT);
+	CHECK(read.srcAccessMask == VK_ACCESS_2_TRANSFER_WRITE_BIT);
+	CHECK(read.dstStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+	CHECK(read.dstAccessMask == VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+	CHECK(read.srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+	CHECK(read.dstQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+	CHECK(read.offset == 0);
+	CHECK(read.size == VK_WHOLE_SIZE);
+
+	// The write is already visible to the same stage and access
+	CHECK(GetBarriers(commandBuffer, 2).bufferBarriers.empty());
+
+	// But not to another stage
+	barriers = GetBarriers(commandBuffer, 3);
+	CHECK_EQUAL(1u, barriers.bufferBarriers.size());
+	CHECK(barriers.bufferBarriers[0].srcStageMask == VK_PIPELINE_STAGE_2_TRANSFER_BIT);
+	CHECK(barriers.bufferBarriers[0].dstStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+	CHECK(barriers.bufferBarriers[0].dstAccessMask == VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+
+	// Write after read only waits for the execution of every read
+	barriers = GetBarriers(commandBuffer, 4);
+	CHECK_EQUAL(1u, barriers.bufferBarriers.size());
+	CHECK(barriers.bufferBarriers[0].srcStageMask == (VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT));
+	CHECK(barriers.bufferBarriers[0].srcAccessMask == VK_ACCESS_2_NONE);
+	CHECK(barriers.bufferBarriers[0].dstStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+	CHECK(barriers.bufferBarriers[0].dstAccessMask == VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+	// An output without a final usage is left as it is
+	CHECK(GetBarriers(commandBuffer, UINT32_MAX).bufferBarriers.empty());
+
+	// The handle is read when the barriers are recorded
+	VkBuffer replaced = CreateBuffer();
+	graph.SetBuffer(draws, replaced);
+	CHECK(GetBarriers(fixture.Execute(), 1).bufferBarriers.at(0).buffer == replaced);
+}
+
+TEST(RenderGraph, WaitsForThePreviousFrameOfAPersistentBuffer)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+
+	RenderGraph::ResourceId persistent = graph.ImportBuffer("Persistent");
+	RenderGraph::ResourceId perFrame = graph.ImportBuffer("Per frame", false);
+
+	RenderGraph::PassId update = fixture.AddPass("Update", 0);
+	graph.ReadWrite(update, persistent, ResourceUsage::ComputeStorage);
+	graph.ReadWrite(update, perFrame, ResourceUsage::ComputeStorage);
+
+	graph.SetOutput(persistent, ResourceUsage::None);
+	graph.SetOutput(perFrame, ResourceUsage::None);
+	graph.Compile();
+
+	// The write of the last frame is followed by this one
+	MockCommand barriers = GetBarriers(fixture.Execute(), 0);
+	CHECK_EQUAL(1u, barriers.bufferBarriers.size());
+	CHECK(barriers.bufferBarriers[0].srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+	CHECK(barriers.bufferBarriers[0].srcAccessMask == VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+	CHECK(barriers.bufferBarriers[0].dstAccessMask == (VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT));
+
+	std::ostringstream report;
+	graph.Report(report);
+	CHECK(report.str().find("Update: 1 buffer and 0 image barriers") != std::string::npos);
+}
+
+TEST(RenderGraph, TransitionsTheImageLayouts)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+
+	RenderGraph::ResourceId swapchain = graph.ImportImage("Swapchain", VK_IMAGE_ASPECT_COLOR_BIT);
+	RenderGraph::ResourceId scene = graph.CreateImage("Scene", GetImageInfo(64, 64), VK_IMAGE_ASPECT_COLOR_BIT);
+
+	RenderGraph::PassId draw = fixture.AddPass("Draw", 0);
+	graph.Write(draw, scene, ResourceUsage::ColorAttachment);
+
+	RenderGraph::PassId compose = fixture.AddPass("Compose", 1);
+	graph.Read(compose, scene, ResourceUsage::FragmentSampled);
+	graph.Write(compose, swapchain, ResourceUsage::ColorAttachment);
+
+	graph.SetOutput(swapchain, ResourceUsage::Present);
+	graph.Compile();
+
+	VkImage swapchainImage = (VkImage)(uintptr_t)0x5000;
+	graph.SetImage(swapchain, swapchainImage);
+	VkCommandBuffer commandBuffer = fixture.Execute();
+
+	// The transient image is created undefined, whatever the initial layout of its info
+	MockCommand barriers = GetBarriers(commandBuffer, 0);
+	CHECK_EQUAL(1u, barriers.imageBarriers.size());
+	const VkImageMemoryBarrier2& attach = barriers.imageBarriers[0];
+	CHECK(attach.image == graph.GetImage(scene));
+	CHECK(attach.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(attach.newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(attach.dstStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+	CHECK(attach.dstAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+	CHECK(attach.subresourceRange.aspectMask == VK_IMAGE_ASPECT_COLOR_BIT);
+	CHECK(attach.subresourceRange.levelCount == VK_REMAINING_MIP_LEVELS);
+	CHECK(attach.subresourceRange.layerCount == VK_REMAINING_ARRAY_LAYERS);
+
+	barriers = GetBarriers(commandBuffer, 1);
+	CHECK_EQUAL(2u, barriers.imageBarriers.size());
+
+	// The sampling waits for the attachment writes
+	const VkImageMemoryBarrier2& sample = barriers.imageBarriers[0];
+	CHECK(sample.image == graph.GetImage(scene));
+	CHECK(sample.oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(sample.newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	CHECK(sample.srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+	CHECK(sample.srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+	CHECK(sample.dstStageMask == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+	CHECK(sample.dstAccessMask == VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+	// The swapchain image is acquired undefined by the semaphore wait on the attachment stage
+	const VkImageMemoryBarrier2& acquire = barriers.imageBarriers[1];
+	CHECK(acquire.image == swapchainImage);
+	CHECK(acquire.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(acquire.newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(acquire.srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+	CHECK(acquire.srcAccessMask == VK_ACCESS_2_NONE);
+
+	// And handed to the present after every write
+	barriers = GetBarriers(commandBuffer, UINT32_MAX);
+	CHECK_EQUAL(1u, barriers.imageBarriers.size());
+	const VkImageMemoryBarrier2& present = barriers.imageBarriers[0];
+	CHECK(present.image == swapchainImage);
+	CHECK(present.oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	CHECK(present.newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	CHECK(present.srcStageMask == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+	CHECK(present.srcAccessMask == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+	CHECK(present.dstStageMask == VK_PIPELINE_STAGE_2_NONE);
+	CHECK(present.dstAccessMask == VK_ACCESS_2_NONE);
+
+	// Another swapchain image next frame
+	VkImage nextImage = (VkImage)(uintptr_t)0x5001;
+	graph.SetImage(swapchain, nextImage);
+	CHECK(GetBarriers(fixture.Execute(), UINT32_MAX).imageBarriers.at(0).image == nextImage);
+}
+
+TEST(RenderGraph, AliasesTheTransientImagesWithDisjointLifetimes)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+	MockDevice& device = GetMockDevice();
+
+	RenderGraph::ResourceId swapchain = graph.ImportImage("Swapchain", VK_IMAGE_ASPECT_COLOR_BIT);
+	RenderGraph::ResourceId first = graph.CreateImage("First", GetImageInfo(64, 64), VK_IMAGE_ASPECT_COLOR_BIT);
+	RenderGraph::ResourceId middle = graph.CreateImage("Middle", GetImageInfo(64, 64), VK_IMAGE_ASPECT_COLOR_BIT);
+	RenderGraph::ResourceId last = graph.CreateImage("Last", GetImageInfo(128, 128), VK_IMAGE_ASPECT_COLOR_BIT);
+	RenderGraph::ResourceId unused = graph.CreateImage("Unused", GetImageInfo(64, 64), VK_IMAGE_ASPECT_COLOR_BIT);
+
+	// First lives in the passes 0 and 1, Middle in 1 and 2, Last in 2 and 3
+	RenderGraph::PassId pass0 = fixture.AddPass("Pass 0", 0);
+	graph.Write(pass0, first, ResourceUsage::ColorAttachment);
+
+	RenderGraph::PassId pass1 = fixture.AddPass("Pass 1", 1);
+	graph.Read(pass1, first, ResourceUsage::FragmentSampled);
+	graph.Write(pass1, middle, ResourceUsage::ColorAttachment);
+
+	RenderGraph::PassId pass2 = fixture.AddPass("Pass 2", 2);
+	graph.Read(pass2, middle, ResourceUsage::FragmentSampled);
+	graph.Write(pass2, last, ResourceUsage::ColorAttachment);
+
+	RenderGraph::PassId pass3 = fixture.AddPass("Pass 3", 3);
+	graph.Read(pass3, last, ResourceUsage::FragmentSampled);
+	graph.Write(pass3, swapchain, ResourceUsage::ColorAttachment);
+
+	// Culled, so its image isn't created
+	RenderGraph::PassId culled = fixture.AddPass("Culled", 4);
+	graph.Write(culled, unused, ResourceUsage::ColorAttachment);
+
+	graph.SetOutput(swapchain, ResourceUsage::Present);
+	graph.Compile();
+
+	CHECK(graph.GetImage(unused) == VK_NULL_HANDLE);
+	CHECK_EQUAL(3u, device.images.size());
+
+	const MockResource& firstImage = device.images.at(graph.GetImage(first));
+	const MockResource& middleImage = device.images.at(graph.GetImage(middle));
+	const MockResource& lastImage = device.images.at(graph.GetImage(last));
+
+	// Last takes the memory of First, which grows to fit the larger image
+	CHECK(firstImage.memory != VK_NULL_HANDLE);
+	CHECK(firstImage.memory == lastImage.memory);
+	CHECK_EQUAL(firstImage.offset, lastImage.offset);
+	CHECK(middleImage.memory != firstImage.memory || middleImage.offset != firstImage.offset);
+
+	DeviceAllocator::HeapStats stats = fixture.allocator.GetHeapStats(0);
+	CHECK_EQUAL(2u, stats.allocationCount);
+
+	std::ostringstream report;
+	graph.Report(report);
+	CHECK(report.str().find("Transient images: " + std::to_string(128 * 128 * 4 + 64 * 64 * 4) + " bytes in 2 allocations") != std::string::npos);
+
+	// Last waits for the sampling of First, whose memory it overwrites, and drops its content
+	VkCommandBuffer commandBuffer = fixture.Execute();
+	const VkImageMemoryBarrier2* alias = nullptr;
+	for (const VkImageMemoryBarrier2& barrier : GetBarriers(commandBuffer, 2).imageBarriers)
+	{
+		if (barrier.image == graph.GetImage(last))
+			alias = &barrier;
+	}
+
+	CHECK(alias != nullptr);
+	CHECK(alias->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(alias->srcStageMask == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+	CHECK(alias->srcAccessMask == VK_ACCESS_2_NONE);
+
+	// First, the next frame, waits for the sampling of Last the same way
+	const VkImageMemoryBarrier2& wrap = GetBarriers(commandBuffer, 0).imageBarriers.at(0);
+	CHECK(wrap.image == graph.GetImage(first));
+	CHECK(wrap.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	CHECK(wrap.srcStageMask == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+
+	// Destroyed with the graph
+	graph.Reset();
+	CHECK(device.images.empty());
+	CHECK_EQUAL(0u, fixture.allocator.GetHeapStats(0).allocationCount);
+}
+
+TEST(RenderGraph, TimesEveryKeptPass)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+
+	RenderGraph::ResourceId draws = graph.ImportBuffer("Draws");
+
+	RenderGraph::PassId clear = fixture.AddPass("Clear", 0);
+	graph.Write(clear, draws, ResourceUsage::TransferDestination);
+
+	RenderGraph::PassId cull = fixture.AddPass("Cull", 1);
+	graph.ReadWrite(cull, draws, ResourceUsage::ComputeStorage);
+
+	graph.SetOutput(draws, ResourceUsage::IndirectArguments);
+	graph.Compile();
+
+	// Without a profiler nothing but the barriers and the passes is recorded
+	for (const MockCommand& command : GetMockCommandBuffer(fixture.Execute()).commands)
+		CHECK(command.type == MockCommandType::PipelineBarrier || command.type == MockCommandType::Dispatch);
+
+	fixture.profiler.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE, 0);
+	CHECK(fixture.profiler.IsSupported());
+
+	VkCommandBuffer commandBuffer = CreateMockCommandBuffer();
+	fixture.profiler.BeginFrame(commandBuffer, 0, 1);
+	graph.Execute(commandBuffer, fixture.profiler);
+	fixture.profiler.EndFrame(commandBuffer);
+
+	// The scope of a pass contains its barriers, the final barriers belong to the frame
+	std::vector<MockCommandType> types;
+	std::vector<uint32_t> queries;
+	for (const MockCommand& command : GetMockCommandBuffer(commandBuffer).commands)
+	{
+		types.push_back(command.type);
+		if (command.type == MockCommandType::WriteTimestamp)
+			queries.push_back(command.counts[0]);
+	}
+
+	CHECK(types == std::vector<MockCommandType>({
+		MockCommandType::ResetQueryPool, MockCommandType::WriteTimestamp,
+		MockCommandType::WriteTimestamp, MockCommandType::PipelineBarrier, MockCommandType::Dispatch, MockCommandType::WriteTimestamp,
+		MockCommandType::WriteTimestamp, MockCommandType::PipelineBarrier, MockCommandType::Dispatch, MockCommandType::WriteTimestamp,
+		MockCommandType::PipelineBarrier, MockCommandType::WriteTimestamp }));
+	CHECK(queries == std::vector<uint32_t>({ 0, 2, 3, 4, 5, 1 }));
+}
+
+TEST(RenderGraph, RecordsTheSameCommandsEveryFrame)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+
+	// The graph of the application: the draws are culled into a persistent buffer and drawn to the target
+	RenderGraph::ResourceId target = graph.ImportImage("Target", VK_IMAGE_ASPECT_COLOR_BIT);
+	RenderGraph::ResourceId draws = graph.ImportBuffer("Draws");
+
+	RenderGraph::PassId cull = fixture.AddPass("Cull", 0);
+	graph.Write(cull, draws, ResourceUsage::ComputeStorage);
+
+	RenderGraph::PassId draw = fixture.AddPass("Draw", 1);
+	graph.Read(draw, draws, ResourceUsage::IndirectArguments);
+	graph.Write(draw, target, ResourceUsage::ColorAttachment);
+
+	graph.SetOutput(target, ResourceUsage::Present);
+	graph.Compile();
+
+	VkImage images[2] = { (VkImage)(uintptr_t)0x5000, (VkImage)(uintptr_t)0x5001 };
+	graph.SetBuffer(draws, CreateBuffer());
+
+	auto record = [&](VkImage image) {
+		graph.SetImage(target, image);
+		return fixture.Execute();
+	};
+
+	VkCommandBuffer first = record(images[0]);
+	record(images[1]);
+	VkCommandBuffer again = record(images[0]);
+
+	// Nothing depends on the frames recorded before, so a cached command buffer submits what a new recording would
+	const std::vector<MockCommand>& firstCommands = GetMockCommandBuffer(first).commands;
+	const std::vector<MockCommand>& againCommands = GetMockCommandBuffer(again).commands;
+	CHECK_EQUAL(firstCommands.size(), againCommands.size());
+
+	for (size_t i = 0; i < firstCommands.size() && i < againCommands.size(); i++)
+		CHECK(IsSameBarrier(firstCommands[i], againCommands[i]));
+
+	// And it follows any frame: the target starts undefined and ends presentable, the first write of the draws
+	// waits for their indirect reads, whichever command buffer made them
+	MockCommand barriers = GetBarriers(first, 0);
+	CHECK_EQUAL(1u, barriers.bufferBarriers.size());
+	CHECK(barriers.bufferBarriers[0].srcStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+	CHECK(barriers.bufferBarriers[0].dstStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+
+	barriers = GetBarriers(first, 1);
+	CHECK_EQUAL(1u, barriers.imageBarriers.size());
+	CHECK(barriers.imageBarriers[0].image == images[0]);
+	CHECK(barriers.imageBarriers[0].oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+
+	barriers = GetBarriers(first, UINT32_MAX);
+	CHECK_EQUAL(1u, barriers.imageBarriers.size());
+	CHECK(barriers.imageBarriers[0].newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
+
+TEST(RenderGraph, RejectsTwoUsagesInOnePass)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+
+	RenderGraph::ResourceId draws = graph.ImportBuffer("Draws");
+	RenderGraph::PassId pass = fixture.AddPass("Pass", 0);
+
+	// The same usage merges into one access
+	graph.Read(pass, draws, ResourceUsage::ComputeStorage);
+	graph.Write(pass, draws, ResourceUsage::ComputeStorage);
+
+	CHECK_THROWS(graph.Read(pass, draws, ResourceUsage::IndirectArguments));
+}
+
+TEST(RenderGraph, HandsABufferToAnotherQueueFamily)
+{
+	constexpr uint32_t GRAPHICS_FAMILY = 0;
+	constexpr uint32_t COMPUTE_FAMILY = 2;
+
+	// The compute graph culls into the draw count and releases it, the graphics graph acquires it
+	GraphFixture compute(COMPUTE_FAMILY);
+	RenderGraph graphics;
+	graphics.Init(MOCK_DEVICE, GRAPHICS_FAMILY, compute.allocator);
+
+	RenderGraph::ResourceId computeCount = compute.graph.ImportBuffer("DrawCount", false);
+
+	RenderGraph::PassId clear = compute.AddPass("Clear", 0);
+	compute.graph.Write(clear, computeCount, ResourceUsage::TransferDestination);
+
+	RenderGraph::PassId cull = compute.AddPass("Cull", 1);
+	compute.graph.ReadWrite(cull, computeCount, ResourceUsage::ComputeStorage);
+
+	compute.graph.SetOutput(computeCount, ResourceUsage::IndirectArguments, GRAPHICS_FAMILY);
+	compute.graph.Compile();
+
+	RenderGraph::ResourceId graphicsCount = graphics.ImportBuffer("DrawCount", false);
+	RenderGraph::ResourceId swapchain = graphics.ImportImage("Swapchain", VK_IMAGE_ASPECT_COLOR_BIT);
+	graphics.AcquireBuffer(graphicsCount, COMPUTE_FAMILY);
+
+	RenderGraph::PassId draw = graphics.AddPass("Draw", &RecordPass, GetPassMarker(2));
+	graphics.Read(draw, graphicsCount, ResourceUsage::IndirectArguments);
+	graphics.Write(draw, swapchain, ResourceUsage::ColorAttachment);
+
+	RenderGraph::PassId overlay = graphics.AddPass("Overlay", &RecordPass, GetPassMarker(3));
+	graphics.Read(overlay, graphicsCount, ResourceUsage::IndirectArguments);
+	graphics.ReadWrite(overlay, swapchain, ResourceUsage::ColorAttachment);
+
+	graphics.SetOutput(swapchain, ResourceUsage::Present);
+	graphics.Compile();
+
+	VkBuffer buffer = CreateBuffer();
+	compute.graph.SetBuffer(computeCount, buffer);
+	graphics.SetBuffer(graphicsCount, buffer);
+
+	// Two frames, the transfer repeats every frame
+	for (uint32_t frame = 0; frame < 2; frame++)
+	{
+		VkCommandBuffer computeCommands = compute.Execute();
+
+		// The release waits for the culling writes, its destination scope is on the graphics queue
+		MockCommand barriers = GetBarriers(computeCommands, UINT32_MAX);
+		CHECK_EQUAL(1u, barriers.bufferBarriers.size());
+		const VkBufferMemoryBarrier2& release = barriers.bufferBarriers[0];
+		CHECK(release.buffer == buffer);
+		CHECK(release.srcQueueFamilyIndex == COMPUTE_FAMILY);
+		CHECK(release.dstQueueFamilyIndex == GRAPHICS_FAMILY);
+		CHECK(release.srcStageMask == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+		CHECK(release.srcAccessMask == VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+		CHECK(release.dstStageMask == VK_PIPELINE_STAGE_2_NONE);
+		CHECK(release.dstAccessMask == VK_ACCESS_2_NONE);
+
+		VkCommandBuffer graphicsCommands = CreateMockCommandBuffer();
+		graphics.Execute(graphicsCommands, compute.profiler);
+
+		// The acquire matches the release and makes the writes visible to the indirect reads,
+		// its source scope chains with the semaphore wait on the same stage
+		barriers = GetBarriers(graphicsCommands, 2);
+		CHECK_EQUAL(1u, barriers.bufferBarriers.size());
+		const VkBufferMemoryBarrier2& acquire = barriers.bufferBarriers[0];
+		CHECK(acquire.buffer == buffer);
+		CHECK(acquire.srcQueueFamilyIndex == release.srcQueueFamilyIndex);
+		CHECK(acquire.dstQueueFamilyIndex == release.dstQueueFamilyIndex);
+		CHECK(acquire.offset == release.offset);
+		CHECK(acquire.size == release.size);
+		CHECK(acquire.srcStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+		CHECK(acquire.srcAccessMask == VK_ACCESS_2_NONE);
+		CHECK(acquire.dstStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+		CHECK(acquire.dstAccessMask == VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+
+		// Acquired once, the next read on the same stage needs no barrier
+		CHECK(GetBarriers(graphicsCommands, 3).bufferBarriers.empty());
+		CHECK(GetBarriers(graphicsCommands, UINT32_MAX).bufferBarriers.empty());
+	}
+
+	graphics.Destroy();
+}
+
+TEST(RenderGraph, KeepsTheOwnershipWithinAQueueFamily)
+{
+	GraphFixture fixture;
+	RenderGraph& graph = fixture.graph;
+
+	RenderGraph::ResourceId counts = graph.ImportBuffer("Counts", false);
+	graph.AcquireBuffer(counts, 0);
+
+	RenderGraph::PassId cull = fixture.AddPass("Cull", 0);
+	graph.Write(cull, counts, ResourceUsage::ComputeStorage);
+
+	graph.SetOutput(counts, ResourceUsage::IndirectArguments, 0);
+	graph.Compile();
+
+	VkCommandBuffer commandBuffer = fixture.Execute();
+	CHECK(GetBarriers(commandBuffer, 0).bufferBarriers.empty());
+
+	// A plain barrier to the final usage, without a transfer
+	MockCommand barriers = GetBarriers(commandBuffer, UINT32_MAX);
+	CHECK_EQUAL(1u, barriers.bufferBarriers.size());
+	CHECK(barriers.bufferBarriers[0].srcQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+	CHECK(barriers.bufferBarriers[0].dstQueueFamilyIndex == VK_QUEUE_FAMILY_IGNORED);
+	CHECK(barriers.bufferBarriers[0].dstStageMask == VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT);
+	CHECK(barriers.bufferBarriers[0].dstAccessMask == VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// A minimal test registry, so the tests build wherever the renderer builds without another dependency.
+// TEST(Suite, Name) defines a case, the CHECK macros throw on the first failure of the case
+class TestRegistry
+{
+public:
+	using TestFunction = void (*)();
+
+	static void Add(const char* suite, const char* name, TestFunction function);
+
+	// Runs the cases of the suite, every case when the suite is nullptr. Returns the number of failed cases
+	static uint32_t Run(const char* suite);
+};
+
+class TestRegistration
+{
+public:
+	TestRegistration(const char* suite, const char* name, TestRegistry::TestFunction function)
+	{
+		TestRegistry::Add(suite, name, function);
+	}
+};
+
+template<typename Expected, typename Actual>
+void CheckEqual(const Expected& expected, const Actual& actual, const char* expression, const char* file, int line)
+{
+	if (expected == actual)
+		return;
+
+	std::ostringstream message;
+	message << file << ":" << line << ": " << expression << " is " << actual << ", expected " << expected << "!";
+	throw std::runtime_error(message.str());
+}
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static const TestRegistration suite##_##name##_registration(#suite, #name, &suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+			throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #condition " doesn't hold!"); \
+	} while (false)
+
+#define CHECK_EQUAL(expected, actual) CheckEqual((expected), (actual), #actual, __FILE__, __LINE__)
+
+#define CHECK_THROWS(expression) \
+	do { \
+		bool thrown = false; \
+		try { expression; } catch (const std::exception&) { thrown = true; } \
+		if (!thrown) \
+			throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #expression " hasn't thrown!"); \
+	} while (false)
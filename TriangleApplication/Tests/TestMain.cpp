@@ -0,0 +1,61 @@
+#include "TestFramework.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <vector>
+
+typedef struct TestCase_t {
+	const char* suite;
+	const char* name;
+	TestRegistry::TestFunction function;
+} TestCase;
+
+// Filled by the static registrations of the other translation units, so it's constructed on first use
+static std::vector<TestCase>& GetTestCases()
+{
+	static std::vector<TestCase> testCases;
+	return testCases;
+}
+
+void TestRegistry::Add(const char* suite, const char* name, TestFunction function)
+{
+	GetTestCases().push_back({ suite, name, function });
+}
+
+uint32_t TestRegistry::Run(const char* suite)
+{
+	uint32_t ran = 0;
+	uint32_t failed = 0;
+
+	for (const TestCase& testCase : GetTestCases())
+	{
+		if (suite != nullptr && std::strcmp(testCase.suite, suite) != 0)
+			continue;
+
+		ran++;
+
+		try
+		{
+			testCase.function();
+			std::cout << "[PASSED] " << testCase.suite << "." << testCase.name << "\n";
+		}
+		catch (const std::exception& e)
+		{
+			failed++;
+			std::cout << "[FAILED] " << testCase.suite << "." << testCase.name << ": " << e.what() << "\n";
+		}
+	}
+
+	std::cout << ran - failed << " of " << ran << " tests passed\n";
+
+	// A filter matching nothing is a mistake in the test registration
+	return ran == 0 ? 1 : failed;
+}
+
+// Runs the suite named by the first argument, every suite without one
+int main(int argc, char** argv)
+{
+	return TestRegistry::Run(argc > 1 ? argv[1] : nullptr) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
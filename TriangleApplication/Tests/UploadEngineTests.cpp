@@ -0,0 +1,382 @@
+#include "TestFramework.h"
+#include "MockVulkan.h"
+#include "../UploadEngine.h"
+
+#include <cstring>
+#include <vector>
+
+static const VkQueue TRANSFER_QUEUE = reinterpret_cast<VkQueue>(uintptr_t(0x30));
+static constexpr uint32_t TRANSFER_FAMILY = 1;
+static constexpr VkDeviceSize MIB = 1ull << 20;
+
+// Every byte tells its offset apart from the neighbouring ones, the seed tells the uploads apart
+static std::vector<std::byte> MakeData(VkDeviceSize size, uint32_t seed)
+{
+	std::vector<std::byte> data(size);
+	for (VkDeviceSize i = 0; i < size; i++)
+		data[i] = std::byte((i * 31 + i / 251 + seed) & 0xFF);
+
+	return data;
+}
+
+// An engine on the transfer family of the mock device, whose GPU only finishes what the tests complete or wait for
+typedef struct UploadFixture_t {
+	DeviceAllocator allocator;
+	UploadEngine uploads;
+
+	UploadFixture_t(uint32_t queueFamilyIndex = TRANSFER_FAMILY)
+	{
+		ResetMockDevice();
+		allocator.Init(MOCK_PHYSICAL_DEVICE, MOCK_DEVICE);
+		uploads.Init(MOCK_DEVICE, allocator, TRANSFER_QUEUE, queueFamilyIndex);
+	}
+
+	~UploadFixture_t()
+	{
+		uploads.Destroy();
+		allocator.Destroy();
+	}
+
+	void Complete(UploadEngine::Ticket ticket)
+	{
+		GetMockDevice().semaphores.at(uploads.GetSemaphore()).value = ticket;
+	}
+
+	const std::vector<MockCommand>& GetCommands(uint32_t submit)
+	{
+		return GetMockCommandBuffer(GetMockDevice().submits.at(submit).commandBuffers.at(0)).commands;
+	}
+
+	// The copy commands of a submission, recorded after its barrier
+	std::vector<MockCommand> GetCopies(uint32_t submit)
+	{
+		const std::vector<MockCommand>& commands = GetCommands(submit);
+		return std::vector<MockCommand>(commands.begin() + 1, commands.end());
+	}
+
+	// Whether the ring holds the data where the region reads it
+	bool RingHolds(const MockCommand& copy, VkDeviceSize srcOffset, const std::byte* data, VkDeviceSize size)
+	{
+		MockDevice& device = GetMockDevice();
+		const MockResource& ring = device.buffers.at(copy.source);
+		const std::byte* ringData = device.memories.at(ring.memory).data.data() + ring.offset;
+
+		return std::memcmp(ringData + srcOffset, data, size) == 0;
+	}
+} UploadFixture;
+
+TEST(UploadEngine, BatchesTheCopiesPerDestination)
+{
+	UploadFixture fixture;
+	UploadEngine& uploads = fixture.uploads;
+
+	DeviceBuffer first = uploads.CreateBuffer(4096, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	DeviceBuffer second = uploads.CreateBuffer(4096, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	VkImage image = (VkImage)(uintptr_t)0x7000;
+
+	std::vector<std::byte> data = MakeData(1000, 0);
+
+	// Every upload is queued for the next flush
+	CHECK_EQUAL(1u, uploads.UploadBuffer(data.data(), 100, first.buffer, 0));
+	CHECK_EQUAL(1u, uploads.UploadBuffer(data.data() + 100, 7, second.buffer, 64));
+	CHECK_EQUAL(1u, uploads.UploadBuffer(data.data() + 107, 300, first.buffer, 1000));
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 12345;
+	region.imageExtent = { 4, 4, 1 };
+	CHECK_EQUAL(1u, uploads.UploadImage(data.data() + 407, 64, image, region));
+
+	CHECK(GetMockDevice().submits.empty());
+	CHECK_EQUAL(1u, uploads.Flush());
+
+	// One submission signaling the ticket on the engine's timeline
+	MockDevice& device = GetMockDevice();
+	CHECK_EQUAL(1u, device.submits.size());
+	CHECK(device.submits[0].queue == TRANSFER_QUEUE);
+	CHECK(device.submits[0].signalSemaphores == std::vector<VkSemaphore>({ uploads.GetSemaphore() }));
+	CHECK(device.submits[0].signalValues == std::vector<uint64_t>({ 1 }));
+
+	// A command per destination with a region per copy, every region 16-byte aligned in the ring
+	const std::vector<MockCommand>& copies = fixture.GetCopies(0);
+	CHECK_EQUAL(3u, copies.size());
+
+	for (const MockCommand& copy : copies)
+	{
+		if (copy.type == MockCommandType::CopyBufferToImage)
+		{
+			CHECK(copy.image == image);
+			CHECK_EQUAL(1u, copy.imageRegions.size());
+			CHECK_EQUAL(0u, copy.imageRegions[0].bufferOffset % UploadEngine::COPY_ALIGNMENT);
+			CHECK_EQUAL(4u, copy.imageRegions[0].imageExtent.width);
+			CHECK(fixture.RingHolds(copy, copy.imageRegions[0].bufferOffset, data.data() + 407, 64));
+			continue;
+		}
+
+		CHECK(copy.type == MockCommandType::CopyBuffer);
+		CHECK_EQUAL(copy.buffer == first.buffer ? 2u : 1u, copy.bufferRegions.size());
+
+		for (const VkBufferCopy& bufferRegion : copy.bufferRegions)
+		{
+			CHECK_EQUAL(0u, bufferRegion.srcOffset % UploadEngine::COPY_ALIGNMENT);
+
+			const std::byte* source = bufferRegion.dstOffset == 0 ? data.data() : bufferRegion.dstOffset == 64 ? data.data() + 100 : data.data() + 107;
+			CHECK(fixture.RingHolds(copy, bufferRegion.srcOffset, source, bufferRegion.size));
+		}
+	}
+
+	const UploadEngine::Stats& stats = uploads.GetStats();
+	CHECK_EQUAL(4u, stats.copies);
+	CHECK_EQUAL(3u, stats.commands);
+	CHECK_EQUAL(1u, stats.submits);
+	CHECK_EQUAL(471u, stats.bytes);
+	CHECK_EQUAL(0u, stats.ringStalls);
+
+	// Nothing queued, nothing submitted
+	CHECK_EQUAL(1u, uploads.Flush());
+	CHECK_EQUAL(1u, device.submits.size());
+
+	CHECK(!uploads.IsComplete(1));
+	fixture.Complete(1);
+	CHECK(uploads.IsComplete(1));
+
+	uploads.DestroyBuffer(first);
+	uploads.DestroyBuffer(second);
+}
+
+TEST(UploadEngine, FlushesBeforeCopyingOverAQueuedCopy)
+{
+	UploadFixture fixture;
+	UploadEngine& uploads = fixture.uploads;
+
+	DeviceBuffer buffer = uploads.CreateBuffer(4096, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	VkImage image = (VkImage)(uintptr_t)0x7000;
+	std::vector<std::byte> data = MakeData(1024, 4);
+
+	// Next to each other, both go into the same command
+	CHECK_EQUAL(1u, uploads.UploadBuffer(data.data(), 100, buffer.buffer, 0));
+	CHECK_EQUAL(1u, uploads.UploadBuffer(data.data() + 100, 100, buffer.buffer, 100));
+
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { 4, 4, 1 };
+	CHECK_EQUAL(1u, uploads.UploadImage(data.data(), 64, image, region));
+
+	// Another mip level of the image doesn't overlap either
+	VkBufferImageCopy mipRegion = region;
+	mipRegion.imageSubresource.mipLevel = 1;
+	CHECK_EQUAL(1u, uploads.UploadImage(data.data() + 64, 64, image, mipRegion));
+	CHECK(GetMockDevice().submits.empty());
+
+	// Rewriting the end of the first copy submits the queued copies
+	CHECK_EQUAL(2u, uploads.UploadBuffer(data.data() + 200, 100, buffer.buffer, 50));
+	CHECK_EQUAL(1u, GetMockDevice().submits.size());
+
+	// The same for the texels of an image
+	VkBufferImageCopy overlapping = region;
+	overlapping.imageOffset = { 2, 2, 0 };
+	CHECK_EQUAL(2u, uploads.UploadImage(data.data() + 128, 64, image, region));
+	CHECK_EQUAL(3u, uploads.UploadImage(data.data() + 192, 64, image, overlapping));
+	CHECK_EQUAL(3u, uploads.Flush());
+
+	MockDevice& device = GetMockDevice();
+	CHECK_EQUAL(3u, device.submits.size());
+
+	// Every flush waits for the copies of the earlier ones, so the last upload wins
+	for (uint32_t submit = 0; submit < 3; submit++)
+	{
+		const MockCommand& barrier = fixture.GetCommands(submit).at(0);
+		CHECK(barrier.type == MockCommandType::PipelineBarrier);
+		CHECK_EQUAL(1u, barrier.memoryBarriers.size());
+		CHECK_EQUAL(VK_ACCESS_2_TRANSFER_WRITE_BIT, barrier.memoryBarriers[0].srcAccessMask);
+		CHECK_EQUAL(VK_ACCESS_2_TRANSFER_WRITE_BIT, barrier.memoryBarriers[0].dstAccessMask);
+	}
+
+	std::vector<MockCommand> first = fixture.GetCopies(0);
+	CHECK_EQUAL(2u, first.size());
+
+	for (const MockCommand& copy : first)
+		CHECK_EQUAL(2u, copy.type == MockCommandType::CopyBuffer ? copy.bufferRegions.size() : copy.imageRegions.size());
+
+	std::vector<MockCommand> second = fixture.GetCopies(1);
+	CHECK_EQUAL(2u, second.size());
+	CHECK_EQUAL(50u, second.at(0).bufferRegions.at(0).dstOffset);
+	CHECK_EQUAL(0, second.at(1).imageRegions.at(0).imageOffset.x);
+
+	std::vector<MockCommand> third = fixture.GetCopies(2);
+	CHECK_EQUAL(1u, third.size());
+	CHECK_EQUAL(2, third.at(0).imageRegions.at(0).imageOffset.x);
+
+	uploads.DestroyBuffer(buffer);
+}
+
+TEST(UploadEngine, SkipsTheEndOfTheRingRatherThanWrapping)
+{
+	UploadFixture fixture;
+	UploadEngine& uploads = fixture.uploads;
+
+	DeviceBuffer buffer = uploads.CreateBuffer(64 * MIB, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	std::vector<std::byte> data = MakeData(12 * MIB, 1);
+
+	uploads.UploadBuffer(data.data(), 12 * MIB, buffer.buffer, 0);
+	uploads.UploadBuffer(data.data(), 12 * MIB, buffer.buffer, 12 * MIB);
+	fixture.Complete(uploads.Flush());
+
+	// 8 MiB are left at the end of the ring, the next 12 MiB go to the start, freed by the first flush
+	uploads.UploadBuffer(data.data(), 12 * MIB, buffer.buffer, 24 * MIB);
+	uploads.Flush();
+
+	MockCommand copy = fixture.GetCopies(1).at(0);
+	CHECK_EQUAL(1u, copy.bufferRegions.size());
+	CHECK_EQUAL(0u, copy.bufferRegions[0].srcOffset);
+	CHECK_EQUAL(12 * MIB, copy.bufferRegions[0].size);
+	CHECK(fixture.RingHolds(copy, 0, data.data(), 12 * MIB));
+
+	// The GPU was done with the space, nobody waited
+	CHECK_EQUAL(0u, uploads.GetStats().ringStalls);
+	CHECK_EQUAL(0u, GetMockDevice().waitCount);
+
+	uploads.DestroyBuffer(buffer);
+}
+
+TEST(UploadEngine, WaitsForTheOldestFlushWhenTheRingIsFull)
+{
+	UploadFixture fixture;
+	UploadEngine& uploads = fixture.uploads;
+
+	DeviceBuffer buffer = uploads.CreateBuffer(64 * MIB, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	std::vector<std::byte> data = MakeData(12 * MIB, 2);
+
+	CHECK_EQUAL(1u, uploads.UploadBuffer(data.data(), 12 * MIB, buffer.buffer, 0));
+	uploads.Flush();
+	CHECK_EQUAL(2u, uploads.UploadBuffer(data.data(), 12 * MIB, buffer.buffer, 12 * MIB));
+	uploads.Flush();
+
+	// The padded 12 MiB only fit once the first flush, and only that one, is done
+	CHECK_EQUAL(3u, uploads.UploadBuffer(data.data(), 12 * MIB, buffer.buffer, 24 * MIB));
+
+	CHECK_EQUAL(1u, uploads.GetStats().ringStalls);
+	CHECK_EQUAL(1u, GetMockDevice().waitCount);
+	CHECK(uploads.IsComplete(1));
+	CHECK(!uploads.IsComplete(2));
+
+	uploads.Flush();
+	CHECK_EQUAL(0u, fixture.GetCopies(2).at(0).bufferRegions.at(0).srcOffset);
+
+	uploads.DestroyBuffer(buffer);
+}
+
+TEST(UploadEngine, SplitsLargeUploadsAndFlushesTheQueuedCopiesToWaitForThem)
+{
+	UploadFixture fixture;
+	UploadEngine& uploads = fixture.uploads;
+
+	DeviceBuffer buffer = uploads.CreateBuffer(40 * MIB, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	std::vector<std::byte> data = MakeData(40 * MIB, 3);
+
+	// Half ring pieces: 16 MiB and 16 MiB fill the ring while they're still queued, so the last 8 MiB
+	// have to flush them and wait for them
+	UploadEngine::Ticket ticket = uploads.UploadBuffer(data.data(), 40 * MIB, buffer.buffer, 0);
+	CHECK_EQUAL(2u, ticket);
+
+	MockDevice& device = GetMockDevice();
+	CHECK_EQUAL(1u, device.submits.size());
+	CHECK_EQUAL(1u, uploads.GetStats().ringStalls);
+	CHECK_EQUAL(1u, device.waitCount);
+
+	MockCommand flushed = fixture.GetCopies(0).at(0);
+	CHECK_EQUAL(2u, flushed.bufferRegions.size());
+	CHECK_EQUAL(0u, flushed.bufferRegions[0].dstOffset);
+	CHECK_EQUAL(16 * MIB, flushed.bufferRegions[0].size);
+	CHECK_EQUAL(16 * MIB, flushed.bufferRegions[1].dstOffset);
+	CHECK_EQUAL(16 * MIB, flushed.bufferRegions[1].srcOffset);
+
+	CHECK_EQUAL(ticket, uploads.Flush());
+
+	MockCommand last = fixture.GetCopies(1).at(0);
+	CHECK_EQUAL(1u, last.bufferRegions.size());
+	CHECK_EQUAL(0u, last.bufferRegions[0].srcOffset);
+	CHECK_EQUAL(32 * MIB, last.bufferRegions[0].dstOffset);
+	CHECK_EQUAL(8 * MIB, last.bufferRegions[0].size);
+	CHECK(fixture.RingHolds(last, 0, data.data() + 32 * MIB, 8 * MIB));
+
+	CHECK_EQUAL(3u, uploads.GetStats().copies);
+	CHECK_EQUAL(40 * MIB, uploads.GetStats().bytes);
+
+	uploads.DestroyBuffer(buffer);
+}
+
+TEST(UploadEngine, SubmitsAFullBatchRightAway)
+{
+	UploadFixture fixture;
+	UploadEngine& uploads = fixture.uploads;
+
+	DeviceBuffer buffer = uploads.CreateBuffer(MIB, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	uint32_t value = 0;
+
+	for (uint32_t i = 0; i <= UploadEngine::MAX_COPIES; i++)
+		uploads.UploadBuffer(&value, sizeof(value), buffer.buffer, i * sizeof(value));
+
+	CHECK_EQUAL(1u, GetMockDevice().submits.size());
+	CHECK_EQUAL(UploadEngine::MAX_COPIES, fixture.GetCopies(0).at(0).bufferRegions.size());
+
+	uploads.Flush();
+	CHECK_EQUAL(1u, fixture.GetCopies(1).at(0).bufferRegions.size());
+
+	uploads.DestroyBuffer(buffer);
+}
+
+TEST(UploadEngine, RejectsAnImageLargerThanHalfTheRing)
+{
+	UploadFixture fixture;
+
+	VkBufferImageCopy region{};
+	CHECK_THROWS(fixture.uploads.UploadImage(nullptr, UploadEngine::RING_SIZE / 2 + 1, (VkImage)(uintptr_t)0x7000, region));
+}
+
+TEST(UploadEngine, SharesTheBuffersWithAnotherFamilyOnly)
+{
+	// On the transfer family the buffers are shared with the graphics family
+	{
+		UploadFixture fixture(TRANSFER_FAMILY);
+
+		DeviceBuffer buffer = fixture.uploads.CreateBuffer(256, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0);
+		CHECK(GetMockDevice().buffers.at(buffer.buffer).queueFamilies == std::vector<uint32_t>({ TRANSFER_FAMILY, 0 }));
+		fixture.uploads.DestroyBuffer(buffer);
+	}
+
+	// The fallback without a transfer family runs on the graphics family itself
+	{
+		UploadFixture fixture(0);
+
+		DeviceBuffer buffer = fixture.uploads.CreateBuffer(256, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 0);
+		CHECK(GetMockDevice().buffers.at(buffer.buffer).queueFamilies.empty());
+		fixture.uploads.DestroyBuffer(buffer);
+
+		CHECK(GetMockDevice().commandPools.at(0)->queueFamilyIndex == 0);
+	}
+}
+
+TEST(UploadEngine, WaitsForTheSubmittedCopiesOnDestroy)
+{
+	UploadFixture fixture;
+	UploadEngine& uploads = fixture.uploads;
+
+	DeviceBuffer buffer = uploads.CreateBuffer(MIB, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	uint32_t value = 0;
+
+	uploads.UploadBuffer(&value, sizeof(value), buffer.buffer, 0);
+	uploads.Flush();
+	uploads.DestroyBuffer(buffer);
+
+	// Queued, never submitted
+	uploads.UploadBuffer(&value, sizeof(value), buffer.buffer, 0);
+
+	uploads.Destroy();
+
+	MockDevice& device = GetMockDevice();
+	CHECK_EQUAL(1u, device.waitCount);
+	CHECK_EQUAL(1u, device.submits.size());
+	CHECK(device.semaphores.empty());
+	CHECK(device.buffers.empty());
+	CHECK_EQUAL(0u, device.commandPoolCount);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single producer, single consumer handoff of the latest value.
+// The producer and the consumer own one buffer each, the third one is exchanged between them,
+// so neither side ever waits and the consumer always reads the newest complete value.
+template<typename T>
+class TripleBuffer
+{
+public:
+	// Called only by the producer thread
+	void Publish(const T& value) noexcept
+	{
+		m_Buffers[m_WriteIndex] = value;
+
+		uint8_t previous = m_Shared.exchange(static_cast<uint8_t>(m_WriteIndex | FRESH_BIT), std::memory_order_acq_rel);
+		m_WriteIndex = previous & INDEX_MASK;
+	}
+
+	// Called only by the consumer thread, returns the previous value if nothing new has been published
+	const T& Consume() noexcept
+	{
+		if (m_Shared.load(std::memory_order_relaxed) & FRESH_BIT)
+		{
+			uint8_t previous = m_Shared.exchange(m_ReadIndex, std::memory_order_acq_rel);
+			m_ReadIndex = previous & INDEX_MASK;
+		}
+
+		return m_Buffers[m_ReadIndex];
+	}
+private:
+	static constexpr uint8_t INDEX_MASK = 0x3;
+	static constexpr uint8_t FRESH_BIT = 0x4;
+
+	T m_Buffers[3]{};
+
+	alignas(64) std::atomic<uint8_t> m_Shared{ 1 };
+	alignas(64) uint8_t m_WriteIndex = 0;
+	alignas(64) uint8_t m_ReadIndex = 2;
+};
@@ -0,0 +1,387 @@
+#include "UploadEngine.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// The largest piece of a buffer upload, so a piece always fits the ring next to the wasted end of the ring
+static constexpr VkDeviceSize MAX_PIECE = UploadEngine::RING_SIZE / 2;
+
+void UploadEngine::Init(VkDevice device, DeviceAllocator& allocator, VkQueue queue, uint32_t queueFamilyIndex,
+						const VkAllocationCallbacks* callbacks)
+{
+	m_Device = device;
+	m_Allocator = &allocator;
+	m_Queue = queue;
+	m_QueueFamilyIndex = queueFamilyIndex;
+	m_Callbacks = callbacks;
+
+	VkCommandPoolCreateInfo commandPoolInfo{};
+	commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolInfo.queueFamilyIndex = queueFamilyIndex;
+
+	if (vkCreateCommandPool(m_Device, &commandPoolInfo, m_Callbacks, &m_CommandPool) != VK_SUCCESS)
+		throw std::runtime_error("The upload command pool hasn't been created!");
+
+	VkCommandBufferAllocateInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = m_CommandPool;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
+
+	for (auto& batch : m_Batches)
+	{
+		if (vkAllocateCommandBuffers(m_Device, &commandBufferInfo, &batch.commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("The upload command buffers haven't been created!");
+	}
+
+	m_Timeline.Init(m_Device, m_Callbacks);
+
+	// Coherent, so the copies into the ring never have to be flushed
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = RING_SIZE;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(m_Device, &bufferInfo, m_Callbacks, &m_Ring.buffer) != VK_SUCCESS)
+		throw std::runtime_error("The upload ring hasn't been created!");
+
+	m_Ring.size = RING_SIZE;
+	m_Ring.allocation = m_Allocator->AllocateBuffer(m_Ring.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	m_RingData = static_cast<std::byte*>(m_Ring.allocation.mapped);
+
+	m_BufferCopies.reserve(MAX_COPIES);
+	m_ImageCopies.reserve(MAX_COPIES);
+	m_BufferRegions.reserve(MAX_COPIES);
+	m_ImageRegions.reserve(MAX_COPIES);
+}
+
+void UploadEngine::Destroy() noexcept
+{
+	if (m_Device == VK_NULL_HANDLE)
+		return;
+
+	// The queued copies are dropped, the submitted ones have to finish before the ring goes away
+	try
+	{
+		m_Timeline.WaitForFrame(m_Timeline.GetSubmittedFrame());
+	}
+	catch (...)
+	{
+		vkQueueWaitIdle(m_Queue);
+	}
+
+	DestroyBuffer(m_Ring);
+	m_RingData = nullptr;
+	m_Timeline.Destroy();
+	vkDestroyCommandPool(m_Device, m_CommandPool, m_Callbacks);
+
+	m_CommandPool = VK_NULL_HANDLE;
+	m_Batches = {};
+	m_BufferCopies.clear();
+	m_ImageCopies.clear();
+	m_Device = VK_NULL_HANDLE;
+}
+
+DeviceBuffer UploadEngine::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t sharedQueueFamily)
+{
+	uint32_t queueFamilies[] = { m_QueueFamilyIndex, sharedQueueFamily };
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (sharedQueueFamily != VK_QUEUE_FAMILY_IGNORED && sharedQueueFamily != m_QueueFamilyIndex)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = 2;
+		bufferInfo.pQueueFamilyIndices = queueFamilies;
+	}
+
+	DeviceBuffer buffer;
+	buffer.size = size;
+
+	if (vkCreateBuffer(m_Device, &bufferInfo, m_Callbacks, &buffer.buffer) != VK_SUCCESS)
+		throw std::runtime_error("A streamed buffer hasn't been created!");
+
+	try
+	{
+		buffer.allocation = m_Allocator->AllocateBuffer(buffer.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	}
+	catch (...)
+	{
+		vkDestroyBuffer(m_Device, buffer.buffer, m_Callbacks);
+		throw;
+	}
+
+	return buffer;
+}
+
+void UploadEngine::DestroyBuffer(DeviceBuffer& buffer) noexcept
+{
+	if (buffer.buffer == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyBuffer(m_Device, buffer.buffer, m_Callbacks);
+	m_Allocator->Free(buffer.allocation);
+	buffer = {};
+}
+
+UploadEngine::Ticket UploadEngine::UploadBuffer(const void* data, VkDeviceSize size, VkBuffer buffer, VkDeviceSize offset)
+{
+	const std::byte* source = static_cast<const std::byte*>(data);
+
+	for (VkDeviceSize done = 0; done < size;)
+	{
+		VkDeviceSize piece = std::min(size - done, MAX_PIECE);
+
+		// Rewritten bytes go into the next flush, which copies after the queued one
+		if (m_BufferCopies.size() == MAX_COPIES || IsQueued(buffer, offset + done, piece))
+			Flush();
+
+		VkDeviceSize ringOffset = Reserve(piece);
+		std::memcpy(m_RingData + ringOffset, source + done, piece);
+
+		BufferCopy copy;
+		copy.buffer = buffer;
+		copy.region.srcOffset = ringOffset;
+		copy.region.dstOffset = offset + done;
+		copy.region.size = piece;
+		m_BufferCopies.push_back(copy);
+
+		m_Stats.copies++;
+		m_Stats.bytes += piece;
+		done += piece;
+	}
+
+	return m_Timeline.GetNextFrame();
+}
+
+UploadEngine::Ticket UploadEngine::UploadImage(const void* data, VkDeviceSize size, VkImage image, const VkBufferImageCopy& region)
+{
+	// A region can't be split, it has to fit the ring at once
+	if (size > MAX_PIECE)
+		throw std::runtime_error("The image upload doesn't fit the upload ring!");
+
+	if (m_ImageCopies.size() == MAX_COPIES || IsQueued(image, region))
+		Flush();
+
+	VkDeviceSize ringOffset = Reserve(size);
+	std::memcpy(m_RingData + ringOffset, data, size);
+
+	ImageCopy copy;
+	copy.image = image;
+	copy.region = region;
+	copy.region.bufferOffset = ringOffset;
+	m_ImageCopies.push_back(copy);
+
+	m_Stats.copies++;
+	m_Stats.bytes += size;
+
+	return m_Timeline.GetNextFrame();
+}
+
+UploadEngine::Ticket UploadEngine::Flush()
+{
+	if (m_BufferCopies.empty() && m_ImageCopies.empty())
+		return m_Timeline.GetSubmittedFrame();
+
+	// Every command buffer of the batches may still be executing
+	if (m_PendingBatches == MAX_BATCHES)
+		RetireOldestBatch(true);
+
+	Batch& batch = m_Batches[(m_OldestBatch + m_PendingBatches) % MAX_BATCHES];
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vkResetCommandBuffer(batch.commandBuffer, 0);
+	if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("Can't begin recording the upload command buffer!");
+
+	// The copies of the earlier flushes may write the same bytes, submission order alone doesn't order the writes
+	VkMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.memoryBarrierCount = 1;
+	dependencyInfo.pMemoryBarriers = &barrier;
+	vkCmdPipelineBarrier2(batch.commandBuffer, &dependencyInfo);
+
+	RecordBufferCopies(batch.commandBuffer);
+	RecordImageCopies(batch.commandBuffer);
+
+	if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Can't record the upload command buffer!");
+
+	// The signal of the timeline makes the copies available to the queues waiting for the ticket
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+	batch.ticket = m_Timeline.Submit(m_Queue, submitInfo);
+	batch.ringEnd = m_Head;
+	m_PendingBatches++;
+
+	m_BufferCopies.clear();
+	m_ImageCopies.clear();
+	m_Stats.submits++;
+
+	return batch.ticket;
+}
+
+void UploadEngine::Report(std::ostream& stream) const
+{
+	stream << "[UPLOADS]: " << m_Stats.copies << " copies, " << m_Stats.bytes << " bytes in "
+		   << m_Stats.commands << " copy commands and " << m_Stats.submits << " submits, "
+		   << m_Stats.ringStalls << " waits for a full ring\n";
+}
+
+VkDeviceSize UploadEngine::Reserve(VkDeviceSize size)
+{
+	size = (size + COPY_ALIGNMENT - 1) & ~(COPY_ALIGNMENT - 1);
+
+	// A copy never wraps around the end of the ring, the rest of the ring is skipped instead
+	VkDeviceSize offset = m_Head % RING_SIZE;
+	VkDeviceSize padding = offset + size > RING_SIZE ? RING_SIZE - offset : 0;
+
+	// The oldest flushes free their space as the GPU finishes them
+	while (RetireOldestBatch(false));
+
+	while (m_Head + padding + size - m_Tail > RING_SIZE)
+	{
+		// The queued copies hold the rest of the ring, so they are flushed to be waited for
+		if (m_PendingBatches == 0)
+			Flush();
+
+		m_Stats.ringStalls++;
+		RetireOldestBatch(true);
+	}
+
+	m_Head += padding;
+	offset = m_Head % RING_SIZE;
+	m_Head += size;
+
+	return offset;
+}
+
+bool UploadEngine::RetireOldestBatch(bool wait)
+{
+	if (m_PendingBatches == 0)
+		return false;
+
+	const Batch& batch = m_Batches[m_OldestBatch];
+
+	if (wait)
+		m_Timeline.WaitForFrame(batch.ticket);
+	else if (!m_Timeline.IsFrameComplete(batch.ticket))
+		return false;
+
+	// The queue finishes the flushes in order
+	m_Tail = batch.ringEnd;
+	m_OldestBatch = (m_OldestBatch + 1) % MAX_BATCHES;
+	m_PendingBatches--;
+
+	return true;
+}
+
+bool UploadEngine::IsQueued(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) const noexcept
+{
+	return std::any_of(m_BufferCopies.begin(), m_BufferCopies.end(), [&](const BufferCopy& copy) {
+		return copy.buffer == buffer && copy.region.dstOffset < offset + size && offset < copy.region.dstOffset + copy.region.size;
+	});
+}
+
+bool UploadEngine::IsQueued(VkImage image, const VkBufferImageCopy& region) const noexcept
+{
+	auto overlaps = [](int64_t aOffset, uint32_t aSize, int64_t bOffset, uint32_t bSize) {
+		return aOffset < bOffset + bSize && bOffset < aOffset + aSize;
+	};
+
+	const VkImageSubresourceLayers& subresource = region.imageSubresource;
+
+	return std::any_of(m_ImageCopies.begin(), m_ImageCopies.end(), [&](const ImageCopy& copy) {
+		const VkImageSubresourceLayers& queued = copy.region.imageSubresource;
+
+		return copy.image == image && (queued.aspectMask & subresource.aspectMask) != 0 && queued.mipLevel == subresource.mipLevel &&
+			   overlaps(queued.baseArrayLayer, queued.layerCount, subresource.baseArrayLayer, subresource.layerCount) &&
+			   overlaps(copy.region.imageOffset.x, copy.region.imageExtent.width, region.imageOffset.x, region.imageExtent.width) &&
+			   overlaps(copy.region.imageOffset.y, copy.region.imageExtent.height, region.imageOffset.y, region.imageExtent.height) &&
+			   overlaps(copy.region.imageOffset.z, copy.region.imageExtent.depth, region.imageOffset.z, region.imageExtent.depth);
+	});
+}
+
+void UploadEngine::RecordBufferCopies(VkCommandBuffer commandBuffer)
+{
+	if (m_BufferCopies.empty())
+		return;
+
+	// The copies into the same buffer become the regions of a single command. The queued copies never overlap,
+	// so their order within the flush doesn't matter
+	std::sort(m_BufferCopies.begin(), m_BufferCopies.end(), [](const BufferCopy& a, const BufferCopy& b) {
+		return a.buffer < b.buffer;
+	});
+
+	size_t first = 0;
+
+	for (size_t i = 0; i <= m_BufferCopies.size(); i++)
+	{
+		if (i < m_BufferCopies.size() && m_BufferCopies[i].buffer == m_BufferCopies[first].buffer)
+		{
+			m_BufferRegions.push_back(m_BufferCopies[i].region);
+			continue;
+		}
+
+		vkCmdCopyBuffer(commandBuffer, m_Ring.buffer, m_BufferCopies[first].buffer,
+						static_cast<uint32_t>(m_BufferRegions.size()), m_BufferRegions.data());
+		m_Stats.commands++;
+
+		m_BufferRegions.clear();
+		first = i;
+
+		if (i < m_BufferCopies.size())
+			m_BufferRegions.push_back(m_BufferCopies[i].region);
+	}
+}
+
+void UploadEngine::RecordImageCopies(VkCommandBuffer commandBuffer)
+{
+	if (m_ImageCopies.empty())
+		return;
+
+	std::sort(m_ImageCopies.begin(), m_ImageCopies.end(), [](const ImageCopy& a, const ImageCopy& b) {
+		return a.image < b.image;
+	});
+
+	size_t first = 0;
+
+	for (size_t i = 0; i <= m_ImageCopies.size(); i++)
+	{
+		if (i < m_ImageCopies.size() && m_ImageCopies[i].image == m_ImageCopies[first].image)
+		{
+			m_ImageRegions.push_back(m_ImageCopies[i].region);
+			continue;
+		}
+
+		vkCmdCopyBufferToImage(commandBuffer, m_Ring.buffer, m_ImageCopies[first].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+							   static_cast<uint32_t>(m_ImageRegions.size()), m_ImageRegions.data());
+		m_Stats.commands++;
+
+		m_ImageRegions.clear();
+		first = i;
+
+		if (i < m_ImageCopies.size())
+			m_ImageRegions.push_back(m_ImageCopies[i].region);
+	}
+}
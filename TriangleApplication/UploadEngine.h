@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "DeviceAllocator.h"
+#include "FrameScheduler.h"
+#include "StagingUploader.h"
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Streams data into buffers and images on a transfer queue while the graphics queue keeps rendering.
+// The data is copied into a persistently mapped staging ring and the copy is queued, Flush then records every
+// queued copy into one command buffer: a single vkCmdCopyBuffer or vkCmdCopyBufferToImage per destination,
+// with a region per copy. Every flush signals the next value of a timeline semaphore, its ticket,
+// and the ring space of a flush is reused once its ticket is reached.
+// An upload overlapping a queued copy into the same destination flushes the queued copies first, the regions
+// of a command must not overlap. Every flush waits for the copies of the earlier ones, so the last upload wins.
+// The destinations have to be owned by the transfer queue family or shared concurrently with it, no queue family
+// ownership transfers are recorded, so an EXCLUSIVE image used by another family can't be uploaded.
+// Not thread safe, the submissions have to be externally synchronized when the queue is shared.
+class UploadEngine
+{
+public:
+	static constexpr VkDeviceSize RING_SIZE = 32ull << 20;
+	// Covers the texel blocks whose size is a power of two up to 16 bytes. The 3-, 6-, 12- and 24-byte formats
+	// need an offset that is a multiple of their texel size, so they can't be uploaded as images
+	static constexpr VkDeviceSize COPY_ALIGNMENT = 16;
+	static constexpr uint32_t MAX_BATCHES = 8;          // Flushes in flight, each with its own command buffer
+	static constexpr uint32_t MAX_COPIES = 1024;        // Per flush, a full flush is submitted right away
+
+	using Ticket = uint64_t;
+
+	typedef struct Stats_t {
+		uint64_t copies = 0;
+		uint64_t commands = 0; // vkCmdCopyBuffer and vkCmdCopyBufferToImage
+		uint64_t submits = 0;
+		VkDeviceSize bytes = 0;
+		uint64_t ringStalls = 0; // Waits for the GPU because the ring was full
+	} Stats;
+
+	UploadEngine() = default;
+	UploadEngine(const UploadEngine&) = delete;
+	UploadEngine& operator=(const UploadEngine&) = delete;
+
+	void Init(VkDevice device, DeviceAllocator& allocator, VkQueue queue, uint32_t queueFamilyIndex,
+			  const VkAllocationCallbacks* callbacks = nullptr);
+	void Destroy() noexcept;
+
+	// A device local buffer the engine can fill, shared concurrently with the queue family using it
+	DeviceBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, uint32_t sharedQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+	void DestroyBuffer(DeviceBuffer& buffer) noexcept;
+
+	// Copies the data into the ring and queues its copy, waits for the GPU when the ring is full.
+	// Returns the ticket of the flush that will copy it, larger buffer uploads are split over several flushes
+	Ticket UploadBuffer(const void* data, VkDeviceSize size, VkBuffer buffer, VkDeviceSize offset);
+
+	// The image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, the buffer offset of the region is ignored
+	Ticket UploadImage(const void* data, VkDeviceSize size, VkImage image, const VkBufferImageCopy& region);
+
+	// Submits the queued copies, returns the ticket of the last flush when nothing is queued
+	Ticket Flush();
+
+	inline bool IsComplete(Ticket ticket) const { return m_Timeline.IsFrameComplete(ticket); }
+	inline void Wait(Ticket ticket) const { m_Timeline.WaitForFrame(ticket); }
+	inline Ticket GetCompletedTicket() const { return m_Timeline.GetCompletedFrame(); }
+
+	// Other queues wait for a ticket on it before they read the data
+	inline VkSemaphore GetSemaphore() const noexcept { return m_Timeline.GetSemaphore(); }
+
+	inline const Stats& GetStats() const noexcept { return m_Stats; }
+	inline void ResetStats() noexcept { m_Stats = {}; }
+
+	void Report(std::ostream& stream) const;
+private:
+	typedef struct BufferCopy_t {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkBufferCopy region{};
+	} BufferCopy;
+
+	typedef struct ImageCopy_t {
+		VkImage image = VK_NULL_HANDLE;
+		VkBufferImageCopy region{};
+	} ImageCopy;
+
+	typedef struct Batch_t {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		Ticket ticket = 0;
+		uint64_t ringEnd = 0; // The ring is free up to here once the ticket is reached
+	} Batch;
+
+	// Returns the offset of the space in the ring
+	VkDeviceSize Reserve(VkDeviceSize size);
+	bool RetireOldestBatch(bool wait);
+
+	// Whether a queued copy writes any part of the destination
+	bool IsQueued(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) const noexcept;
+	bool IsQueued(VkImage image, const VkBufferImageCopy& region) const noexcept;
+
+	void RecordBufferCopies(VkCommandBuffer commandBuffer);
+	void RecordImageCopies(VkCommandBuffer commandBuffer);
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	DeviceAllocator* m_Allocator = nullptr;
+	VkQueue m_Queue = VK_NULL_HANDLE;
+	uint32_t m_QueueFamilyIndex = 0;
+	const VkAllocationCallbacks* m_Callbacks = nullptr;
+
+	VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+	FrameScheduler m_Timeline;
+
+	DeviceBuffer m_Ring;
+	std::byte* m_RingData = nullptr;
+	uint64_t m_Head = 0; // Both only grow, the offset in the ring is taken modulo its size
+	uint64_t m_Tail = 0;
+
+	std::array<Batch, MAX_BATCHES> m_Batches;
+	uint32_t m_OldestBatch = 0;
+	uint32_t m_PendingBatches = 0;
+
+	// The copies of the next flush, reserved up front so streaming doesn't allocate
+	std::vector<BufferCopy> m_BufferCopies;
+	std::vector<ImageCopy> m_ImageCopies;
+	std::vector<VkBufferCopy> m_BufferRegions;
+	std::vector<VkBufferImageCopy> m_ImageRegions;
+
+	Stats m_Stats;
+};
@@ -0,0 +1,777 @@
+#include "Application.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+// Renders a fixed number of frames and writes the frame time percentiles as JSON,
+// so the results of different builds can be compared by a script
+typedef struct BenchmarkOptions_t {
+	ApplicationOptions application;
+	uint32_t warmupFrames = 100;
+	uint32_t frames = 1000;
+	std::string output = "benchmark.json"; // "-" writes to the standard output
+	bool upload = false;
+	uint32_t uploadRepetitions = 5;
+	bool uploadStream = false;
+	uint32_t uploadStreamFrames = 300;
+	bool drawScaling = false;
+	uint32_t drawScalingFrames = 100;
+	bool recordScaling = false;
+	uint32_t recordScalingDraws = 16384;
+	bool jobs = false;
+	bool commandCaching = false;
+} BenchmarkOptions;
+
+// The upload of a grid mesh, the best of the repetitions is the throughput of the path
+typedef struct UploadResult_t {
+	uint32_t vertices = 0;
+	VkDeviceSize bytes = 0;
+	double bestSeconds = 0.0;
+	double meanSeconds = 0.0;
+} UploadResult;
+
+// The uploads streamed through the transfer queue while rendering
+typedef struct StreamingResult_t {
+	StreamingTimings timings;
+	FrameStats::Summary latency;
+	FrameStats::Summary record;
+	FrameStats::Summary gpu;
+} StreamingResult;
+
+// The recording cost of a draw path at an instance count
+typedef struct DrawScalingResult_t {
+	DrawPath drawPath = DrawPath::Instanced;
+	uint32_t instances = 0;
+	FrameStats::Summary record;
+	FrameStats::Summary gpu;
+} DrawScalingResult;
+
+// The recording time of the per-object draws at a recording thread count
+typedef struct RecordScalingResult_t {
+	uint32_t threads = 0;
+	uint32_t draws = 0;
+	FrameStats::Summary record;
+} RecordScalingResult;
+
+// The CPU cost of a frame with the commands recorded every frame or submitted again from the cache
+typedef struct CommandCachingResult_t {
+	bool cached = false;
+	uint32_t draws = 0;
+	FrameStats::Summary cpu;
+	FrameStats::Summary record;
+} CommandCachingResult;
+
+// The time of a fixed CPU workload split into jobs at a thread count
+typedef struct JobScalingResult_t {
+	uint32_t threads = 0;
+	double milliseconds = 0.0;
+} JobScalingResult;
+
+// The overheads of the job system, measured without the renderer
+typedef struct JobBenchmarkResult_t {
+	double spawnNanoseconds = 0.0; // Queuing and running an empty job on the submitting thread alone
+	double stealNanoseconds = 0.0; // The same while the workers steal the jobs
+	uint32_t workers = 0;
+	std::vector<JobScalingResult> scaling;
+} JobBenchmarkResult;
+
+// The meshes grow from 1K to 4M vertices
+static constexpr uint32_t MIN_UPLOAD_GRID = 32;
+static constexpr uint32_t MAX_UPLOAD_GRID = 2048;
+
+// Dozens of uploads of mixed sizes per frame
+static constexpr VkDeviceSize STREAMING_BYTES_PER_FRAME = 8ull << 20;
+
+// The instance counts grow from 1K to 1M
+static constexpr uint32_t MIN_SCALING_INSTANCES = 1024;
+static constexpr uint32_t MAX_SCALING_INSTANCES = 1024 * 1024;
+static constexpr uint32_t SCALING_WARMUP_FRAMES = 10;
+
+// The empty jobs are queued in batches that fit the queue of a thread
+static constexpr uint32_t JOB_OVERHEAD_JOBS = 1 << 20;
+static constexpr uint32_t JOB_OVERHEAD_BATCH = 256;
+static constexpr uint32_t JOB_SCALING_JOBS = 1024;
+static constexpr uint32_t JOB_SCALING_ITERATIONS = 20000; // Tens of microseconds of work per job
+static constexpr uint32_t JOB_REPETITIONS = 5;
+
+static const char* GetPresentModeName(VkPresentModeKHR presentMode) noexcept
+{
+	switch (presentMode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:    return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR:      return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR:         return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo_relaxed";
+	default:                               return "unknown";
+	}
+}
+
+static std::optional<VkPresentModeKHR> ParsePresentMode(const char* name) noexcept
+{
+	for (auto presentMode : { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR })
+	{
+		if (std::strcmp(name, GetPresentModeName(presentMode)) == 0)
+			return presentMode;
+	}
+
+	std::cerr << "Unknown present mode " << name << ", using the default one\n";
+	return std::nullopt;
+}
+
+static DrawPath ParseDrawPath(const char* name) noexcept
+{
+	for (auto drawPath : { DrawPath::Instanced, DrawPath::PerObject, DrawPath::GpuDriven })
+	{
+		if (std::strcmp(name, GetDrawPathName(drawPath)) == 0)
+			return drawPath;
+	}
+
+	std::cerr << "Unknown draw path " << name << ", using the instanced draw\n";
+	return DrawPath::Instanced;
+}
+
+static BenchmarkOptions ParseOptions(int argc, char** argv)
+{
+	BenchmarkOptions options{};
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+			options.application.width = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+			options.application.height = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc)
+			options.application.presentMode = ParsePresentMode(argv[++i]);
+		else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+			options.application.framesInFlight = static_cast<uint32_t>(std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--headless") == 0)
+			options.application.headless = true;
+		else if (std::strcmp(argv[i], "--warmup-frames") == 0 && i + 1 < argc)
+			options.warmupFrames = static_cast<uint32_t>(std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+			options.output = argv[++i];
+		else if (std::strcmp(argv[i], "--gpu-trace") == 0 && i + 1 < argc)
+			options.application.gpuTracePath = argv[++i];
+		else if (std::strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc)
+			options.application.cpuTracePath = argv[++i];
+		else if (std::strcmp(argv[i], "--timeline") == 0 && i + 1 < argc)
+			options.application.timelinePath = argv[++i];
+		else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+			options.application.instanceCount = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+		else if (std::strcmp(argv[i], "--draw-path") == 0 && i + 1 < argc)
+			options.application.drawPath = ParseDrawPath(argv[++i]);
+		else if (std::strcmp(argv[i], "--draw-scaling") == 0)
+			options.drawScaling = true;
+		else if (std::strcmp(argv[i], "--draw-scaling-frames") == 0 && i + 1 < argc)
+			options.drawScalingFrames = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+		else if (std::strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc)
+			options.application.recordThreads = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+		else if (std::strcmp(argv[i], "--async-compute") == 0)
+			options.application.asyncCompute = true;
+		else if (std::strcmp(argv[i], "--cached-commands") == 0)
+			options.application.cachedCommands = true;
+		else if (std::strcmp(argv[i], "--command-caching") == 0)
+			options.commandCaching = true;
+		else if (std::strcmp(argv[i], "--record-scaling") == 0)
+			options.recordScaling = true;
+		else if (std::strcmp(argv[i], "--record-scaling-draws") == 0 && i + 1 < argc)
+			options.recordScalingDraws = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+		else if (std::strcmp(argv[i], "--jobs") == 0)
+			options.jobs = true;
+		else if (std::strcmp(argv[i], "--upload") == 0)
+			options.upload = true;
+		else if (std::strcmp(argv[i], "--upload-repetitions") == 0 && i + 1 < argc)
+			options.uploadRepetitions = std::max(1, std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--upload-stream") == 0)
+			options.uploadStream = true;
+		else if (std::strcmp(argv[i], "--upload-stream-frames") == 0 && i + 1 < argc)
+			options.uploadStreamFrames = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+	}
+
+	return options;
+}
+
+static std::vector<UploadResult> RunUploadBenchmark(Application& app, uint32_t repetitions)
+{
+	std::vector<UploadResult> results;
+
+	for (uint32_t side = MIN_UPLOAD_GRID; side <= MAX_UPLOAD_GRID; side *= 2)
+	{
+		Mesh mesh = CreateGridMesh(side, side);
+
+		// The first upload of a size may have to reserve new device memory blocks
+		app.MeasureMeshUpload(mesh);
+
+		UploadResult result;
+		result.vertices = side * side;
+
+		double totalSeconds = 0.0;
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			UploadTimings timings = app.MeasureMeshUpload(mesh);
+
+			result.bytes = timings.bytes;
+			result.bestSeconds = i == 0 ? timings.seconds : std::min(result.bestSeconds, timings.seconds);
+			totalSeconds += timings.seconds;
+		}
+
+		result.meanSeconds = totalSeconds / repetitions;
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+static StreamingResult RunStreamingBenchmark(Application& app, uint32_t frames)
+{
+	// The first uploads fill the ring and the destination memory
+	app.MeasureStreamingUploads(SCALING_WARMUP_FRAMES, STREAMING_BYTES_PER_FRAME);
+
+	StreamingResult result;
+	result.timings = app.MeasureStreamingUploads(frames, STREAMING_BYTES_PER_FRAME);
+	result.latency = FrameStats::Summarize(result.timings.latencies);
+	result.record = result.timings.frames.Summarize(&FrameTimings::record);
+	result.gpu = result.timings.frames.Summarize(&FrameTimings::gpu);
+
+	app.WaitIdle();
+	return result;
+}
+
+// Renders a few frames to settle the new configuration first, returns with the device idle
+static FrameStats MeasureFrames(Application& app, uint32_t frames)
+{
+	using Clock = std::chrono::steady_clock;
+
+	for (uint32_t i = 0; i < SCALING_WARMUP_FRAMES && !app.ShouldClose(); i++)
+		app.RenderFrame();
+
+	FrameStats stats;
+	stats.Reserve(frames);
+
+	auto frameStart = Clock::now();
+
+	for (uint32_t i = 0; i < frames && !app.ShouldClose(); i++)
+	{
+		FrameTimings timings = app.RenderFrame();
+
+		auto now = Clock::now();
+		timings.cpu = std::chrono::duration<double, std::milli>(now - frameStart).count();
+		frameStart = now;
+
+		stats.Add(timings);
+	}
+
+	app.WaitIdle();
+	return stats;
+}
+
+static std::vector<DrawScalingResult> RunDrawScalingBenchmark(Application& app, uint32_t frames)
+{
+	std::vector<DrawScalingResult> results;
+
+	DrawPath initialPath = app.GetDrawPath();
+	uint32_t initialCount = app.GetInstanceCount();
+
+	for (auto drawPath : { DrawPath::Instanced, DrawPath::PerObject, DrawPath::GpuDriven })
+	{
+		if (!app.SetDrawPath(drawPath))
+		{
+			std::cerr << "The " << GetDrawPathName(drawPath) << " draw path isn't supported, skipping it\n";
+			continue;
+		}
+
+		for (uint32_t count = MIN_SCALING_INSTANCES; count <= MAX_SCALING_INSTANCES && !app.ShouldClose(); count *= 4)
+		{
+			app.SetInstanceCount(count);
+			FrameStats stats = MeasureFrames(app, frames);
+
+			DrawScalingResult result;
+			result.drawPath = drawPath;
+			result.instances = count;
+			result.record = stats.Summarize(&FrameTimings::record);
+			result.gpu = stats.Summarize(&FrameTimings::gpu);
+			results.push_back(result);
+		}
+	}
+
+	app.SetDrawPath(initialPath);
+	app.SetInstanceCount(initialCount);
+
+	return results;
+}
+
+static std::vector<RecordScalingResult> RunRecordScalingBenchmark(Application& app, uint32_t draws, uint32_t frames)
+{
+	std::vector<RecordScalingResult> results;
+
+	DrawPath initialPath = app.GetDrawPath();
+	uint32_t initialCount = app.GetInstanceCount();
+	uint32_t initialThreads = app.GetRecordThreads();
+
+	app.SetDrawPath(DrawPath::PerObject);
+	app.SetInstanceCount(draws);
+
+	// A single thread records inline into the primary command buffer, the baseline of the others
+	uint32_t maxThreads = std::clamp(std::thread::hardware_concurrency(), 1u, ParallelRecorder::MAX_CHUNKS);
+
+	for (uint32_t threads = 1; threads <= maxThreads && !app.ShouldClose(); threads *= 2)
+	{
+		app.SetRecordThreads(threads);
+		FrameStats stats = MeasureFrames(app, frames);
+
+		RecordScalingResult result;
+		result.threads = threads;
+		result.draws = draws;
+		result.record = stats.Summarize(&FrameTimings::record);
+		results.push_back(result);
+	}
+
+	app.SetRecordThreads(initialThreads);
+	app.SetDrawPath(initialPath);
+	app.SetInstanceCount(initialCount);
+
+	return results;
+}
+
+static std::vector<CommandCachingResult> RunCommandCachingBenchmark(Application& app, uint32_t draws, uint32_t frames)
+{
+	std::vector<CommandCachingResult> results;
+
+	DrawPath initialPath = app.GetDrawPath();
+	uint32_t initialCount = app.GetInstanceCount();
+	uint32_t initialThreads = app.GetRecordThreads();
+	bool initialCached = app.IsCachingCommands();
+
+	// The per-object draws make the recording expensive enough to measure what the cache saves.
+	// The cached command buffers record their draws inline, so the uncached frames record on one thread too
+	app.SetDrawPath(DrawPath::PerObject);
+	app.SetInstanceCount(draws);
+	app.SetRecordThreads(1);
+
+	for (bool cached : { false, true })
+	{
+		if (app.ShouldClose())
+			break;
+
+		// The warmup frames of the measurement record every slot and image once
+		app.SetCachedCommands(cached);
+		FrameStats stats = MeasureFrames(app, frames);
+
+		CommandCachingResult result;
+		result.cached = cached;
+		result.draws = draws;
+		result.cpu = stats.Summarize(&FrameTimings::cpu);
+		result.record = stats.Summarize(&FrameTimings::record);
+		results.push_back(result);
+	}
+
+	app.SetCachedCommands(initialCached);
+	app.SetRecordThreads(initialThreads);
+	app.SetDrawPath(initialPath);
+	app.SetInstanceCount(initialCount);
+
+	return results;
+}
+
+static void EmptyJob(void*, uint32_t) {}
+
+static void WorkJob(void* results, uint32_t index)
+{
+	// A dependent chain the compiler can't fold away
+	uint32_t value = index + 1;
+	for (uint32_t i = 0; i < JOB_SCALING_ITERATIONS; i++)
+	{
+		value ^= value << 13;
+		value ^= value >> 17;
+		value ^= value << 5;
+	}
+
+	static_cast<uint32_t*>(results)[index] = value;
+}
+
+// The best of the repetitions in seconds
+template<typename Function>
+static double MeasureBest(Function function)
+{
+	using Clock = std::chrono::steady_clock;
+
+	double best = 0.0;
+
+	for (uint32_t repetition = 0; repetition < JOB_REPETITIONS; repetition++)
+	{
+		auto start = Clock::now();
+		function();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		if (repetition == 0 || seconds < best)
+			best = seconds;
+	}
+
+	return best;
+}
+
+static double MeasureJobOverhead(JobSystem& jobs)
+{
+	double seconds = MeasureBest([&jobs]() {
+		for (uint32_t i = 0; i < JOB_OVERHEAD_JOBS; i += JOB_OVERHEAD_BATCH)
+		{
+			JobCounter counter;
+			jobs.Run(&EmptyJob, nullptr, JOB_OVERHEAD_BATCH, counter);
+			jobs.Wait(counter);
+		}
+	});
+
+	return seconds * 1e9 / JOB_OVERHEAD_JOBS;
+}
+
+static JobBenchmarkResult RunJobBenchmark()
+{
+	JobBenchmarkResult result;
+	uint32_t maxThreads = std::clamp(std::thread::hardware_concurrency(), 1u, JobSystem::MAX_WORKERS + 1);
+
+	{
+		JobSystem jobs;
+		jobs.Init(0);
+		result.spawnNanoseconds = MeasureJobOverhead(jobs);
+		jobs.Destroy();
+	}
+
+	{
+		JobSystem jobs;
+		jobs.Init(maxThreads - 1);
+		result.workers = jobs.GetWorkerCount();
+		result.stealNanoseconds = MeasureJobOverhead(jobs);
+		jobs.Destroy();
+	}
+
+	std::vector<uint32_t> results(JOB_SCALING_JOBS);
+
+	// The powers of two up to the hardware thread count, which is measured as well
+	for (uint32_t threads = 1; ; threads = std::min(threads * 2, maxThreads))
+	{
+		JobSystem jobs;
+		jobs.Init(threads - 1);
+
+		JobScalingResult scaling;
+		scaling.threads = threads;
+		scaling.milliseconds = 1000.0 * MeasureBest([&jobs, &results]() {
+			JobCounter counter;
+			jobs.Run(&WorkJob, results.data(), JOB_SCALING_JOBS, counter);
+			jobs.Wait(counter);
+		});
+
+		jobs.Destroy();
+		result.scaling.push_back(scaling);
+
+		if (threads == maxThreads)
+			break;
+	}
+
+	return result;
+}
+
+static double GetGigabytesPerSecond(VkDeviceSize bytes, double seconds) noexcept
+{
+	return seconds > 0.0 ? bytes / seconds / 1e9 : 0.0;
+}
+
+// The device name comes from the driver, quotes, backslashes and control characters would break the report
+static std::string EscapeJson(const std::string& text)
+{
+	std::string escaped;
+	escaped.reserve(text.size());
+
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+			escaped += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char code[8];
+			std::snprintf(code, sizeof(code), "\\u%04x", c);
+			escaped += code;
+		}
+		else
+			escaped += c;
+	}
+
+	return escaped;
+}
+
+static void WriteReport(std::ostream& stream, const BenchmarkOptions& options, const Application& app, const FrameStats& stats, double seconds,
+						const std::vector<UploadResult>& uploads, const std::vector<DrawScalingResult>& drawScaling,
+						const std::vector<RecordScalingResult>& recordScaling, const std::optional<JobBenchmarkResult>& jobs,
+						const std::optional<StreamingResult>& streaming, const std::vector<CommandCachingResult>& commandCaching)
+{
+	VkExtent2D extent = app.GetExtent();
+
+	// The GPU time alone tells the throughput ceiling, the frame rate may be limited by the CPU or the present mode
+	FrameStats::Summary gpu = stats.Summarize(&FrameTimings::gpu);
+
+	stream << "{\n"
+		   << "\t\"device\": \"" << EscapeJson(app.GetDeviceName()) << "\",\n"
+		   << "\t\"width\": " << extent.width << ",\n"
+		   << "\t\"height\": " << extent.height << ",\n"
+		   << "\t\"present_mode\": \"" << (options.application.headless ? "none" : GetPresentModeName(app.GetActivePresentMode())) << "\",\n"
+		   << "\t\"frames_in_flight\": " << app.GetFramesInFlight() << ",\n"
+		   << "\t\"headless\": " << (options.application.headless ? "true" : "false") << ",\n"
+		   << "\t\"gpu_timing\": " << (app.IsGpuTimingSupported() ? "true" : "false") << ",\n"
+		   << "\t\"warmup_frames\": " << options.warmupFrames << ",\n"
+		   << "\t\"frames\": " << stats.GetCount() << ",\n"
+		   << "\t\"frames_per_second\": " << (seconds > 0.0 ? stats.GetCount() / seconds : 0.0) << ",\n"
+		   << "\t\"instances\": " << app.GetInstanceCount() << ",\n"
+		   << "\t\"draw_path\": \"" << GetDrawPathName(app.GetDrawPath()) << "\",\n"
+		   << "\t\"record_threads\": " << app.GetRecordThreads() << ",\n"
+		   << "\t\"async_compute\": " << (app.IsAsyncComputeActive() ? "true" : "false") << ",\n"
+		   << "\t\"cached_commands\": " << (app.IsCachingCommands() ? "true" : "false") << ",\n"
+		   << "\t\"triangles_per_frame\": " << app.GetTrianglesPerFrame() << ",\n"
+		   << "\t\"triangles_per_second\": " << (seconds > 0.0 ? app.GetTrianglesPerFrame() * stats.GetCount() / seconds : 0.0) << ",\n"
+		   << "\t\"gpu_triangles_per_second\": " << (gpu.mean > 0.0 ? app.GetTrianglesPerFrame() / (gpu.mean / 1000.0) : 0.0) << ",\n"
+		   << "\t\"timings\": ";
+	stats.WriteJson(stream, "\t");
+
+	if (!uploads.empty())
+	{
+		stream << ",\n\t\"uploads\": [\n";
+
+		for (size_t i = 0; i < uploads.size(); i++)
+		{
+			const UploadResult& upload = uploads[i];
+
+			stream << "\t\t{ \"vertices\": " << upload.vertices
+				   << ", \"bytes\": " << upload.bytes
+				   << ", \"best_ms\": " << upload.bestSeconds * 1000.0
+				   << ", \"mean_ms\": " << upload.meanSeconds * 1000.0
+				   << ", \"gigabytes_per_second\": " << GetGigabytesPerSecond(upload.bytes, upload.bestSeconds)
+				   << ", \"mean_gigabytes_per_second\": " << GetGigabytesPerSecond(upload.bytes, upload.meanSeconds) << " }"
+				   << (i + 1 < uploads.size() ? ",\n" : "\n");
+		}
+
+		stream << "\t]";
+	}
+
+	if (streaming)
+	{
+		const UploadEngine::Stats& uploads = streaming->timings.uploads;
+
+		// The copies per command tell how well the small uploads were batched
+		stream << ",\n\t\"streaming\": {\n"
+			   << "\t\t\"frames\": " << streaming->timings.frames.GetCount() << ",\n"
+			   << "\t\t\"bytes\": " << uploads.bytes << ",\n"
+			   << "\t\t\"copies\": " << uploads.copies << ",\n"
+			   << "\t\t\"copy_commands\": " << uploads.commands << ",\n"
+			   << "\t\t\"submits\": " << uploads.submits << ",\n"
+			   << "\t\t\"ring_stalls\": " << uploads.ringStalls << ",\n"
+			   << "\t\t\"copies_per_command\": " << (uploads.commands > 0 ? static_cast<double>(uploads.copies) / uploads.commands : 0.0) << ",\n"
+			   << "\t\t\"gigabytes_per_second\": " << GetGigabytesPerSecond(uploads.bytes, streaming->timings.seconds) << ",\n"
+			   << "\t\t\"latency_ms\": { "
+			   << "\"count\": " << streaming->latency.count << ", "
+			   << "\"mean\": " << streaming->latency.mean << ", "
+			   << "\"p50\": " << streaming->latency.p50 << ", "
+			   << "\"p95\": " << streaming->latency.p95 << ", "
+			   << "\"p99\": " << streaming->latency.p99 << ", "
+			   << "\"max\": " << streaming->latency.max << " },\n"
+			   << "\t\t\"record_mean_ms\": " << streaming->record.mean << ",\n"
+			   << "\t\t\"gpu_mean_ms\": " << streaming->gpu.mean << "\n"
+			   << "\t}";
+	}
+
+	if (!drawScaling.empty())
+	{
+		stream << ",\n\t\"draw_scaling\": [\n";
+
+		for (size_t i = 0; i < drawScaling.size(); i++)
+		{
+			const DrawScalingResult& result = drawScaling[i];
+
+			stream << "\t\t{ \"draw_path\": \"" << GetDrawPathName(result.drawPath) << "\""
+				   << ", \"instances\": " << result.instances
+				   << ", \"record_mean_ms\": " << result.record.mean
+				   << ", \"record_p50_ms\": " << result.record.p50
+				   << ", \"record_p99_ms\": " << result.record.p99
+				   << ", \"gpu_mean_ms\": " << result.gpu.mean << " }"
+				   << (i + 1 < drawScaling.size() ? ",\n" : "\n");
+		}
+
+		stream << "\t]";
+	}
+
+	if (!recordScaling.empty())
+	{
+		stream << ",\n\t\"record_scaling\": [\n";
+
+		// The speedup is relative to the single-threaded recording
+		double baseline = recordScaling[0].record.mean;
+
+		for (size_t i = 0; i < recordScaling.size(); i++)
+		{
+			const RecordScalingResult& result = recordScaling[i];
+
+			stream << "\t\t{ \"threads\": " << result.threads
+				   << ", \"draws\": " << result.draws
+				   << ", \"record_mean_ms\": " << result.record.mean
+				   << ", \"record_p50_ms\": " << result.record.p50
+				   << ", \"record_p99_ms\": " << result.record.p99
+				   << ", \"speedup\": " << (result.record.mean > 0.0 ? baseline / result.record.mean : 0.0) << " }"
+				   << (i + 1 < recordScaling.size() ? ",\n" : "\n");
+		}
+
+		stream << "\t]";
+	}
+
+	if (!commandCaching.empty())
+	{
+		stream << ",\n\t\"command_caching\": [\n";
+
+		// The saving is relative to recording every frame
+		double baseline = commandCaching[0].cpu.mean;
+
+		for (size_t i = 0; i < commandCaching.size(); i++)
+		{
+			const CommandCachingResult& result = commandCaching[i];
+
+			stream << "\t\t{ \"cached\": " << (result.cached ? "true" : "false")
+				   << ", \"draws\": " << result.draws
+				   << ", \"cpu_mean_ms\": " << result.cpu.mean
+				   << ", \"cpu_p99_ms\": " << result.cpu.p99
+				   << ", \"record_mean_ms\": " << result.record.mean
+				   << ", \"record_p99_ms\": " << result.record.p99
+				   << ", \"cpu_saved_ms\": " << baseline - result.cpu.mean << " }"
+				   << (i + 1 < commandCaching.size() ? ",\n" : "\n");
+		}
+
+		stream << "\t]";
+	}
+
+	if (jobs)
+	{
+		stream << ",\n\t\"jobs\": {\n"
+			   << "\t\t\"spawn_ns\": " << jobs->spawnNanoseconds << ",\n"
+			   << "\t\t\"steal_ns\": " << jobs->stealNanoseconds << ",\n"
+			   << "\t\t\"workers\": " << jobs->workers << ",\n"
+			   << "\t\t\"scaling\": [\n";
+
+		// The speedup is relative to the submitting thread alone
+		double baseline = jobs->scaling[0].milliseconds;
+
+		for (size_t i = 0; i < jobs->scaling.size(); i++)
+		{
+			const JobScalingResult& result = jobs->scaling[i];
+
+			stream << "\t\t\t{ \"threads\": " << result.threads
+				   << ", \"ms\": " << result.milliseconds
+				   << ", \"speedup\": " << (result.milliseconds > 0.0 ? baseline / result.milliseconds : 0.0) << " }"
+				   << (i + 1 < jobs->scaling.size() ? ",\n" : "\n");
+		}
+
+		stream << "\t\t]\n\t}";
+	}
+
+	stream << "\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	using Clock = std::chrono::steady_clock;
+
+	PROFILE_THREAD("Main");
+
+	BenchmarkOptions options = ParseOptions(argc, argv);
+	Application app(options.application);
+
+	try
+	{
+		app.Init();
+
+		for (uint32_t i = 0; i < options.warmupFrames && !app.ShouldClose(); i++)
+			app.RenderFrame();
+
+		app.WaitIdle();
+#ifdef TRIANGLE_TRACK_ALLOCATIONS
+		AllocationTracker::ResetCounters();
+#endif
+
+		FrameStats stats;
+		stats.Reserve(options.frames);
+
+		auto start = Clock::now();
+		auto frameStart = start;
+
+		for (uint32_t i = 0; i < options.frames && !app.ShouldClose(); i++)
+		{
+			FrameTimings timings = app.RenderFrame();
+
+			auto now = Clock::now();
+			timings.cpu = std::chrono::duration<double, std::milli>(now - frameStart).count();
+			frameStart = now;
+
+			stats.Add(timings);
+		}
+
+		app.WaitIdle();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+		app.WriteCpuTrace();
+#ifdef TRIANGLE_TRACK_ALLOCATIONS
+		// The standard output may carry the JSON report
+		AllocationTracker::Report(std::cerr);
+#endif
+
+		// Runs after the frames, the device is idle and nothing else submits
+		std::vector<UploadResult> uploads;
+		if (options.upload)
+			uploads = RunUploadBenchmark(app, options.uploadRepetitions);
+
+		std::optional<StreamingResult> streaming;
+		if (options.uploadStream)
+			streaming = RunStreamingBenchmark(app, options.uploadStreamFrames);
+
+		std::vector<DrawScalingResult> drawScaling;
+		if (options.drawScaling)
+			drawScaling = RunDrawScalingBenchmark(app, options.drawScalingFrames);
+
+		std::vector<RecordScalingResult> recordScaling;
+		if (options.recordScaling)
+			recordScaling = RunRecordScalingBenchmark(app, options.recordScalingDraws, options.drawScalingFrames);
+
+		std::vector<CommandCachingResult> commandCaching;
+		if (options.commandCaching)
+			commandCaching = RunCommandCachingBenchmark(app, options.recordScalingDraws, options.drawScalingFrames);
+
+		// Separate schedulers, the one of the renderer is idle by now
+		std::optional<JobBenchmarkResult> jobs;
+		if (options.jobs)
+			jobs = RunJobBenchmark();
+
+		if (options.output == "-")
+			WriteReport(std::cout, options, app, stats, seconds, uploads, drawScaling, recordScaling, jobs, streaming, commandCaching);
+		else
+		{
+			std::ofstream file(options.output);
+			if (!file)
+				throw std::runtime_error("Can't open the benchmark output file!");
+
+			WriteReport(file, options, app, stats, seconds, uploads, drawScaling, recordScaling, jobs, streaming, commandCaching);
+			std::cout << "The benchmark results have been written to " << options.output << "\n";
+		}
+	}
+	catch (std::exception& ex)
+	{
+		std::cerr << ex.what();
+		return 1;
+	}
+
+	return 0;
+}
@@ -1,9 +1,71 @@
 #include "Application.h"
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+static DrawPath ParseDrawPath(const char* name) noexcept
+{
+	for (auto drawPath : { DrawPath::Instanced, DrawPath::PerObject, DrawPath::GpuDriven })
+	{
+		if (std::strcmp(name, GetDrawPathName(drawPath)) == 0)
+			return drawPath;
+	}
+
+	std::cerr << "Unknown draw path " << name << ", using the instanced draw\n";
+	return DrawPath::Instanced;
+}
+
+static ApplicationOptions ParseOptions(int argc, char** argv)
+{
+	ApplicationOptions options{};
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+			options.framesInFlight = static_cast<uint32_t>(std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc)
+			options.shaderDirectory = argv[++i];
+		else if (std::strcmp(argv[i], "--low-latency") == 0)
+			options.pacing = FramePacing::LowLatency;
+		else if (std::strcmp(argv[i], "--benchmark") == 0)
+			options.benchmark = true;
+		else if (std::strcmp(argv[i], "--benchmark-frames") == 0 && i + 1 < argc)
+			options.benchmarkFrames = static_cast<uint32_t>(std::atoi(argv[++i]));
+		else if (std::strcmp(argv[i], "--headless") == 0)
+			options.headless = true;
+		else if (std::strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+			options.width = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+			options.height = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--gpu-profile") == 0)
+			options.gpuProfile = true;
+		else if (std::strcmp(argv[i], "--gpu-trace") == 0 && i + 1 < argc)
+			options.gpuTracePath = argv[++i];
+		else if (std::strcmp(argv[i], "--cpu-trace") == 0 && i + 1 < argc)
+			options.cpuTracePath = argv[++i];
+		else if (std::strcmp(argv[i], "--timeline") == 0 && i + 1 < argc)
+			options.timelinePath = argv[++i];
+		else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc)
+			options.instanceCount = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+		else if (std::strcmp(argv[i], "--draw-path") == 0 && i + 1 < argc)
+			options.drawPath = ParseDrawPath(argv[++i]);
+		else if (std::strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc)
+			options.recordThreads = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+		else if (std::strcmp(argv[i], "--async-compute") == 0)
+			options.asyncCompute = true;
+		else if (std::strcmp(argv[i], "--cached-commands") == 0)
+			options.cachedCommands = true;
+	}
+
+	return options;
+}
 
 int main(int argc, char** argv)
 {
-	Application app;
+	PROFILE_THREAD("Main");
+
+	Application app(ParseOptions(argc, argv));
 
 	try
 	{
@@ -16,4 +78,4 @@ int main(int argc, char** argv)
 
 
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,28 @@
+# Converts a SPIR-V binary into a header with an aligned constexpr uint32_t array.
+# Usage: cmake -DINPUT=<shader.spv> -DOUTPUT=<header.h> -DSYMBOL=<array name> -P EmbedSpirv.cmake
+
+file(READ "${INPUT}" SPIRV_HEX HEX)
+string(LENGTH "${SPIRV_HEX}" SPIRV_HEX_LENGTH)
+math(EXPR SPIRV_REMAINDER "${SPIRV_HEX_LENGTH} % 8")
+
+if(SPIRV_HEX_LENGTH EQUAL 0 OR NOT SPIRV_REMAINDER EQUAL 0)
+	message(FATAL_ERROR "${INPUT} isn't a valid SPIR-V binary")
+endif()
+
+# SPIR-V is a stream of little-endian 32-bit words
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1, " SPIRV_WORDS "${SPIRV_HEX}")
+set(SPIRV_LINE "(0x........, 0x........, 0x........, 0x........, 0x........, 0x........, 0x........, 0x........, )")
+string(REGEX REPLACE "${SPIRV_LINE}" "\\1\n\t" SPIRV_WORDS "${SPIRV_WORDS}")
+string(REPLACE ", \n" ",\n" SPIRV_WORDS "${SPIRV_WORDS}")
+string(STRIP "${SPIRV_WORDS}" SPIRV_WORDS)
+
+file(WRITE "${OUTPUT}"
+"// Generated from ${INPUT}, do not edit
+#pragma once
+
+#include <cstdint>
+
+alignas(4) constexpr uint32_t ${SYMBOL}[] = {
+	${SPIRV_WORDS}
+};
+")